@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+
+namespace signal_processing
+{
+
+struct AlphaPeakTrackerConfig {
+    // range searched for the peak, Hz
+    double searchLow = 7.0;
+    double searchHigh = 14.0;
+    // weight of a new spectrum in the smoothed one
+    double smoothing = 0.05;
+    // a spectrum with broadband power this many times above the baseline is an artifact
+    double artifactRatio = 4.0;
+    // spectra accepted before the first estimate
+    std::size_t warmupSpectra = 20;
+    // consecutive rejections after which the power level is taken as the new
+    // baseline: a lasting change, such as a re-seated electrode, is no artifact
+    std::size_t reacquireSpectra = 50;
+};
+
+// Online estimate of the individual alpha peak frequency. Spectra are
+// smoothed exponentially within the search range, the peak bin is refined
+// by a parabola through it and its neighbours on a log scale. Spectra whose
+// broadband power jumps above the running baseline are skipped as artifacts,
+// unless the jump lasts for reacquireSpectra spectra in a row.
+// The cost of an update is linear in the bins of the search range.
+class AlphaPeakTracker
+{
+public:
+    explicit AlphaPeakTracker(AlphaPeakTrackerConfig config = {});
+
+    // psd from 0 Hz in steps of binWidth. Returns false if the spectrum was
+    // rejected as an artifact.
+    bool Update(std::span<const double> psd, double binWidth);
+
+    // Available after the warm-up, when the peak is inside the search range
+    std::optional<double> PeakFrequency() const;
+
+    // Every update is counted in exactly one of the two
+    uint64_t AcceptedCount() const;
+
+    uint64_t RejectedCount() const;
+
+private:
+    void Resize(std::size_t bins, double binWidth);
+    void FindPeak();
+
+    AlphaPeakTrackerConfig config_;
+    double binWidth_ = 0.0;
+    std::size_t firstBin_ = 0;
+    std::vector<double> smoothed_;
+    std::optional<double> baselineLogPower_;
+    std::optional<double> peakFrequency_;
+    uint64_t accepted_ = 0;
+    uint64_t rejected_ = 0;
+    uint64_t consecutiveRejected_ = 0;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <line_noise.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Reasons a sample was marked, combined as bits
+enum ArtifactCause : uint8_t {
+    kArtifactAmplitude = 1 << 0,
+    kArtifactGradient = 1 << 1,
+    kArtifactLineNoise = 1 << 2,
+    kArtifactMotion = 1 << 3
+};
+
+// Artifact mask of one EEG block
+struct ArtifactMask {
+    std::span<const uint64_t> timepoints;
+    // causes of every sample, any channel
+    std::span<const uint8_t> causes;
+    // bit per channel marked somewhere in the block
+    uint64_t channels = 0;
+};
+
+// Contiguous run of marked samples, microseconds
+struct ArtifactInterval {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint8_t causes = 0;
+};
+
+// Thresholds are in the units of the stream, volts for Capsule EEG
+struct ArtifactDetectorConfig {
+    double sampleRate = 0.0;
+    // deviation from the slowly tracked channel baseline
+    float amplitudeLimit = 150e-6f;
+    // difference between consecutive samples
+    float gradientLimit = 50e-6f;
+    double lineFrequency = 50.0;
+    // share of the channel power at the line frequency over the short window
+    // ending at a sample; the long window is the one shared with other stages
+    float lineNoiseRatio = 0.5f;
+    double lineWindowSec = 0.5;
+    double lineSampleWindowSec = 0.1;
+    // samples after a detection that stay marked
+    double holdSec = 0.1;
+};
+
+// Marks EEG artifacts sample by sample. Amplitude and gradient checks run
+// over the channel arrays of each block without branches; the line noise
+// share over a few mains periods ending at each sample comes from a
+// LineNoiseMeter, so its marks trail a burst by up to that window; motion comes from the MEMS side through SetMotion. Any number of stages can
+// subscribe to the per-block masks or to the closed intervals.
+class ArtifactDetector
+{
+public:
+    using MaskHandler = std::function<void(const ArtifactMask& mask)>;
+    using IntervalHandler = std::function<void(const ArtifactInterval& interval)>;
+
+    ArtifactDetector(ArtifactDetectorConfig config, int32_t channels);
+
+    const ArtifactDetectorConfig& Config() const;
+
+    // Return an id for Unsubscribe, which must not be called from a handler
+    std::size_t Subscribe(MaskHandler handler);
+    std::size_t SubscribeIntervals(IntervalHandler handler);
+    void Unsubscribe(std::size_t id);
+
+    // Head motion state from the given timepoint on
+    void SetMotion(uint64_t timepoint, bool moving);
+
+    void Push(const SignalBlock& block);
+
+    // Closes an open interval, e.g. when the session stops
+    void Flush();
+
+    // Line noise shares up to the last pushed block, for other stages to share
+    const LineNoiseMeter& LineNoise() const;
+
+private:
+    void DetectLineNoise(const SignalBlock& block);
+    void DetectMotion(std::span<const uint64_t> timepoints);
+    void Hold(std::span<const uint64_t> timepoints);
+    void Emit(std::span<const uint64_t> timepoints);
+
+    ArtifactDetectorConfig config_;
+    int32_t channels_;
+    std::size_t holdSamples_;
+
+    std::vector<std::pair<std::size_t, MaskHandler>> maskHandlers_;
+    std::vector<std::pair<std::size_t, IntervalHandler>> intervalHandlers_;
+    std::size_t nextId_ = 0;
+
+    std::vector<float> baselines_;
+    std::vector<float> lastValues_;
+    bool started_ = false;
+
+    LineNoiseMeter lineNoise_;
+
+    // motion state changes, oldest first
+    std::deque<std::pair<uint64_t, bool>> motion_;
+    bool moving_ = false;
+
+    std::vector<uint8_t> channelCauses_;
+    std::vector<uint8_t> causes_;
+    uint64_t channelMask_ = 0;
+    // samples still held after the last detection and the causes held
+    std::size_t holdLeft_ = 0;
+    uint8_t heldCauses_ = 0;
+    std::optional<ArtifactInterval> openInterval_;
+};
+
+} // namespace signal_processing
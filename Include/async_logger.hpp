@@ -0,0 +1,316 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace logging
+{
+
+enum class Level : uint8_t {
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+const char* LevelName(Level level);
+
+std::optional<Level> ParseLevel(std::string_view name);
+
+// Source of records sharing a rate limit, defined once per call site group.
+// Records above maxPerSecond in one second are dropped, and their number is
+// appended to the next record of the category that gets through.
+class Category
+{
+public:
+    explicit constexpr Category(const char* name, uint32_t maxPerSecond = 0)
+            : name_{name}
+            , maxPerSecond_{maxPerSecond}
+    {
+    }
+
+    const char* Name() const {
+        return name_;
+    }
+
+    // Called by Log on the thread that logs, before the record is copied:
+    // nullopt when the record is over the limit, otherwise the number of
+    // records dropped before it
+    std::optional<uint32_t> Admit(int64_t nowNs) const;
+
+private:
+    const char* name_;
+    uint32_t maxPerSecond_;
+    mutable std::atomic<int64_t> second_{0};
+    mutable std::atomic<uint32_t> count_{0};
+    mutable std::atomic<uint32_t> suppressed_{0};
+};
+
+namespace detail
+{
+// Non-constexpr, so a failed check stops the compilation at the call site
+void FormatArgumentsMismatch();
+
+consteval std::size_t CountPlaceholders(std::string_view text) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '{' && i + 1 < text.size() && text[i + 1] == '{') {
+            ++i;
+        } else if (text[i] == '{' && i + 1 < text.size() && text[i + 1] == '}') {
+            ++count;
+            ++i;
+        } else if (text[i] == '{' || (text[i] == '}' && (i + 1 == text.size() || text[i + 1] != '}'))) {
+            FormatArgumentsMismatch();
+        } else if (text[i] == '}') {
+            ++i;
+        }
+    }
+    return count;
+}
+
+enum class ArgumentType : uint8_t {
+    Bool,
+    Char,
+    Signed,
+    Unsigned,
+    Double,
+    String
+};
+
+template <typename T>
+concept StringLike = std::convertible_to<const T&, std::string_view>;
+
+template <typename T>
+concept Loggable = std::is_arithmetic_v<T> || std::is_enum_v<T> || StringLike<T>;
+
+template <typename T>
+std::size_t EncodedSize(const T& value) {
+    if constexpr (StringLike<T>) {
+        return 1 + sizeof(uint32_t) + std::string_view(value).size();
+    } else {
+        return 1 + sizeof(uint64_t);
+    }
+}
+
+template <typename T>
+uint8_t* Encode(uint8_t* out, const T& value) {
+    const auto put = [&out](ArgumentType type, const void* data, std::size_t size) {
+        *out++ = static_cast<uint8_t>(type);
+        std::memcpy(out, data, size);
+        out += size;
+    };
+    if constexpr (StringLike<T>) {
+        const std::string_view text(value);
+        const auto size = static_cast<uint32_t>(text.size());
+        put(ArgumentType::String, &size, sizeof(size));
+        std::memcpy(out, text.data(), text.size());
+        out += text.size();
+    } else if constexpr (std::is_same_v<T, bool>) {
+        const uint64_t bits = value ? 1 : 0;
+        put(ArgumentType::Bool, &bits, sizeof(bits));
+    } else if constexpr (std::is_same_v<T, char>) {
+        const auto bits = static_cast<uint64_t>(static_cast<unsigned char>(value));
+        put(ArgumentType::Char, &bits, sizeof(bits));
+    } else if constexpr (std::is_enum_v<T>) {
+        out = Encode(out, static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        const auto number = static_cast<double>(value);
+        put(ArgumentType::Double, &number, sizeof(number));
+    } else if constexpr (std::is_signed_v<T>) {
+        const auto number = static_cast<int64_t>(value);
+        put(ArgumentType::Signed, &number, sizeof(number));
+    } else {
+        const auto number = static_cast<uint64_t>(value);
+        put(ArgumentType::Unsigned, &number, sizeof(number));
+    }
+    return out;
+}
+
+// Fixed part of a record in a thread buffer, followed by the encoded arguments
+struct RecordHeader {
+    // bytes of the whole record, a multiple of 8
+    uint32_t size;
+    Level level;
+    uint8_t argumentsCount;
+    uint16_t padding;
+    // records of the category dropped before this one
+    uint32_t suppressed;
+    int64_t timestampNs;
+    const Category* category;
+    const char* format;
+};
+
+// Single-producer single-consumer byte ring of one logging thread
+class ThreadBuffer
+{
+public:
+    explicit ThreadBuffer(std::size_t capacity);
+
+    // Contiguous space for a record of the given size, nullptr when the buffer is full
+    uint8_t* Reserve(std::size_t size);
+    void Commit(std::size_t size);
+
+    // Consumer side: the next record or nullptr, released with its size
+    const uint8_t* Peek();
+    void Release(std::size_t size);
+
+    uint64_t TakeDropped();
+    void CountDropped();
+
+private:
+    std::vector<uint8_t> data_;
+    // bytes skipped at the end of the ring by the reserved record
+    std::size_t skipped_ = 0;
+    std::atomic<std::size_t> head_{0};
+    std::atomic<std::size_t> tail_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+} // namespace detail
+
+// Format string checked at compile time: one {} per argument, {{ and }} for braces.
+// The background thread substitutes the placeholders itself: the arguments
+// are decoded from the record at run time, and std::vformat would need a
+// std::format_args built from a pack known at compile time.
+template <typename... Args>
+struct FormatString {
+    template <std::size_t N>
+    consteval FormatString(const char (&literal)[N])
+            : text{literal}
+    {
+        if (detail::CountPlaceholders(std::string_view(literal, N - 1)) != sizeof...(Args)) {
+            detail::FormatArgumentsMismatch();
+        }
+    }
+
+    const char* text;
+};
+
+// Logging on the calling thread costs a rate limit check and copying the
+// arguments into a lock-free buffer owned by that thread. A background
+// thread formats the records in timestamp order and writes them with one
+// flush per pass, records at Warning and above to the error stream.
+// When a buffer is full the record is dropped and counted, never waited for.
+class Logger
+{
+public:
+    static constexpr std::size_t kThreadBufferBytes = 64 * 1024;
+
+    Logger(std::ostream& out, std::ostream& errors);
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void SetLevel(Level level);
+
+    bool Enabled(Level level) const {
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void Log(Level level, const Category& category, FormatString<std::type_identity_t<Args>...> format,
+             const Args&... args) {
+        static_assert((detail::Loggable<Args> && ...), "only numbers, enums and strings can be logged");
+        if (!Enabled(level)) {
+            return;
+        }
+        const int64_t now = NowNs();
+        const auto suppressed = category.Admit(now);
+        if (!suppressed.has_value()) {
+            return;
+        }
+        const std::size_t size = (sizeof(detail::RecordHeader) + ... + detail::EncodedSize(args));
+        const std::size_t alignedSize = (size + 7) & ~std::size_t{7};
+        auto& buffer = CurrentBuffer();
+        uint8_t* out = buffer.Reserve(alignedSize);
+        if (out == nullptr) {
+            buffer.CountDropped();
+            return;
+        }
+        const detail::RecordHeader header{static_cast<uint32_t>(alignedSize), level,
+                                          static_cast<uint8_t>(sizeof...(Args)), 0, *suppressed, now, &category,
+                                          format.text};
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        ((out = detail::Encode(out, args)), ...);
+        buffer.Commit(alignedSize);
+    }
+
+    // Formats everything logged so far, waits for the background thread
+    void Flush();
+
+private:
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+    }
+
+    detail::ThreadBuffer& CurrentBuffer();
+    void Run();
+    bool Drain();
+
+    struct Line {
+        int64_t timestampNs;
+        Level level;
+        std::string text;
+    };
+
+    void FormatPrefix(int64_t timestampNs, Level level, const char* category, Line& line) const;
+    void Format(const uint8_t* record, Line& line) const;
+
+    const uint64_t id_;
+    std::ostream& out_;
+    std::ostream& errors_;
+    std::atomic<Level> level_{Level::Info};
+    const int64_t originNs_;
+
+    std::mutex buffersMutex_;
+    std::vector<std::shared_ptr<detail::ThreadBuffer>> buffers_;
+    // serializes passes of the background thread and Flush
+    std::mutex drainMutex_;
+    std::vector<Line> lines_;
+    std::size_t linesCount_ = 0;
+
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
+
+// Logger writing to std::cout and std::cerr, started on first use
+Logger& DefaultLogger();
+
+template <typename... Args>
+void Debug(const Category& category, FormatString<std::type_identity_t<Args>...> format, const Args&... args) {
+    DefaultLogger().Log(Level::Debug, category, format, args...);
+}
+
+template <typename... Args>
+void Info(const Category& category, FormatString<std::type_identity_t<Args>...> format, const Args&... args) {
+    DefaultLogger().Log(Level::Info, category, format, args...);
+}
+
+template <typename... Args>
+void Warning(const Category& category, FormatString<std::type_identity_t<Args>...> format, const Args&... args) {
+    DefaultLogger().Log(Level::Warning, category, format, args...);
+}
+
+template <typename... Args>
+void Error(const Category& category, FormatString<std::type_identity_t<Args>...> format, const Args&... args) {
+    DefaultLogger().Log(Level::Error, category, format, args...);
+}
+
+} // namespace logging
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <fft.hpp>
+#include <signal_block.hpp>
+
+#include "Capsule/CNFBCalibrator.h"
+
+
+namespace signal_processing
+{
+
+struct PowerBand {
+    std::string name;
+    double low = 0.0;
+    double high = 0.0;
+};
+
+// theta 4-8 Hz, alpha 8-13 Hz, beta 13-30 Hz
+std::vector<PowerBand> DefaultPowerBands();
+
+// theta, alpha and beta around the individual alpha range of the calibration
+std::vector<PowerBand> IndividualPowerBands(const clCIndividualNFBData& data);
+
+struct BandPowerConfig {
+    double sampleRate = 0.0;
+    // samples analysed at every update
+    std::size_t windowSamples = 512;
+    // Welch segment, a power of two not longer than the window, overlapped by half
+    std::size_t segmentSamples = 256;
+    // new samples between two updates
+    std::size_t hopSamples = 25;
+    std::vector<PowerBand> bands = DefaultPowerBands();
+};
+
+// Per-channel band powers over a sliding window, recomputed every hopSamples.
+// Wide bands are integrated from a Welch PSD, bands narrower than two Welch
+// bins are evaluated with Goertzel over the whole window for finer resolution.
+// Welch segments sit on a fixed grid of half-segment steps: each one is
+// transformed once, when it completes, and its periodogram stays in a ring
+// and in a running sum until it leaves the window, so an update only scales
+// the sums. FFT plan, windows and scratch buffers are allocated once.
+class BandPowerEngine
+{
+public:
+    // powers[channel * BandsCount() + band], signal units squared
+    using PowersHandler = std::function<void(uint64_t timepoint, std::span<const float> powers)>;
+    // Welch PSD averaged over channels, from 0 Hz in steps of binWidth
+    using SpectrumHandler = std::function<void(uint64_t timepoint, std::span<const double> psd, double binWidth)>;
+    // Welch PSD of every channel, psds[channel * BinsCount() + bin]
+    using ChannelSpectraHandler = std::function<void(uint64_t timepoint, std::span<const double> psds, double binWidth)>;
+
+    BandPowerEngine(BandPowerConfig config, int32_t channels);
+
+    const BandPowerConfig& Config() const;
+
+    int32_t ChannelsCount() const;
+
+    std::size_t BandsCount() const;
+
+    std::size_t BinsCount() const;
+
+    void SetBands(std::vector<PowerBand> bands);
+
+    void SetPowersHandler(PowersHandler handler);
+
+    // The PSD is computed for every update while a spectrum handler is set
+    void SetSpectrumHandler(SpectrumHandler handler);
+
+    // Lets later stages reuse the spectra instead of transforming the window again
+    void SetChannelSpectraHandler(ChannelSpectraHandler handler);
+
+    void Push(const SignalBlock& block);
+
+    uint64_t UpdatesCount() const;
+
+private:
+    struct BandPlan {
+        bool goertzel = false;
+        // Welch bins [firstBin, lastBin)
+        std::size_t firstBin = 0;
+        std::size_t lastBin = 0;
+        // 2 cos(w) of every Goertzel frequency
+        std::vector<float> goertzelCoefficients;
+    };
+
+    void PlanBands();
+    void Update(uint64_t timepoint);
+    // periodograms of the segment ending with the last pushed sample
+    void TransformSegment();
+    void DropOldSegments();
+    void WelchPsd(int32_t channel);
+    float GoertzelPower(std::span<const float> window, const BandPlan& band);
+
+    BandPowerConfig config_;
+    int32_t channels_;
+    FftPlan plan_;
+    std::vector<float> segmentWindow_;
+    std::vector<float> fullWindow_;
+    // one-sided density scale of a windowed segment and of the whole window
+    double segmentScale_ = 0.0;
+    double fullScale_ = 0.0;
+    std::vector<BandPlan> bandPlans_;
+    bool needsWelch_ = false;
+    PowersHandler handler_;
+    SpectrumHandler spectrumHandler_;
+    ChannelSpectraHandler channelSpectraHandler_;
+
+    // channels x windowSamples ring of the last samples
+    std::vector<float> history_;
+    std::size_t writeIndex_ = 0;
+    std::size_t filled_ = 0;
+    std::size_t sinceUpdate_ = 0;
+    uint64_t updates_ = 0;
+    uint64_t samplesPushed_ = 0;
+
+    // periodograms of the segments [oldestSegment_, nextSegment_), segment n
+    // in slot n % segmentSlots_, [slot][channel][bin]; psdSums_ holds their
+    // sum per channel
+    std::size_t segmentSlots_ = 0;
+    uint64_t oldestSegment_ = 0;
+    uint64_t nextSegment_ = 0;
+    std::vector<double> segmentSpectra_;
+    std::vector<double> psdSums_;
+
+    std::vector<float> linear_;
+    std::vector<float> segment_;
+    std::vector<float> windowed_;
+    std::vector<std::complex<float>> spectrum_;
+    std::vector<double> psd_;
+    std::vector<double> meanPsd_;
+    std::vector<double> channelPsds_;
+    std::vector<float> powers_;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <utility>
+
+
+namespace block_memory
+{
+
+// Size classes are powers of two from kMinBlockSize to kMaxBlockSize,
+// bigger requests are served by the system allocator
+inline constexpr std::size_t kMinBlockSize = 256;
+inline constexpr std::size_t kMaxBlockSize = std::size_t{4} << 20;
+inline constexpr std::size_t kSizeClasses = 15;
+inline constexpr std::size_t kBlockAlignment = 64;
+
+struct SizeClassStats {
+    std::size_t blockSize = 0;
+    uint64_t blocksInUse = 0;
+    uint64_t blocksReserved = 0;
+};
+
+struct AllocatorStats {
+    uint64_t allocations = 0;
+    uint64_t releases = 0;
+    // served from the free list of the allocating thread
+    uint64_t localHits = 0;
+    // served by moving a batch from the shared free list
+    uint64_t sharedRefills = 0;
+    // new slabs requested from the system
+    uint64_t slabAllocations = 0;
+    uint64_t oversizedAllocations = 0;
+    uint64_t bytesInUse = 0;
+    uint64_t bytesReserved = 0;
+    std::array<SizeClassStats, kSizeClasses> sizeClasses{};
+};
+
+namespace detail
+{
+    // Precedes the payload of every block
+    struct alignas(kBlockAlignment) BlockHeader {
+        std::atomic<uint32_t> references{0};
+        uint32_t sizeClass = 0;
+        std::size_t size = 0;
+        BlockHeader* next = nullptr;
+    };
+
+    void ReleaseBlock(BlockHeader* header);
+}
+
+// Reference-counted handle to a pooled block. Copies share the block, the
+// last handle returns it to the free list of the thread releasing it.
+class BlockHandle
+{
+public:
+    BlockHandle() = default;
+
+    BlockHandle(const BlockHandle& other)
+            : header_{other.header_}
+    {
+        if (header_ != nullptr) {
+            header_->references.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    BlockHandle(BlockHandle&& other) noexcept
+            : header_{std::exchange(other.header_, nullptr)}
+    {
+    }
+
+    BlockHandle& operator=(BlockHandle other) noexcept {
+        std::swap(header_, other.header_);
+        return *this;
+    }
+
+    ~BlockHandle() {
+        Reset();
+    }
+
+    void Reset() {
+        if (header_ != nullptr && header_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            detail::ReleaseBlock(header_);
+        }
+        header_ = nullptr;
+    }
+
+    explicit operator bool() const {
+        return header_ != nullptr;
+    }
+
+    // Payload, aligned to kBlockAlignment
+    std::byte* Data() const {
+        return header_ == nullptr ? nullptr : reinterpret_cast<std::byte*>(header_ + 1);
+    }
+
+    // Requested size in bytes
+    std::size_t Size() const {
+        return header_ == nullptr ? 0 : header_->size;
+    }
+
+    uint32_t UseCount() const {
+        return header_ == nullptr ? 0 : header_->references.load(std::memory_order_relaxed);
+    }
+
+    // Typed view of count objects starting at byte offset
+    template<typename T>
+    std::span<T> As(std::size_t offset, std::size_t count) const {
+        return {reinterpret_cast<T*>(Data() + offset), count};
+    }
+
+private:
+    friend BlockHandle Allocate(std::size_t size);
+
+    explicit BlockHandle(detail::BlockHeader* header)
+            : header_{header}
+    {
+    }
+
+    detail::BlockHeader* header_ = nullptr;
+};
+
+// Allocates a block of at least size bytes. Blocks come from per-thread free
+// lists of the size class, refilled in batches from a shared list and slabs.
+BlockHandle Allocate(std::size_t size);
+
+AllocatorStats Stats();
+
+void PrintStats(std::ostream& out);
+
+} // namespace block_memory
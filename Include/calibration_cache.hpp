@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Capsule/CNFBCalibrator.h"
+
+
+namespace calibration
+{
+
+// Calibration results of one user on one device
+struct CalibrationRecord {
+    std::string user;
+    std::string device;
+    // wall clock of the calibration, seconds since the epoch
+    int64_t calibratedAt = 0;
+    clCIndividualNFBData individual{};
+};
+
+// A cached calibration is used while it is younger than maxAge. The alpha peak
+// tracked during the first minutes of the session either confirms it or, when
+// it moves further than maxPeakShiftHz, rejects it.
+struct CachePolicy {
+    std::chrono::hours maxAge{14 * 24};
+    double maxPeakShiftHz = 1.0;
+    // spectra accepted by the tracker before a cached peak can be rejected
+    uint64_t minSpectra = 300;
+    // spectra within the limit that confirm it
+    uint64_t confirmSpectra = 1800;
+};
+
+enum class PeakCheck {
+    Pending,
+    Confirmed,
+    Rejected
+};
+
+PeakCheck CheckCachedPeak(double cachedPeak, std::optional<double> trackedPeak, uint64_t acceptedSpectra,
+                          const CachePolicy& policy);
+
+// Calibrations keyed by user and device, kept in a CSV file that is rewritten
+// on every change. Unreadable lines are reported and dropped.
+class CalibrationCache
+{
+public:
+    explicit CalibrationCache(std::string path);
+
+    // nullopt when there is no record or it is older than maxAge at now (seconds since the epoch)
+    std::optional<CalibrationRecord> Find(const std::string& user, const std::string& device, int64_t now,
+                                          std::chrono::seconds maxAge) const;
+
+    // Replaces the record of the same user and device
+    bool Save(CalibrationRecord record);
+
+    bool Remove(const std::string& user, const std::string& device);
+
+    std::size_t Size() const;
+
+private:
+    std::vector<CalibrationRecord>::iterator FindRecord(const std::string& user, const std::string& device);
+    std::vector<CalibrationRecord>::const_iterator FindRecord(const std::string& user, const std::string& device) const;
+    bool Write() const;
+
+    std::string path_;
+    std::vector<CalibrationRecord> records_;
+};
+
+void PrintRecord(std::ostream& out, const CalibrationRecord& record, int64_t now);
+
+} // namespace calibration
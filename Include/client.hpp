@@ -30,6 +30,15 @@ struct Data {
     Value<float> concentrationScore{0, 0x04};
     Value<float> accumulatedFatigue{0, 0x08};
     Value<float> individualPeakFrequency{0, 0x16};
+    Value<float> trackedPeakFrequency{0, 0x20};
+    Value<float> signalQuality{0, 0x40};
+    // seconds until the score reaches its alert threshold, with the bounds
+    Value<float> fatigueForecast{0, 0x80};
+    Value<float> fatigueForecastEarliest{0, 0x100};
+    Value<float> fatigueForecastLatest{0, 0x200};
+    Value<float> concentrationForecast{0, 0x400};
+    Value<float> concentrationForecastEarliest{0, 0x800};
+    Value<float> concentrationForecastLatest{0, 0x1000};
 };
 
 class Client
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <band_power.hpp>
+#include <fft.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+struct ChannelPair {
+    std::string name;
+    int32_t left = 0;
+    int32_t right = 0;
+};
+
+// Left/right homologous 10-20 pairs among the channel names: same letters,
+// odd number on the left and the next even one on the right (F3:F4, T3:T4)
+std::vector<ChannelPair> HomologousPairs(std::span<const std::string> names);
+
+// Comma-separated "left:right" pairs of channel names. Prints the reason and
+// returns nothing when a name is unknown.
+std::optional<std::vector<ChannelPair>> ParsePairs(std::string_view spec, std::span<const std::string> names);
+
+struct CoherenceConfig {
+    double sampleRate = 0.0;
+    // a power of two, segments overlap by half
+    std::size_t segmentSamples = 256;
+    // segments the spectra are averaged over
+    std::size_t averagedSegments = 8;
+    std::vector<PowerBand> bands = DefaultPowerBands();
+};
+
+// Band coherence and power asymmetry of selected channel pairs. Each channel
+// used by a pair is transformed once per segment; the auto and cross spectra
+// are kept as sliding sums over the last segments, so the work grows with
+// the pairs requested and not with all pairs of the montage.
+class CoherenceEngine
+{
+public:
+    // Both as [pair * BandsCount() + band]. coherence is the mean
+    // magnitude-squared coherence over the band bins, asymmetry is
+    // ln(right power) - ln(left power); for F3:F4 and alpha this is the
+    // frontal alpha asymmetry.
+    using MeasuresHandler = std::function<void(uint64_t timepoint, std::span<const float> coherence,
+                                               std::span<const float> asymmetry)>;
+
+    CoherenceEngine(CoherenceConfig config, std::vector<ChannelPair> pairs);
+
+    std::span<const ChannelPair> Pairs() const;
+
+    std::size_t BandsCount() const;
+
+    const CoherenceConfig& Config() const;
+
+    void SetMeasuresHandler(MeasuresHandler handler);
+
+    void Push(const SignalBlock& block);
+
+private:
+    void Update(uint64_t timepoint);
+    void Publish(uint64_t timepoint);
+
+    CoherenceConfig config_;
+    std::vector<ChannelPair> pairs_;
+    MeasuresHandler handler_;
+    FftPlan plan_;
+    std::vector<float> window_;
+    std::size_t bins_;
+    std::size_t hop_;
+    // [first, last) Welch bins of every band
+    std::vector<std::pair<std::size_t, std::size_t>> bandBins_;
+
+    // distinct channels of the pairs, and the positions of each pair in it
+    std::vector<int32_t> inputs_;
+    std::vector<std::pair<std::size_t, std::size_t>> pairInputs_;
+
+    // inputs x segmentSamples ring of the last samples
+    std::vector<float> history_;
+    std::size_t writeIndex_ = 0;
+    std::size_t filled_ = 0;
+    std::size_t sinceUpdate_ = 0;
+
+    std::vector<float> segment_;
+    std::vector<std::complex<float>> spectra_;
+    // contributions of the last segments, slot-major, and their sums
+    std::vector<float> autoHistory_;
+    std::vector<double> autoSums_;
+    std::vector<std::complex<float>> crossHistory_;
+    std::vector<std::complex<double>> crossSums_;
+    std::size_t slot_ = 0;
+    std::size_t segments_ = 0;
+
+    std::vector<float> coherence_;
+    std::vector<float> asymmetry_;
+};
+
+} // namespace signal_processing
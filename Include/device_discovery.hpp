@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+#include "Capsule/CDeviceInfoList.h"
+
+
+namespace device_discovery
+{
+
+const char* DeviceTypeName(clCDeviceType type);
+
+// Accepts short names ("band", "buds", ...) as well as DeviceTypeName output
+std::optional<clCDeviceType> ParseDeviceType(std::string_view name);
+
+// Device the application should connect to. An empty filter keeps the
+// default behaviour: wait for the full discovery window and take the first device.
+struct DeviceFilter {
+    std::optional<std::string> id;          // exact device ID
+    std::optional<std::string> serial;      // substring of the device ID or name
+    std::optional<clCDeviceType> type;      // NeiryAny matches every Neiry device
+
+    bool Empty() const;
+    bool Matches(clCDeviceInfo info) const;
+};
+
+// Reads --device=<id>, --serial=<part of id or name> and --device-type=<type>,
+// nullopt after reporting an unknown device type
+std::optional<DeviceFilter> ParseDeviceFilter(int argc, char* argv[]);
+
+// Splits the discovery window into short probe windows, so that a device matching
+// the filter is connected to as soon as the locator reports it. Probing continues
+// until the scan time is over to report devices found later.
+class DeviceScan
+{
+public:
+    static constexpr int32_t kProbeWindowSec = 1;
+
+    DeviceScan(DeviceFilter filter, int32_t scanTimeSec);
+
+    // Locator device type to search for
+    clCDeviceType LocatorType() const;
+
+    // Search time for the next clCDeviceLocator_RequestDevices call, 0 if the scan is over
+    int32_t NextWindowSec();
+
+    // Prints newly seen devices and returns the index of the device to connect to
+    std::optional<int32_t> OnDeviceList(clCDeviceInfoList devices, std::ostream& log);
+
+    bool EarlySelection() const;
+
+    bool Finished() const;
+
+private:
+    DeviceFilter filter_;
+    int32_t scanTimeSec_;
+    int32_t requestedSec_{0};
+    std::unordered_set<std::string> seenDevices_;
+};
+
+} // namespace device_discovery
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <band_power.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Layout of the feature vector of one channel
+enum EegFeature : std::size_t {
+    kSpectralEntropy,
+    kHjorthActivity,
+    kHjorthMobility,
+    kHjorthComplexity,
+    kThetaBetaRatio,
+    kAlphaThetaBetaRatio,
+    kLineLength,
+    kEegFeaturesCount
+};
+
+const char* EegFeatureName(EegFeature feature);
+
+struct EegFeatureConfig {
+    double sampleRate = 0.0;
+    // should match the window of the band power engine the spectra come from
+    std::size_t windowSamples = 512;
+    // range of the spectral entropy, Hz
+    double entropyLow = 1.0;
+    double entropyHigh = 40.0;
+    // theta, alpha and beta are looked up by name
+    std::vector<PowerBand> bands = DefaultPowerBands();
+};
+
+// Per-channel EEG features over a sliding window. Spectral features come from
+// the Welch spectra of a BandPowerEngine (SetChannelSpectraHandler), so no
+// extra FFT is done. Hjorth parameters and line length come from sums of the
+// signal and its differences, kept per block and summed for the window.
+// A vector is emitted with every spectrum update.
+class EegFeatureExtractor
+{
+public:
+    // features[channel * kEegFeaturesCount + feature]
+    using FeaturesHandler = std::function<void(uint64_t timepoint, std::span<const float> features)>;
+
+    EegFeatureExtractor(EegFeatureConfig config, int32_t channels);
+
+    void SetFeaturesHandler(FeaturesHandler handler);
+
+    void SetBands(std::vector<PowerBand> bands);
+
+    // Time-domain part, call before pushing the block to the band power engine
+    void Push(const SignalBlock& block);
+
+    // Spectral part, psds[channel * bins + bin]
+    void OnSpectra(uint64_t timepoint, std::span<const double> psds, double binWidth);
+
+private:
+    // sums of the offset-free signal x, dx and d2x over one block
+    struct BlockSums {
+        std::size_t samples = 0;
+        std::size_t diffs = 0;
+        std::size_t secondDiffs = 0;
+        double x = 0.0;
+        double x2 = 0.0;
+        double dx = 0.0;
+        double dx2 = 0.0;
+        double d2x = 0.0;
+        double d2x2 = 0.0;
+        double lineLength = 0.0;
+    };
+
+    struct ChannelState {
+        std::optional<float> offset;
+        // the last two samples before the block
+        float previous = 0.0f;
+        float previousDiff = 0.0f;
+        std::size_t seen = 0;
+        std::deque<BlockSums> window;
+    };
+
+    EegFeatureConfig config_;
+    int32_t channels_;
+    FeaturesHandler handler_;
+    std::vector<ChannelState> states_;
+    std::vector<float> features_;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <signal_history.hpp>
+
+
+namespace signal_processing
+{
+
+struct EpochConfig {
+    // window around the marker, seconds
+    double preSec = 0.2;
+    double postSec = 0.8;
+    // subtract the mean of the pre-marker part from every epoch
+    bool baselineCorrection = true;
+    // conditions are numbered from 0
+    std::size_t conditions = 5;
+};
+
+// Running event-related average of one condition
+struct ErpAverage {
+    std::size_t condition = 0;
+    uint64_t epochs = 0;
+    int32_t channels = 0;
+    std::size_t samples = 0;
+    // samples before the marker
+    std::size_t preSamples = 0;
+    double sampleRate = 0.0;
+    // [channel * samples + sample]
+    std::span<const float> mean;
+    std::span<const float> variance;
+};
+
+// Cuts marker-locked epochs out of a SignalHistory and keeps the mean and
+// variance of every condition with Welford's update, so an epoch costs
+// O(window) whatever the number of epochs already averaged. Markers wait
+// until the history holds their post-marker part; markers whose pre-marker
+// part has already left the history are dropped.
+class EpochAverager
+{
+public:
+    using AverageHandler = std::function<void(const ErpAverage& average)>;
+
+    EpochAverager(EpochConfig config, const SignalHistory& history);
+
+    void SetAverageHandler(AverageHandler handler);
+
+    // Marker time in microseconds, on the clock of the EEG timepoints
+    void Mark(std::size_t condition, uint64_t timepoint);
+
+    // Cuts the epochs that became complete, call after pushing to the history
+    void Update();
+
+    uint64_t DroppedCount() const;
+
+    // Empty until the history is ready
+    std::optional<ErpAverage> Average(std::size_t condition) const;
+
+private:
+    struct Condition {
+        uint64_t epochs = 0;
+        std::vector<float> mean;
+        std::vector<float> m2;
+        std::vector<float> variance;
+    };
+
+    struct Marker {
+        std::size_t condition = 0;
+        uint64_t timepoint = 0;
+    };
+
+    static constexpr uint64_t kTooOld = std::numeric_limits<uint64_t>::max();
+
+    bool Prepare();
+    // nullopt while the marker is newer than the history
+    std::optional<uint64_t> FindSample(uint64_t timepoint) const;
+    // first is the sample index of the epoch start
+    bool Cut(std::size_t condition, uint64_t first);
+    ErpAverage MakeAverage(std::size_t condition) const;
+
+    EpochConfig config_;
+    const SignalHistory& history_;
+    AverageHandler handler_;
+    bool prepared_ = false;
+    int32_t channels_ = 0;
+    std::size_t preSamples_ = 0;
+    std::size_t samples_ = 0;
+    std::vector<Condition> conditions_;
+    std::deque<Marker> pending_;
+    std::vector<float> epoch_;
+    uint64_t dropped_ = 0;
+};
+
+} // namespace signal_processing
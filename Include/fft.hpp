@@ -0,0 +1,39 @@
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+
+namespace signal_processing
+{
+
+// Precomputed radix-2 FFT of real input. The plan owns its twiddles and
+// scratch, so it is reused for every transform of the same size but must
+// not be shared between threads.
+class FftPlan
+{
+public:
+    // size must be a power of two
+    explicit FftPlan(std::size_t size);
+
+    std::size_t Size() const;
+
+    // Number of output bins: Size() / 2 + 1
+    std::size_t BinsCount() const;
+
+    // Spectrum of Size() real samples, bins from 0 to the Nyquist frequency
+    void Forward(std::span<const float> input, std::span<std::complex<float>> output);
+
+private:
+    std::size_t size_;
+    std::vector<std::size_t> bitReversed_;
+    std::vector<std::complex<float>> twiddles_;
+    std::vector<std::complex<float>> scratch_;
+};
+
+// Hann window of the given length, periodic as used for spectral analysis
+std::vector<float> HannWindow(std::size_t size);
+
+} // namespace signal_processing
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+struct HeadPose {
+    uint64_t timepoint = 0;
+    // orientation quaternion, sensor frame to earth frame
+    float w = 1.0f;
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    // degrees
+    float pitch = 0.0f;
+    float roll = 0.0f;
+    float yaw = 0.0f;
+    // smoothed rotation and acceleration power, 0 at rest
+    float motionEnergy = 0.0f;
+};
+
+enum class HeadEvent {
+    // the head left the posture and came back within a second
+    Nod,
+    // the head stayed away from the posture, which becomes the new one
+    PostureChange
+};
+
+struct HeadMotionConfig {
+    // Madgwick filter gain
+    float beta = 0.1f;
+    // multiplies gyroscope samples into rad/s, the default expects deg/s
+    float gyroscopeScale = 0.017453292f;
+    // time constant of the motion energy, seconds
+    float motionTimeConstantSec = 0.5f;
+    // energy above which the head counts as moving
+    float movingEnergy = 0.05f;
+    float nodDeg = 10.0f;
+    float nodMaxSec = 1.0f;
+    float postureDeg = 15.0f;
+    float postureHoldSec = 2.0f;
+};
+
+// Head orientation from every accelerometer and gyroscope sample with the
+// Madgwick IMU filter, plus a motion energy index and nod/posture events.
+// Time steps come from the sample timepoints, no nominal rate is needed.
+class HeadMotionEngine
+{
+public:
+    using EventHandler = std::function<void(HeadEvent event, const HeadPose& pose)>;
+
+    explicit HeadMotionEngine(HeadMotionConfig config = {});
+
+    void SetEventHandler(EventHandler handler);
+
+    // Block laid out as by CopyMEMSBlock
+    void Push(const SignalBlock& block);
+
+    const HeadPose& Pose() const;
+
+    // True while the motion energy is above the configured level,
+    // EEG of such periods is likely to carry motion artifacts
+    bool IsMoving() const;
+
+private:
+    void UpdateOrientation(float ax, float ay, float az, float gx, float gy, float gz, float dt);
+    void UpdateEvents();
+
+    HeadMotionConfig config_;
+    EventHandler handler_;
+    HeadPose pose_;
+    std::optional<uint64_t> lastTimepoint_;
+    // running mean of the acceleration magnitude, 1 g in sensor units
+    std::optional<float> gravity_;
+    float rotationEnergy_ = 0.0f;
+    float accelerationEnergy_ = 0.0f;
+
+    std::optional<uint64_t> settledAt_;
+    std::optional<HeadPose> posture_;
+    std::optional<uint64_t> excursionStart_;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Second-order section, normalized so that a0 == 1
+struct BiquadCoefficients {
+    float b0 = 1.0f;
+    float b1 = 0.0f;
+    float b2 = 0.0f;
+    float a1 = 0.0f;
+    float a2 = 0.0f;
+};
+
+// Audio EQ cookbook designs, frequencies in Hz
+BiquadCoefficients NotchCoefficients(double frequency, double sampleRate, double q);
+BiquadCoefficients HighPassCoefficients(double cutoff, double sampleRate, double q);
+BiquadCoefficients LowPassCoefficients(double cutoff, double sampleRate, double q);
+
+// Butterworth quality factor of a second-order section
+inline constexpr double kButterworthQ = 0.7071067811865476;
+
+// Name of the instruction set the cascade was built for: "AVX2", "SSE2", "NEON" or "scalar"
+const char* FilterInstructionSet();
+
+// Cascade of biquads in transposed direct form II, applied to every channel
+// of a stream. Channels are processed together, several per SIMD register,
+// and the state is kept between blocks. Every path evaluates the same
+// expression with separate multiplies and adds, so the results are
+// bit-identical to FilterReference on any instruction set.
+class BiquadCascade
+{
+public:
+    BiquadCascade() = default;
+    BiquadCascade(std::vector<BiquadCoefficients> sections, int32_t channels);
+
+    int32_t ChannelsCount() const;
+
+    // Floats between consecutive samples in the interleaved layout:
+    // the channels count rounded up to the SIMD width
+    std::size_t Stride() const;
+
+    // Filters values stored sample by sample, Stride() floats per sample
+    void ProcessInterleaved(float* data, std::size_t samples);
+
+    // Filters a block in place, the block must not be shared
+    void Process(SignalBlock& block);
+
+    void Reset();
+
+private:
+    std::vector<BiquadCoefficients> sections_;
+    int32_t channels_ = 0;
+    std::size_t stride_ = 0;
+    // z1 and z2 of every section, stride_ floats each
+    std::vector<float> state_;
+    std::vector<float> scratch_;
+};
+
+// Straightforward per-channel implementation the cascade is checked against.
+// state holds z1 and z2 of every section.
+void FilterReference(std::span<const BiquadCoefficients> sections, std::span<float> values,
+                     std::span<float> state);
+
+struct FilterBand {
+    std::string name;
+    double low = 0.0;
+    double high = 0.0;
+};
+
+struct FilterBankConfig {
+    double sampleRate = 0.0;
+    // mains frequency, 50 or 60 Hz
+    std::optional<double> notchFrequency;
+    double notchQ = 30.0;
+    std::optional<double> highPassCutoff;
+    std::vector<FilterBand> bands;
+};
+
+// Notch and high-pass applied to the raw signal, then one band-pass per band
+// applied to the cleaned signal
+class FilterBank
+{
+public:
+    struct Output {
+        SignalBlock cleaned;
+        // in the order of the bands in the config
+        std::vector<SignalBlock> bands;
+    };
+
+    FilterBank(FilterBankConfig config, int32_t channels);
+
+    const FilterBankConfig& Config() const;
+
+    const Output& Process(const SignalBlock& raw);
+
+private:
+    FilterBankConfig config_;
+    int32_t channels_;
+    BiquadCascade cleaning_;
+    std::vector<BiquadCascade> bands_;
+    std::vector<float> cleaned_;
+    std::vector<float> band_;
+    Output output_;
+};
+
+} // namespace signal_processing
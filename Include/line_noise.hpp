@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <iir_filter.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Share of the power of every channel at the mains frequency over a sliding
+// window. Each block is demodulated once with a phasor shared by all channels
+// and only its sums are kept, so the window costs nothing per sample. The
+// channels pass a 1 Hz high-pass first, so that electrode drift does not
+// count as signal power; the high-passed block is kept for other consumers.
+// A second, short window slides sample by sample over the same products, so
+// that a burst of mains noise can be pinned to the samples it covers.
+class LineNoiseMeter
+{
+public:
+    LineNoiseMeter(double lineFrequency, double sampleRate, std::size_t windowSamples,
+                   std::size_t sampleWindowSamples, int32_t channels);
+
+    void Push(const SignalBlock& block);
+
+    // Between 0 and 1, empty until the window is filled or when the line
+    // frequency is not below Nyquist
+    std::optional<double> Ratio(int32_t channel) const;
+
+    // Share over the short window ending at every sample of the last block,
+    // 0 until that window is filled, empty when the line frequency is not
+    // below Nyquist
+    std::span<const float> SampleRatios(int32_t channel) const;
+
+    // The last pushed block after the high-pass, every channel shifted by
+    // its first sample so that the filter does not ring on the DC offset
+    const SignalBlock& HighPassed() const;
+
+private:
+    struct BlockSums {
+        std::size_t samples = 0;
+        double inPhase = 0.0;
+        double quadrature = 0.0;
+        double sum = 0.0;
+        double squares = 0.0;
+    };
+
+    // products of one sample, kept to leave the short window
+    struct SampleTerms {
+        float inPhase = 0.0f;
+        float quadrature = 0.0f;
+        float value = 0.0f;
+        float square = 0.0f;
+    };
+
+    struct SlidingSums {
+        std::vector<SampleTerms> terms;
+        std::size_t next = 0;
+        std::size_t filled = 0;
+        double inPhase = 0.0;
+        double quadrature = 0.0;
+        double sum = 0.0;
+        double squares = 0.0;
+    };
+
+    double step_ = 0.0;
+    std::size_t windowSamples_;
+    std::size_t sampleWindowSamples_;
+    // phase of the next sample, radians
+    double phase_ = 0.0;
+    std::vector<float> cos_;
+    std::vector<float> sin_;
+    FilterBank highPass_;
+    std::vector<std::optional<float>> offsets_;
+    SignalBlock highPassed_;
+    std::vector<std::deque<BlockSums>> windows_;
+    std::vector<std::optional<double>> ratios_;
+    std::vector<SlidingSums> sliding_;
+    std::vector<std::vector<float>> sampleRatios_;
+};
+
+} // namespace signal_processing
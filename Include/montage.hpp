@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// One output channel: a weighted sum of input channels
+struct Derivation {
+    std::string name;
+    std::vector<std::pair<int32_t, float>> weights;
+};
+
+// Re-referencing matrix applied to every block of a monopolar stream. Each
+// derivation is a short list of (input, weight) terms, evaluated as
+// multiply-adds over whole channel arrays, so any mix of bipolar, average
+// and linked views comes out of one acquisition with the same timepoints.
+class Montage
+{
+public:
+    Montage() = default;
+    Montage(std::vector<std::string> inputs, std::vector<Derivation> derivations);
+
+    // Every input as it is
+    static Montage Monopolar(std::vector<std::string> inputs);
+
+    // Every input minus the mean of all inputs
+    static Montage CommonAverage(std::vector<std::string> inputs);
+
+    // First half of the inputs against the second half, the pairs of a
+    // bipolar session
+    static Montage Bipolar(std::vector<std::string> inputs);
+
+    // Parses a comma-separated list of derivations over the named inputs:
+    //   "T3"         the channel as it is
+    //   "T3-O1"      bipolar pair
+    //   "T3-avg"     against the common average
+    //   "T3-(O1+O2)" against the mean of several channels, a linked reference
+    //   "monopolar", "average", "bipolar" expand to all channels
+    // Prints the reason and returns nothing when the spec is invalid.
+    static std::optional<Montage> Parse(std::string_view spec, std::vector<std::string> inputs);
+
+    const std::vector<std::string>& Inputs() const;
+
+    std::span<const Derivation> Derivations() const;
+
+    int32_t ChannelsCount() const;
+
+    // Derived block with the same timepoints; inputs missing from the
+    // block count as zeros
+    SignalBlock Apply(const SignalBlock& block) const;
+
+private:
+    std::vector<std::string> inputs_;
+    std::vector<Derivation> derivations_;
+};
+
+} // namespace signal_processing
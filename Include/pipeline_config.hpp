@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+
+
+namespace pipeline
+{
+
+// Classifiers the example can create on a session: those of the SDK and the
+// local signal quality score
+enum class Classifier {
+    Nfb,
+    Productivity,
+    Cardio,
+    Mems,
+    Emotions,
+    PhysiologicalStates,
+    SignalQuality,
+    Count
+};
+
+inline constexpr std::size_t kClassifiersCount = static_cast<std::size_t>(Classifier::Count);
+
+// Where the events of a classifier go
+enum Sink : uint32_t {
+    kSinkLog = 1U << 0,
+    kSinkSocket = 1U << 1,
+    kSinkStore = 1U << 2,
+};
+
+const char* ClassifierName(Classifier classifier);
+
+const char* SinkName(Sink sink);
+
+// Sinks the events of the classifier can be routed to
+uint32_t SupportedSinks(Classifier classifier);
+
+struct ClassifierConfig {
+    bool enabled = false;
+    // Sink bits, a classifier without sinks still feeds the local analytics
+    uint32_t sinks = 0;
+};
+
+// Classifiers and device modes of a deployment. Only enabled classifiers
+// are created, and the device streams PPG and MEMS only when one of them
+// needs it.
+struct PipelineConfig {
+    std::array<ClassifierConfig, kClassifiersCount> classifiers{};
+    // clC_DM_SignalAndResist instead of clC_DM_Signal, when the signal quality
+    // score is enabled unless set
+    std::optional<bool> resistances;
+    // passed to clCEmotions_Create
+    double emotionsSpeed = 0.1;
+    double emotionsMaxSpeed = 1.0;
+    // seconds between physiological states, the SDK default when not set
+    std::optional<float> physiologicalStatesPeriod;
+
+    bool Enabled(Classifier classifier) const;
+
+    bool Routes(Classifier classifier, Sink sink) const;
+
+    bool NeedsPPG() const;
+
+    bool NeedsMEMS() const;
+
+    bool NeedsResistances() const;
+
+    // Classifiers of the SDK take the individual NFB data from the session
+    // calibrator, so any of them needs the eyes-closed calibration
+    bool NeedsCalibration() const;
+};
+
+// What the example always did: NFB, productivity, cardio, MEMS and the signal quality
+PipelineConfig DefaultPipeline();
+
+// Reads a pipeline from lines of "key = value", # starts a comment:
+//   <classifier> = <sinks separated by commas>, empty for none, or off
+//   resistances = on | off, by default on with signal_quality
+//   emotions.speed, emotions.max_speed, physiological_states.period = <number>
+// Classifiers that are not listed are not created.
+std::optional<PipelineConfig> LoadPipeline(const std::string& path);
+
+void PrintPipeline(std::ostream& out, const PipelineConfig& config);
+
+} // namespace pipeline
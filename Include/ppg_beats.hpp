@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <iir_filter.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+struct PpgBeat {
+    // peak time, microseconds
+    uint64_t timepoint = 0;
+    // interval from the previous accepted beat, ms
+    std::optional<double> rrMs;
+    float amplitude = 0.0f;
+};
+
+// Streaming pulse detection on raw PPG: 0.5-8 Hz band-pass, then local
+// maxima above half of a decaying peak envelope, at most one per refractory
+// period. A beat is reported one sample after its peak, so the latency is
+// the filter delay plus one sample period.
+class PpgBeatDetector
+{
+public:
+    using BeatHandler = std::function<void(const PpgBeat& beat)>;
+
+    explicit PpgBeatDetector(double sampleRate);
+
+    void SetBeatHandler(BeatHandler handler);
+
+    void Push(const SignalBlock& block);
+
+private:
+    void ProcessSample(float value, uint64_t timepoint);
+
+    double sampleRate_;
+    std::vector<BiquadCoefficients> bandPass_;
+    std::vector<float> filterState_;
+    std::optional<float> offset_;
+    std::vector<float> filtered_;
+    BeatHandler handler_;
+
+    // last two filtered samples and their timepoints
+    std::array<float, 2> previous_{};
+    std::array<uint64_t, 2> previousTimepoints_{};
+    std::size_t samples_ = 0;
+    float envelope_ = 0.0f;
+    std::optional<uint64_t> lastPeak_;
+    std::optional<uint64_t> lastBeat_;
+};
+
+struct HrvMetrics {
+    std::size_t intervals = 0;
+    double meanRrMs = 0.0;
+    double sdnnMs = 0.0;
+    double rmssdMs = 0.0;
+    // percent of successive differences above 50 ms
+    double pnn50 = 0.0;
+    // Baevsky stress index, AMo / (2 Mo MxDMn) with 50 ms histogram bins
+    double stressIndex = 0.0;
+};
+
+// HRV over the RR intervals of a sliding time window, updated in constant
+// time per beat except for the histogram mode, which scans 50 ms bins
+class HrvEngine
+{
+public:
+    explicit HrvEngine(double windowSec);
+
+    // Adds an interval ending at timepoint (us) and drops the expired ones
+    void Add(uint64_t timepoint, double rrMs);
+
+    // Marks a rejected interval: the next one is not successive to the last,
+    // so RMSSD and pNN50 take no difference across the gap
+    void Break();
+
+    HrvMetrics Metrics() const;
+
+private:
+    struct Interval {
+        uint64_t timepoint;
+        double rrMs;
+        // has a successive difference with the previous interval
+        bool follows;
+    };
+
+    void Remove();
+
+    uint64_t windowUs_;
+    std::deque<Interval> intervals_;
+    double sum_ = 0.0;
+    double squaresSum_ = 0.0;
+    double differenceSquaresSum_ = 0.0;
+    std::size_t differences_ = 0;
+    std::size_t differencesAbove50_ = 0;
+    bool broken_ = false;
+    // indexes into intervals_ shifted by removed_, for the window minimum and maximum
+    std::deque<uint64_t> minimums_;
+    std::deque<uint64_t> maximums_;
+    uint64_t removed_ = 0;
+    std::vector<uint32_t> histogram_;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <block_allocator.hpp>
+
+#include "Capsule/CEEGTimedData.h"
+#include "Capsule/CMEMSTimedData.h"
+#include "Capsule/CPPGTimedData.h"
+
+
+namespace signal_processing
+{
+
+// Alignment of every channel span, enough for AVX-512 loads
+inline constexpr std::size_t kSimdAlignment = block_memory::kBlockAlignment;
+
+// Number of floats between the beginnings of two channels
+constexpr std::size_t AlignedStride(std::size_t samples) {
+    constexpr std::size_t floatsPerLine = kSimdAlignment / sizeof(float);
+    return (samples + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+}
+
+// Samples of one callback in structure-of-arrays layout: one aligned float
+// span per channel and one span of timepoints, in a single pooled block.
+// Copies share the memory, it goes back to the pool with the last copy.
+class SignalBlock
+{
+public:
+    SignalBlock() = default;
+
+    // Block with uninitialized values
+    static SignalBlock Allocate(int32_t channels, int32_t samples) {
+        SignalBlock block;
+        block.channels_ = channels;
+        block.samples_ = samples;
+        block.buffer_ = block_memory::Allocate(block.ChannelsOffset()
+                                               + static_cast<std::size_t>(channels) * block.Stride() * sizeof(float));
+        return block;
+    }
+
+    int32_t ChannelsCount() const {
+        return channels_;
+    }
+
+    int32_t SamplesCount() const {
+        return samples_;
+    }
+
+    bool Empty() const {
+        return samples_ == 0 || channels_ == 0;
+    }
+
+    std::span<const float> Channel(int32_t channel) const {
+        return buffer_.As<const float>(ChannelOffset(channel), static_cast<std::size_t>(samples_));
+    }
+
+    // Mutable view for in-place processing, only while the block is not shared
+    std::span<float> Channel(int32_t channel) {
+        return buffer_.As<float>(ChannelOffset(channel), static_cast<std::size_t>(samples_));
+    }
+
+    // Time points in microseconds
+    std::span<const uint64_t> Timepoints() const {
+        return buffer_.As<const uint64_t>(0, static_cast<std::size_t>(samples_));
+    }
+
+    std::span<uint64_t> Timepoints() {
+        return buffer_.As<uint64_t>(0, static_cast<std::size_t>(samples_));
+    }
+
+    std::size_t Stride() const {
+        return AlignedStride(static_cast<std::size_t>(samples_));
+    }
+
+private:
+    std::size_t ChannelsOffset() const {
+        const std::size_t timepointsSize = static_cast<std::size_t>(samples_) * sizeof(uint64_t);
+        return (timepointsSize + kSimdAlignment - 1) / kSimdAlignment * kSimdAlignment;
+    }
+
+    std::size_t ChannelOffset(int32_t channel) const {
+        return ChannelsOffset() + static_cast<std::size_t>(channel) * Stride() * sizeof(float);
+    }
+
+    block_memory::BlockHandle buffer_;
+    int32_t channels_ = 0;
+    int32_t samples_ = 0;
+};
+
+// Copies the samples x channels grid in a single pass, channel by channel
+inline SignalBlock CopyEEGBlock(clCEEGTimedData data) {
+    const int32_t samples = clCEEGTimedData_GetSamplesCount(data);
+    const int32_t channels = clCEEGTimedData_GetChannelsCount(data);
+    SignalBlock block = SignalBlock::Allocate(channels, samples);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto values = block.Channel(channel);
+        for (int32_t sample = 0; sample < samples; ++sample) {
+            values[sample] = clCEEGTimedData_GetValue(data, channel, sample);
+        }
+    }
+    const auto timepoints = block.Timepoints();
+    for (int32_t sample = 0; sample < samples; ++sample) {
+        timepoints[sample] = clCEEGTimedData_GetTimepoint(data, sample);
+    }
+    return block;
+}
+
+inline SignalBlock CopyPPGBlock(clCPPGTimedData data) {
+    const int32_t samples = clCPPGTimedData_GetCount(data);
+    SignalBlock block = SignalBlock::Allocate(1, samples);
+    const auto values = block.Channel(0);
+    const auto timepoints = block.Timepoints();
+    for (int32_t sample = 0; sample < samples; ++sample) {
+        values[sample] = clCPPGTimedData_GetValue(data, sample);
+        timepoints[sample] = clCPPGTimedData_GetTimepoint(data, sample);
+    }
+    return block;
+}
+
+// MEMS channels in a block
+enum MEMSChannel : int32_t {
+    kAccelerometerX,
+    kAccelerometerY,
+    kAccelerometerZ,
+    kGyroscopeX,
+    kGyroscopeY,
+    kGyroscopeZ,
+    kMEMSChannelsCount
+};
+
+inline SignalBlock CopyMEMSBlock(clCMEMSTimedData data) {
+    const int32_t samples = clCMEMSTimedData_GetCount(data);
+    SignalBlock block = SignalBlock::Allocate(kMEMSChannelsCount, samples);
+    const auto timepoints = block.Timepoints();
+    float* accX = block.Channel(kAccelerometerX).data();
+    float* accY = block.Channel(kAccelerometerY).data();
+    float* accZ = block.Channel(kAccelerometerZ).data();
+    float* gyroX = block.Channel(kGyroscopeX).data();
+    float* gyroY = block.Channel(kGyroscopeY).data();
+    float* gyroZ = block.Channel(kGyroscopeZ).data();
+    for (int32_t sample = 0; sample < samples; ++sample) {
+        const clCPoint3d acc = clCMEMSTimedData_GetAccelerometer(data, sample);
+        const clCPoint3d gyro = clCMEMSTimedData_GetGyroscope(data, sample);
+        accX[sample] = acc.x;
+        accY[sample] = acc.y;
+        accZ[sample] = acc.z;
+        gyroX[sample] = gyro.x;
+        gyroY[sample] = gyro.y;
+        gyroZ[sample] = gyro.z;
+        timepoints[sample] = clCMEMSTimedData_GetTimepoint(data, sample);
+    }
+    return block;
+}
+
+} // namespace signal_processing
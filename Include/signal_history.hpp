@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+inline constexpr std::size_t kCacheLineSize = 64;
+
+// Range of absolute sample indexes
+struct SampleWindow {
+    uint64_t first = 0;
+    std::size_t count = 0;
+};
+
+// Fixed-capacity ring with one writer and any number of readers.
+// Reads never block the writer and never wait: a reader copies the requested
+// samples and then checks which of them the writer has overwritten meanwhile.
+template<typename T>
+class RingBuffer
+{
+    static_assert(std::atomic<T>::is_always_lock_free);
+
+public:
+    // Capacity is rounded up to a power of two
+    explicit RingBuffer(std::size_t capacity)
+            : capacity_{std::bit_ceil(std::max<std::size_t>(capacity, 1))}
+            , mask_{capacity_ - 1}
+            , slots_{static_cast<std::atomic<T>*>(::operator new[](capacity_ * sizeof(std::atomic<T>),
+                                                                    std::align_val_t{kCacheLineSize}))}
+    {
+        std::uninitialized_value_construct_n(slots_.get(), capacity_);
+    }
+
+    std::size_t Capacity() const {
+        return capacity_;
+    }
+
+    // Total number of samples written so far
+    uint64_t Written() const {
+        return written_.load(std::memory_order_acquire);
+    }
+
+    // Writer thread only
+    void Push(std::span<const T> values) {
+        const uint64_t begin = written_.load(std::memory_order_relaxed);
+        // announce the samples about to be overwritten before touching them
+        writing_.store(begin + values.size(), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            slots_[(begin + i) & mask_].store(values[i], std::memory_order_relaxed);
+        }
+        written_.store(begin + values.size(), std::memory_order_release);
+    }
+
+    // Copies samples [first, first + out.size()) into out, so that out[i] is the
+    // sample first + i. Returns the part of the range that was copied intact:
+    // samples not written yet or already overwritten are left out.
+    SampleWindow Read(uint64_t first, std::span<T> out) const {
+        const uint64_t written = written_.load(std::memory_order_acquire);
+        const uint64_t oldest = written > capacity_ ? written - capacity_ : 0;
+        const uint64_t begin = std::max(first, oldest);
+        const uint64_t end = std::min<uint64_t>(first + out.size(), written);
+        if (end <= begin) {
+            return {begin, 0};
+        }
+        for (uint64_t index = begin; index < end; ++index) {
+            out[index - first] = slots_[index & mask_].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t writing = writing_.load(std::memory_order_relaxed);
+        const uint64_t oldestIntact = writing > capacity_ ? writing - capacity_ : 0;
+        const uint64_t intactBegin = std::max(begin, oldestIntact);
+        if (end <= intactBegin) {
+            return {intactBegin, 0};
+        }
+        return {intactBegin, static_cast<std::size_t>(end - intactBegin)};
+    }
+
+    // Copies the newest out.size() samples
+    SampleWindow ReadLatest(std::span<T> out) const {
+        const uint64_t written = Written();
+        const uint64_t first = written > out.size() ? written - out.size() : 0;
+        return Read(first, out.first(static_cast<std::size_t>(std::min<uint64_t>(out.size(), written))));
+    }
+
+private:
+    struct AlignedDeleter {
+        void operator()(std::atomic<T>* slots) const {
+            ::operator delete[](slots, std::align_val_t{kCacheLineSize});
+        }
+    };
+
+    // the counters live on their own cache lines, apart from the samples
+    alignas(kCacheLineSize) std::atomic<uint64_t> written_{0};
+    alignas(kCacheLineSize) std::atomic<uint64_t> writing_{0};
+    alignas(kCacheLineSize) std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<std::atomic<T>[], AlignedDeleter> slots_;
+};
+
+// Sliding window of the last seconds of one modality: a ring per channel and
+// a ring of timepoints sharing the same sample indexes. The capacity is sized
+// from the sample rate observed in the first blocks; samples that arrive before
+// the rate is known are not stored.
+class SignalHistory
+{
+public:
+    // samples needed to estimate the sample rate
+    static constexpr std::size_t kRateEstimationSamples = 32;
+
+    explicit SignalHistory(double seconds)
+            : seconds_{seconds}
+    {
+    }
+
+    // Writer thread only
+    void Push(std::span<const uint64_t> timepoints, std::span<const std::span<const float>> channels) {
+        if (timepoints.empty() || channels.empty()) {
+            return;
+        }
+        if (!ready_.load(std::memory_order_relaxed)) {
+            if (!EstimateRate(timepoints)) {
+                return;
+            }
+            Allocate(channels.size());
+        }
+        const std::size_t channelsCount = std::min(channels.size(), channels_.size());
+        for (std::size_t channel = 0; channel < channelsCount; ++channel) {
+            channels_[channel]->Push(channels[channel].first(timepoints.size()));
+        }
+        // timepoints last, they define how many samples readers may ask for
+        timepoints_->Push(timepoints);
+    }
+
+    void Push(const SignalBlock& block) {
+        static constexpr std::size_t kMaxChannels = 64;
+        std::array<std::span<const float>, kMaxChannels> channels;
+        const auto count = std::min<std::size_t>(static_cast<std::size_t>(block.ChannelsCount()), kMaxChannels);
+        for (std::size_t channel = 0; channel < count; ++channel) {
+            channels[channel] = block.Channel(static_cast<int32_t>(channel));
+        }
+        Push(block.Timepoints(), std::span(channels.data(), count));
+    }
+
+    bool Ready() const {
+        return ready_.load(std::memory_order_acquire);
+    }
+
+    // The accessors below are valid only when Ready() returned true
+
+    double SampleRate() const {
+        return sampleRate_;
+    }
+
+    int32_t ChannelsCount() const {
+        return static_cast<int32_t>(channels_.size());
+    }
+
+    std::size_t Capacity() const {
+        return timepoints_->Capacity();
+    }
+
+    uint64_t SamplesWritten() const {
+        return timepoints_->Written();
+    }
+
+    std::size_t SamplesFor(double seconds) const {
+        return static_cast<std::size_t>(std::ceil(seconds * sampleRate_));
+    }
+
+    SampleWindow Read(int32_t channel, uint64_t first, std::span<float> out) const {
+        return channels_[static_cast<std::size_t>(channel)]->Read(first, out);
+    }
+
+    SampleWindow ReadTimepoints(uint64_t first, std::span<uint64_t> out) const {
+        return timepoints_->Read(first, out);
+    }
+
+private:
+    bool EstimateRate(std::span<const uint64_t> timepoints) {
+        if (estimationSamples_ == 0) {
+            firstTimepoint_ = timepoints.front();
+        }
+        estimationSamples_ += timepoints.size();
+        if (estimationSamples_ < kRateEstimationSamples || timepoints.back() <= firstTimepoint_) {
+            return false;
+        }
+        // timepoints are in microseconds
+        sampleRate_ = static_cast<double>(estimationSamples_ - 1) * 1e6
+                      / static_cast<double>(timepoints.back() - firstTimepoint_);
+        return true;
+    }
+
+    void Allocate(std::size_t channels) {
+        const auto capacity = static_cast<std::size_t>(std::ceil(seconds_ * sampleRate_));
+        channels_.reserve(channels);
+        for (std::size_t channel = 0; channel < channels; ++channel) {
+            channels_.push_back(std::make_unique<RingBuffer<float>>(capacity));
+        }
+        timepoints_ = std::make_unique<RingBuffer<uint64_t>>(capacity);
+        ready_.store(true, std::memory_order_release);
+    }
+
+    double seconds_;
+    double sampleRate_ = 0.0;
+    uint64_t firstTimepoint_ = 0;
+    std::size_t estimationSamples_ = 0;
+    std::vector<std::unique_ptr<RingBuffer<float>>> channels_;
+    std::unique_ptr<RingBuffer<uint64_t>> timepoints_;
+    std::atomic<bool> ready_{false};
+};
+
+} // namespace signal_processing
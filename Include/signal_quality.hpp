@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <line_noise.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Signal statistics are in the units of the stream, volts for Capsule EEG,
+// resistances in ohms
+struct SignalQualityConfig {
+    double sampleRate = 0.0;
+    double windowSec = 2.0;
+    double publishHz = 1.0;
+    // contact is good up to goodResistance and useless from badResistance on
+    float goodResistance = 200e3f;
+    float badResistance = 2e6f;
+    // standard deviation of usable EEG after a 1 Hz high-pass
+    float minStdDev = 0.5e-6f;
+    float maxStdDev = 100e-6f;
+    // excess kurtosis of clean EEG stays near 0, spikes and blinks raise it
+    float kurtosisLimit = 2.0f;
+    float kurtosisRange = 8.0f;
+};
+
+struct ChannelQuality {
+    // 0 (unusable) to 1 (clean), the weakest of the partial scores
+    float score = 0.0f;
+    std::optional<float> resistance;
+    float stdDev = 0.0f;
+    float kurtosis = 0.0f;
+    float lineNoiseRatio = 0.0f;
+};
+
+struct SignalQualityReport {
+    uint64_t timepoint = 0;
+    std::span<const ChannelQuality> channels;
+    // mean of the channel scores
+    float score = 0.0f;
+};
+
+// Per-channel contact and signal quality, fused from the resistances measured
+// in clC_DM_SignalAndResist mode and from rolling statistics of the signal
+// itself: variance and kurtosis of the high-passed block and the share of
+// mains noise, both read from a LineNoiseMeter fed elsewhere, normally the one
+// of the ArtifactDetector. Moments are kept per block and merged for the window,
+// so the report costs a pass over the block and a few block summaries.
+class SignalQualityEngine
+{
+public:
+    using ReportHandler = std::function<void(const SignalQualityReport& report)>;
+
+    // lineNoise must outlive the engine and be pushed the same blocks before it
+    SignalQualityEngine(SignalQualityConfig config, int32_t channels, const LineNoiseMeter& lineNoise);
+
+    const SignalQualityConfig& Config() const;
+
+    void SetReportHandler(ReportHandler handler);
+
+    void SetResistance(int32_t channel, float resistance);
+
+    void Push(const SignalBlock& block);
+
+private:
+    // count, mean and central moments 2 to 4 of a run of samples
+    struct Moments {
+        double count = 0.0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        double m3 = 0.0;
+        double m4 = 0.0;
+    };
+
+    static Moments Merge(const Moments& a, const Moments& b);
+    void Publish(uint64_t timepoint);
+
+    SignalQualityConfig config_;
+    int32_t channels_;
+    std::size_t windowSamples_;
+    uint64_t publishPeriod_;
+    std::optional<uint64_t> nextPublish_;
+    ReportHandler handler_;
+
+    std::vector<std::deque<Moments>> moments_;
+    const LineNoiseMeter* lineNoise_;
+    std::vector<std::optional<float>> resistances_;
+    std::vector<ChannelQuality> qualities_;
+};
+
+} // namespace signal_processing
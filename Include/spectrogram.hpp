@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <fft.hpp>
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+struct SpectrogramConfig {
+    double sampleRate = 0.0;
+    // transform length, rounded up to a power of two: the bin width is sampleRate / fftSamples
+    std::size_t fftSamples = 256;
+    // new samples between two columns
+    std::size_t hopSamples = 25;
+    // bins above are not kept
+    double maxFrequency = 45.0;
+    // columns viewers can look back
+    std::size_t columns = 600;
+};
+
+// One column of the spectrogram, pointing into the ring
+struct SpectrogramColumn {
+    uint64_t index = 0;
+    // timepoint of the newest sample of the column, microseconds
+    uint64_t timepoint = 0;
+    // power in dB, [channel * BinsCount() + bin]
+    std::span<const float> values;
+};
+
+// Streaming short-time Fourier transform of every channel. A column is
+// computed every hopSamples from the last fftSamples with a Hann window and
+// written straight into a ring of columns, which viewers read in place.
+// The ring keeps kSpareColumns beyond the configured look-back, so a view
+// of a listed column stays valid while the writer adds that many more;
+// Intact tells afterwards whether it did.
+class Spectrogram
+{
+public:
+    static constexpr std::size_t kSpareColumns = 64;
+
+    Spectrogram(SpectrogramConfig config, int32_t channels);
+
+    const SpectrogramConfig& Config() const;
+
+    int32_t ChannelsCount() const;
+
+    std::size_t BinsCount() const;
+
+    double BinWidth() const;
+
+    // Writer thread only
+    void Push(const SignalBlock& block);
+
+    uint64_t ColumnsWritten() const;
+
+    // Columns from ColumnsWritten() - Config().columns to ColumnsWritten() - 1,
+    // no copy is made
+    std::optional<SpectrogramColumn> Column(uint64_t index) const;
+
+    // True if the column has not been overwritten since it was read
+    bool Intact(uint64_t index) const;
+
+private:
+    void Update(uint64_t timepoint);
+
+    SpectrogramConfig config_;
+    int32_t channels_;
+    FftPlan plan_;
+    std::vector<float> window_;
+    std::size_t bins_;
+    float scale_;
+
+    // channels x fftSamples ring of the last samples
+    std::vector<float> history_;
+    std::size_t writeIndex_ = 0;
+    std::size_t filled_ = 0;
+    std::size_t sinceUpdate_ = 0;
+    std::vector<float> segment_;
+    std::vector<std::complex<float>> spectrum_;
+
+    std::size_t capacity_;
+    std::size_t columnStride_;
+    std::vector<float> columns_;
+    std::vector<uint64_t> timepoints_;
+    std::atomic<uint64_t> written_{0};
+    // columns written plus the one being written, announced before its slot is touched
+    std::atomic<uint64_t> writing_{0};
+};
+
+} // namespace signal_processing
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <ostream>
+#include <string>
+
+
+namespace instrumentation
+{
+
+// Lifecycle events of the example application, in the order they usually happen
+enum class StartupEvent {
+    ClientConnecting,
+    ClientConnected,
+    DeviceListReceived,
+    DeviceConnected,
+    LicenseVerified,
+    SessionStartRequested,
+    SessionStarted,
+    CalibratorReady,
+    Calibrated,
+    FirstProductivityValue,
+    Count
+};
+
+// Phase of the startup, measured between two lifecycle events
+struct StartupPhase {
+    const char* name;
+    StartupEvent from;
+    StartupEvent to;
+};
+
+inline constexpr std::array<StartupPhase, 8> kStartupPhases{{
+    {"discovery", StartupEvent::ClientConnected, StartupEvent::DeviceListReceived},
+    {"connect", StartupEvent::DeviceListReceived, StartupEvent::DeviceConnected},
+    {"license", StartupEvent::DeviceConnected, StartupEvent::LicenseVerified},
+    {"sessionStart", StartupEvent::SessionStartRequested, StartupEvent::SessionStarted},
+    {"calibratorReady", StartupEvent::SessionStarted, StartupEvent::CalibratorReady},
+    {"calibration", StartupEvent::CalibratorReady, StartupEvent::Calibrated},
+    {"firstProductivity", StartupEvent::SessionStarted, StartupEvent::FirstProductivityValue},
+    {"total", StartupEvent::ClientConnecting, StartupEvent::FirstProductivityValue},
+}};
+
+const char* StartupEventName(StartupEvent event);
+
+// Records monotonic timestamps of lifecycle events and reports per-phase durations.
+// Not thread-safe: marks are expected from the thread calling clCClient_Update.
+class StartupTimeline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    StartupTimeline() = default;
+
+    // Only the first occurrence of every event is recorded
+    void Mark(StartupEvent event);
+
+    void SetDeviceType(const std::string& deviceType);
+
+    // Milliseconds since ClientConnecting (or since the first marked event)
+    std::optional<double> EventOffsetMs(StartupEvent event) const;
+
+    std::optional<double> PhaseDurationMs(const StartupPhase& phase) const;
+
+    // Writes the timeline as a single line JSON object
+    void Report(std::ostream& out) const;
+
+    // Appends this run to the CSV history file, once per run
+    bool AppendToHistory(const std::string& path);
+
+private:
+    std::optional<Clock::time_point> Origin() const;
+
+    std::array<std::optional<Clock::time_point>, static_cast<std::size_t>(StartupEvent::Count)> events_{};
+    std::string deviceType_{"unknown"};
+    bool appended_{false};
+};
+
+// Reads the CSV history and writes p50/p95 of every phase grouped by device type
+void ReportStartupHistory(const std::string& path, std::ostream& out);
+
+} // namespace instrumentation
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Resamples several timestamped streams (EEG, PPG, MEMS, ...) onto one grid
+// with linear interpolation and emits fused frames. A frame is emitted once
+// every stream has data past it, or when the newest data of any stream is
+// maxLatency ahead of it: lagging streams then hold their last value.
+class StreamAligner
+{
+public:
+    // Fused frames: one channel per stream channel in the order streams were
+    // added, timepoints on the output grid. staleStreams has a bit set for every
+    // stream that was held instead of interpolated in some frame of the block.
+    using FramesHandler = std::function<void(const SignalBlock& frames, uint32_t staleStreams)>;
+
+    static constexpr std::size_t kMaxStreams = 32;
+
+    StreamAligner(double outputRate, std::chrono::microseconds maxLatency);
+
+    // Returns the index of the stream
+    std::size_t AddStream(std::string name, int32_t channels);
+
+    void SetFramesHandler(FramesHandler handler);
+
+    void Push(std::size_t stream, const SignalBlock& block);
+
+    int32_t FrameChannelsCount() const;
+
+    std::size_t ChannelOffset(std::size_t stream) const;
+
+    const std::string& StreamName(std::size_t stream) const;
+
+    double OutputRate() const;
+
+private:
+    // Received samples in a ring, so that trimming the consumed ones costs
+    // nothing. The capacity is a power of two and only doubles while the
+    // span between the next frame and the newest sample still grows.
+    struct Stream {
+        std::string name;
+        int32_t channels = 0;
+        std::size_t channelOffset = 0;
+        std::vector<uint64_t> timepoints;
+        // capacity floats per channel
+        std::vector<float> values;
+        std::size_t capacity = 0;
+        // slot of the oldest sample and the number of samples
+        std::size_t head = 0;
+        std::size_t size = 0;
+        // index from the oldest sample of the last sample at or before the next frame
+        std::size_t cursor = 0;
+
+        std::size_t Slot(std::size_t index) const {
+            return (head + index) & (capacity - 1);
+        }
+
+        uint64_t Timepoint(std::size_t index) const {
+            return timepoints[Slot(index)];
+        }
+    };
+
+    uint64_t FrameTimepoint(uint64_t frame) const;
+    bool Start();
+    void EmitReadyFrames();
+    uint32_t Interpolate(Stream& stream, std::span<const uint64_t> frameTimepoints, SignalBlock& frames);
+    void Trim(Stream& stream);
+    void Grow(Stream& stream);
+
+    double outputRate_;
+    uint64_t maxLatency_;
+    std::vector<Stream> streams_;
+    FramesHandler handler_;
+
+    std::optional<uint64_t> firstDataTimepoint_;
+    std::optional<uint64_t> gridOrigin_;
+    uint64_t nextFrame_ = 0;
+    uint64_t newestTimepoint_ = 0;
+
+    // per-frame interpolation position, reused between blocks
+    std::vector<uint64_t> frameTimepoints_;
+    std::vector<std::size_t> sampleSlots_;
+    std::vector<std::size_t> nextSlots_;
+    std::vector<float> weights_;
+};
+
+} // namespace signal_processing
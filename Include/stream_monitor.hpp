@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <signal_block.hpp>
+
+
+namespace signal_processing
+{
+
+// Snapshot of the counters of one stream
+struct StreamMonitorStats {
+    uint64_t blocks = 0;
+    uint64_t samples = 0;
+    // blocks that needed a sample-by-sample check
+    uint64_t scannedBlocks = 0;
+    uint64_t gaps = 0;
+    uint64_t missingSamples = 0;
+    uint64_t duplicates = 0;
+    uint64_t outOfOrder = 0;
+    // 0 until the rate is inferred
+    double sampleRate = 0.0;
+    // deviation of block arrival from the duration of the previous block, ms
+    double jitterMeanMs = 0.0;
+    double jitterStdDevMs = 0.0;
+    double jitterMaxMs = 0.0;
+};
+
+// Watches the timepoints of consecutive blocks of one stream. A healthy block
+// costs one pass over its intervals and a constant amount of bookkeeping; only
+// a block with an interval off the nominal rate is classified sample by sample
+// into gaps, duplicates and samples going back in time.
+// Observe must be called from one thread, Stats from any thread.
+class StreamMonitor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // Called for every gap: timepoints of the samples around it, microseconds
+    using GapHandler = std::function<void(uint64_t before, uint64_t after, uint64_t missingSamples)>;
+
+    explicit StreamMonitor(std::string name);
+
+    const std::string& Name() const;
+
+    void SetGapHandler(GapHandler handler);
+
+    void Observe(const SignalBlock& block, Clock::time_point arrival = Clock::now());
+
+    StreamMonitorStats Stats() const;
+
+private:
+    void InferRate(std::span<const uint64_t> timepoints);
+    bool Continues(std::span<const uint64_t> timepoints) const;
+    void Scan(std::span<const uint64_t> timepoints);
+    void UpdateJitter(std::size_t samples, Clock::time_point arrival);
+
+    std::string name_;
+    GapHandler gapHandler_;
+
+    // nominal interval between samples, us
+    std::optional<double> period_;
+    std::vector<uint64_t> rateIntervals_;
+    std::optional<uint64_t> lastTimepoint_;
+
+    std::optional<Clock::time_point> lastArrival_;
+    std::size_t lastBlockSamples_ = 0;
+    // Welford accumulators of the arrival jitter
+    uint64_t jitterCount_ = 0;
+    double jitterMean_ = 0.0;
+    double jitterM2_ = 0.0;
+
+    std::atomic<uint64_t> blocks_{0};
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<uint64_t> scannedBlocks_{0};
+    std::atomic<uint64_t> gaps_{0};
+    std::atomic<uint64_t> missingSamples_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    std::atomic<uint64_t> outOfOrder_{0};
+    std::atomic<double> sampleRate_{0.0};
+    std::atomic<double> jitterMeanMs_{0.0};
+    std::atomic<double> jitterStdDevMs_{0.0};
+    std::atomic<double> jitterMaxMs_{0.0};
+};
+
+void PrintStats(std::ostream& out, const StreamMonitor& monitor);
+
+} // namespace signal_processing
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+
+namespace time_series
+{
+
+// Levels kept for every series, from the raw points to hourly rollups
+enum class Resolution {
+    Raw,
+    Second,
+    Minute,
+    Hour,
+    Count
+};
+
+const char* ResolutionName(Resolution resolution);
+
+// Bucket width of a rollup level, 0 for the raw points
+int64_t ResolutionMs(Resolution resolution);
+
+// Finest level returning at most maxPoints over the range
+Resolution ResolutionFor(int64_t fromMs, int64_t toMs, std::size_t maxPoints);
+
+// A raw point has min == max == mean and count 1, a rollup is timestamped
+// with the start of its bucket
+struct Aggregate {
+    int64_t timestamp = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+    float mean = 0.0f;
+    uint32_t count = 0;
+};
+
+// Points sharing one timestamp column and several float columns, compressed
+// as in Gorilla: delta-of-delta timestamps and values XORed with the
+// previous value of their column. Points are only appended.
+class EncodedChunk
+{
+public:
+    explicit EncodedChunk(std::size_t columns);
+
+    // Sealed chunk read back from a file
+    EncodedChunk(std::size_t columns, uint32_t count, int64_t first, int64_t last, uint64_t bitsCount,
+                 std::vector<uint8_t> bytes);
+
+    std::size_t ColumnsCount() const;
+
+    uint32_t Count() const;
+
+    int64_t First() const;
+
+    int64_t Last() const;
+
+    uint64_t BitsCount() const;
+
+    std::span<const uint8_t> Bytes() const;
+
+    void Append(int64_t timestamp, std::span<const float> values);
+
+    // Appends the decoded timestamps and the values, ColumnsCount() per point
+    void Decode(std::vector<int64_t>& timestamps, std::vector<float>& values) const;
+
+private:
+    void WriteBits(uint64_t value, int bits);
+
+    std::size_t columns_;
+    uint32_t count_ = 0;
+    int64_t first_ = 0;
+    int64_t last_ = 0;
+    std::vector<uint8_t> bytes_;
+    uint64_t bitsCount_ = 0;
+
+    // encoder state
+    int64_t lastDelta_ = 0;
+    std::vector<uint32_t> lastValues_;
+    std::vector<int> leading_;
+    std::vector<int> trailing_;
+};
+
+struct StoreStats {
+    std::size_t series = 0;
+    std::array<uint64_t, static_cast<std::size_t>(Resolution::Count)> points{};
+    std::array<uint64_t, static_cast<std::size_t>(Resolution::Count)> bytes{};
+    // points older than the last one of their series
+    uint64_t rejected = 0;
+};
+
+void PrintStats(std::ostream& out, const StoreStats& stats);
+
+// Append-only store of named metrics. Every point is kept raw and folded into
+// 1 s, 1 min and 1 h min/max/mean rollups as it is appended, so a range query
+// decodes only the level it asks for. Full chunks are appended to the file,
+// which is read back when the store is opened. Not thread-safe.
+class Store
+{
+public:
+    static constexpr uint32_t kChunkPoints = 1024;
+
+    // An empty path keeps the store in memory
+    explicit Store(std::string path = {});
+    ~Store();
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    // Timestamps in milliseconds, increasing within a series. NaN and
+    // infinities are kept raw but left out of the rollups.
+    bool Append(const std::string& series, int64_t timestampMs, float value);
+
+    // Points or rollups with a timestamp from fromMs to toMs, including the
+    // bucket still being filled. Rollups of one bucket split by a Flush are
+    // merged into one.
+    std::vector<Aggregate> Range(const std::string& series, int64_t fromMs, int64_t toMs,
+                                 Resolution resolution) const;
+
+    std::optional<int64_t> LastTimestamp(const std::string& series) const;
+
+    std::vector<std::string> SeriesNames() const;
+
+    StoreStats Stats() const;
+
+    // Closes the open buckets and writes every chunk to the file. Points
+    // appended afterwards to the same bucket give a second rollup with the
+    // same start, which Range merges.
+    void Flush();
+
+private:
+    struct Bucket {
+        int64_t start = 0;
+        float min = 0.0f;
+        float max = 0.0f;
+        double sum = 0.0;
+        uint32_t count = 0;
+    };
+
+    struct Level {
+        std::vector<EncodedChunk> sealed;
+        std::optional<EncodedChunk> open;
+    };
+
+    struct Series {
+        std::array<Level, static_cast<std::size_t>(Resolution::Count)> levels;
+        // open bucket of every rollup level
+        std::array<std::optional<Bucket>, static_cast<std::size_t>(Resolution::Count)> buckets;
+        std::optional<int64_t> last;
+    };
+
+    void Load();
+    void AppendToLevel(const std::string& name, Series& series, Resolution resolution, int64_t timestamp,
+                       std::span<const float> values);
+    void CloseBucket(const std::string& name, Series& series, Resolution resolution);
+    void Seal(const std::string& name, Level& level, Resolution resolution);
+    void WriteChunk(const std::string& name, Resolution resolution, const EncodedChunk& chunk);
+
+    std::string path_;
+    std::ofstream file_;
+    std::map<std::string, Series> series_;
+    uint64_t rejected_ = 0;
+};
+
+} // namespace time_series
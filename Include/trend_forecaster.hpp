@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+
+namespace signal_processing
+{
+
+struct TrendForecasterConfig {
+    double threshold = 0.0;
+    // true when the series reaches the threshold by rising, false by falling
+    bool rising = true;
+    // memory of the fit: the weight of a value halves every ln(2) * timeConstant
+    double timeConstantSec = 300.0;
+    // z of the bounds, 1.96 for 95 %
+    double confidence = 1.96;
+    // updates before the first forecast
+    uint64_t minUpdates = 30;
+};
+
+struct TrendForecast {
+    // fitted value at the last update and its slope, per second
+    double level = 0.0;
+    double slope = 0.0;
+    double slopeStdDev = 0.0;
+    // seconds until the fitted line reaches the threshold, 0 when it is already
+    // there, nullopt when the series moves away from it
+    std::optional<double> timeToThreshold;
+    // the same for the steepest and the flattest slope within the bounds;
+    // no latest when the flattest slope never reaches the threshold
+    std::optional<double> earliest;
+    std::optional<double> latest;
+};
+
+// Straight line fitted to a series by exponentially weighted least squares
+// and extrapolated to a threshold. The fit keeps weighted means and
+// co-moments only, so an update costs the same however long the series is.
+// The bounds assume independent noise around the line.
+class TrendForecaster
+{
+public:
+    explicit TrendForecaster(TrendForecasterConfig config);
+
+    const TrendForecasterConfig& Config() const;
+
+    // timepoint in microseconds, must not decrease
+    void Update(uint64_t timepoint, double value);
+
+    // nullopt before minUpdates or while all updates share a timepoint
+    std::optional<TrendForecast> Forecast() const;
+
+    uint64_t UpdatesCount() const;
+
+    void Reset();
+
+private:
+    TrendForecasterConfig config_;
+    std::optional<uint64_t> origin_;
+    uint64_t updates_ = 0;
+    // seconds since the origin
+    double lastTime_ = 0.0;
+    // sums of the weights, of the squared weights and of t and t^2 with squared weights
+    double weight_ = 0.0;
+    double weight2_ = 0.0;
+    double time2_ = 0.0;
+    double timeSquares2_ = 0.0;
+    double meanTime_ = 0.0;
+    double meanValue_ = 0.0;
+    double timeM2_ = 0.0;
+    double valueM2_ = 0.0;
+    double coMoment_ = 0.0;
+};
+
+} // namespace signal_processing
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+
+namespace signal_processing
+{
+
+// Values of a sliding time window kept in an indexable skip list, so that
+// a push, an expiry and the lookup of any percentile each take O(log n).
+// A local counterpart of clCNFBBaseline that answers several percentiles
+// of the same window without rescanning it.
+class WindowedQuantiles
+{
+public:
+    // window in the units of the timestamps
+    explicit WindowedQuantiles(int64_t window);
+
+    // Timestamps must not decrease. Values older than timestamp - window are dropped.
+    // NaN and infinities are ignored, they have no place in the ordering.
+    void Push(float value, int64_t timestamp);
+
+    // Drops the values older than now - window
+    void Expire(int64_t now);
+
+    std::size_t Size() const;
+
+    // percentile from 0 to 100, linear interpolation between the closest
+    // ranks; NaN for an empty window
+    float Quantile(double percentile) const;
+
+    void Quantiles(std::span<const double> percentiles, std::span<float> out) const;
+
+private:
+    static constexpr std::size_t kMaxLevels = 20;
+    static constexpr uint32_t kHead = 0;
+    static constexpr uint32_t kTail = 1;
+
+    struct Node {
+        float value = 0.0f;
+        // insertion number, makes equal values distinct
+        uint64_t sequence = 0;
+        uint32_t levels = 0;
+        std::array<uint32_t, kMaxLevels> next{};
+        // number of nodes skipped by next[level], the node it points to included
+        std::array<uint32_t, kMaxLevels> width{};
+    };
+
+    struct Entry {
+        int64_t timestamp;
+        float value;
+        uint64_t sequence;
+    };
+
+    bool Before(uint32_t node, float value, uint64_t sequence) const;
+    uint32_t RandomLevels();
+    uint32_t NewNode();
+    void Insert(float value, uint64_t sequence);
+    void Erase(float value, uint64_t sequence);
+    // rank from 0
+    float At(std::size_t rank) const;
+
+    int64_t window_;
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> freeNodes_;
+    std::deque<Entry> entries_;
+    uint64_t nextSequence_ = 0;
+    uint64_t random_ = 0x9E3779B97F4A7C15ULL;
+};
+
+} // namespace signal_processing
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <charconv>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -45,6 +46,27 @@ void askLicense(std::string* licenseKey) {
 }
 } // namespace
 
+// Returns the value of a "--flag=value" argument
+std::optional<std::string_view> findArgValue(int argc, char* argv[], std::string_view flag) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg.size() > flag.size() && arg.starts_with(flag) && arg[flag.size()] == '=') {
+            return arg.substr(flag.size() + 1);
+        }
+    }
+    return std::nullopt;
+}
+
+// Returns the number of a "--flag=<number>" argument
+std::optional<double> findArgNumber(int argc, char* argv[], std::string_view flag) {
+    const auto value = findArgValue(argc, argv, flag);
+    double number = 0.0;
+    if (!value || std::from_chars(value->data(), value->data() + value->size(), number).ec != std::errc{}) {
+        return std::nullopt;
+    }
+    return number;
+}
+
 void parseArgs(int argc, char* argv[], std::string* licenseKey, bool* bipolarMode, bool* writeCsv) {
     using namespace std::string_view_literals;
     constexpr std::array flagsToFind{
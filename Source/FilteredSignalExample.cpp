@@ -1,9 +1,15 @@
+#include <bit>
 #include <chrono>
 #include <format>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "ExampleUtils.hpp"
 
@@ -11,6 +17,10 @@
 #include "Capsule/CDevice.h"
 #include "Capsule/CLicenseManager.h"
 #include "Capsule/CSession.h"
+#include <coherence.hpp>
+#include <montage.hpp>
+#include <signal_block.hpp>
+#include <stream_monitor.hpp>
 
 using namespace std::chrono_literals;
 
@@ -26,6 +36,58 @@ uint32_t deviceConnectionTime = 0;
 bool writeCsv = false;
 bool bipolarMode = false;
 
+// The session is always monopolar; bipolar and other derivations are computed
+// locally from it. Set with --montage=<spec>, --bipolar selects the bipolar pairs.
+std::string montageSpec;
+std::optional<signal_processing::Montage> montage;
+
+// Coherence and power asymmetry of left/right channel pairs, by default the
+// homologous pairs among the device channels, or --pairs=F3:F4,... The engine
+// is created once the EEG rate is known.
+std::string pairsSpec;
+std::vector<signal_processing::ChannelPair> channelPairs;
+signal_processing::StreamMonitor eegMonitor("EEG");
+std::unique_ptr<signal_processing::CoherenceEngine> coherence;
+std::ofstream coherenceStream;
+
+void onCoherence(uint64_t timepoint, std::span<const float> pairCoherence, std::span<const float> asymmetry) {
+    const auto& bands = coherence->Config().bands;
+    const auto pairs = coherence->Pairs();
+    for (std::size_t pair = 0; pair < pairs.size(); ++pair) {
+        std::cout << "Pair " << pairs[pair].name << ':';
+        for (std::size_t band = 0; band < bands.size(); ++band) {
+            const std::size_t index = pair * bands.size() + band;
+            std::cout << ' ' << bands[band].name << " coherence " << pairCoherence[index]
+                      << " asymmetry " << asymmetry[index];
+            if (writeCsv && coherenceStream.is_open()) {
+                coherenceStream << timepoint << ',' << pairs[pair].name << ',' << bands[band].name << ','
+                                << pairCoherence[index] << ',' << asymmetry[index] << '\n';
+            }
+        }
+        std::cout << std::endl;
+    }
+}
+
+void analyseCoherence(const signal_processing::SignalBlock& block) {
+    using namespace signal_processing;
+    eegMonitor.Observe(block);
+    if (channelPairs.empty()) {
+        return;
+    }
+    if (!coherence) {
+        const double sampleRate = eegMonitor.Stats().sampleRate;
+        if (sampleRate <= 0.0) {
+            return;
+        }
+        CoherenceConfig config;
+        config.sampleRate = sampleRate;
+        config.segmentSamples = std::bit_floor(static_cast<std::size_t>(sampleRate));
+        coherence = std::make_unique<CoherenceEngine>(std::move(config), channelPairs);
+        coherence->SetMeasuresHandler(onCoherence);
+    }
+    coherence->Push(block);
+}
+
 bool clientStopRequested = false;
 bool clientDisconnecting = false;
 
@@ -40,28 +102,57 @@ void onLicenseVerified(clCLicenseManager, bool result, clCLicenseError) {
     }
 }
 
-std::ofstream sessionEegStream;
-void onSessionEEGData(clCSession, clCEEGTimedData eegData) {
-    const int32_t samples = clCEEGTimedData_GetSamplesCount(eegData);
-    const int32_t channels = clCEEGTimedData_GetChannelsCount(eegData);
-    std::cout << "Session EEG data received " << channels << " channels and " << samples << " samples" << std::endl;
-
-    if (!writeCsv || !sessionEegStream.is_open()) {
-        return;
-    }
-    for (int32_t i = 0; i < samples; ++i) {
-        sessionEegStream << clCEEGTimedData_GetTimepoint(eegData, i) << ',';
+void writeBlock(std::ofstream& stream, const signal_processing::SignalBlock& block) {
+    const auto timepoints = block.Timepoints();
+    const int32_t channels = block.ChannelsCount();
+    for (int32_t i = 0; i < block.SamplesCount(); ++i) {
+        stream << timepoints[i] << ',';
         for (int32_t j = 0; j < channels; ++j) {
-            sessionEegStream << clCEEGTimedData_GetValue(eegData, j, i);
+            stream << block.Channel(j)[i];
             if (j == channels - 1) {
-                sessionEegStream << std::endl;
+                stream << std::endl;
             } else {
-                sessionEegStream << ',';
+                stream << ',';
             }
         }
     }
 }
 
+void writeHeader(std::ofstream& stream, const std::vector<std::string>& names) {
+    stream << "timestamp";
+    for (const auto& name : names) {
+        stream << ',' << name;
+    }
+    stream << std::endl;
+}
+
+std::ofstream sessionEegStream;
+std::ofstream montageStream;
+void onSessionEEGData(clCSession, clCEEGTimedData eegData) {
+    const signal_processing::SignalBlock block = signal_processing::CopyEEGBlock(eegData);
+    const int32_t samples = block.SamplesCount();
+    const int32_t channels = block.ChannelsCount();
+    std::cout << "Session EEG data received " << channels << " channels and " << samples << " samples" << std::endl;
+    analyseCoherence(block);
+    if (!montage) {
+        if (writeCsv && sessionEegStream.is_open()) {
+            writeBlock(sessionEegStream, block);
+        }
+        return;
+    }
+
+    const signal_processing::SignalBlock derived = montage->Apply(block);
+    std::cout << "Derived " << derived.ChannelsCount() << " channels:";
+    for (int32_t channel = 0; channel < derived.ChannelsCount(); ++channel) {
+        std::cout << ' ' << montage->Derivations()[channel].name << ' ' << derived.Channel(channel)[0];
+    }
+    std::cout << std::endl;
+    if (writeCsv && sessionEegStream.is_open()) {
+        writeBlock(sessionEegStream, block);
+        writeBlock(montageStream, derived);
+    }
+}
+
 void onSessionStarted(clCSession session) {
     std::cout << "Session started" << std::endl;
     clCString sessionUUID = clCSession_GetSessionUUID(session);
@@ -69,21 +160,46 @@ void onSessionStarted(clCSession session) {
     clCString_Free(sessionUUID);
     clCSession_MarkActivity(session, clCUserActivity1);
 
+    std::vector<std::string> channels;
+    clCDeviceChannelNames channelNames = clCDevice_GetChannelNames(device);
+    for (int32_t i = 0; i < clCDevice_GetChannelsCount(channelNames); ++i) {
+        clCString channelName = clCDevice_GetChannelNameByIndex(channelNames, i);
+        channels.emplace_back(clCString_CStr(channelName));
+        clCString_Free(channelName);
+    }
+    if (!montageSpec.empty()) {
+        montage = signal_processing::Montage::Parse(montageSpec, channels);
+        if (!montage) {
+            std::cerr << "Invalid montage, writing the monopolar channels only" << std::endl;
+        }
+    }
+
+    if (pairsSpec.empty()) {
+        channelPairs = signal_processing::HomologousPairs(channels);
+    } else {
+        const auto pairs = signal_processing::ParsePairs(pairsSpec, channels);
+        channelPairs = pairs.value_or(std::vector<signal_processing::ChannelPair>{});
+    }
+    std::cout << "Channel pairs:";
+    for (const auto& pair : channelPairs) {
+        std::cout << ' ' << pair.name;
+    }
+    std::cout << std::endl;
+
     if (writeCsv) {
         sessionEegStream.open("session_eeg.csv");
-        sessionEegStream << "timestamp,";
-        clCDeviceChannelNames channelNames = clCDevice_GetChannelNames(device);
-        auto channelsCount = clCDevice_GetChannelsCount(channelNames);
-        if (clCSession_IsBipolarMode(session)) {
-            channelsCount /= 2;
-        }
-        for (int32_t i = 0; i < channelsCount; ++i) {
-            sessionEegStream << "channel_" << i;
-            if (i == channelsCount - 1) {
-                sessionEegStream << std::endl;
-            } else {
-                sessionEegStream << ',';
+        writeHeader(sessionEegStream, channels);
+        if (montage) {
+            montageStream.open("session_montage.csv");
+            std::vector<std::string> derivations;
+            for (const auto& derivation : montage->Derivations()) {
+                derivations.push_back(derivation.name);
             }
+            writeHeader(montageStream, derivations);
+        }
+        if (!channelPairs.empty()) {
+            coherenceStream.open("session_coherence.csv");
+            coherenceStream << "timestamp,pair,band,coherence,asymmetry\n";
         }
     }
 
@@ -233,11 +349,7 @@ void ClientLoop() {
         if (deviceConnectionTime && s_time == deviceConnectionTime + 2 * kMsSec && !session) {
             // Create session
             auto error = clC_Error_OK;
-            if (bipolarMode) {
-                session = clCClient_CreateSessionWithError(client, device, &error);
-            } else {
-                session = clCClient_CreateSessionWithMonopolarChannelsWithError(client, device, &error);
-            }
+            session = clCClient_CreateSessionWithMonopolarChannelsWithError(client, device, &error);
 
             // Get session events
             clCSessionDelegate onSessionStartedEvent = clCSession_GetOnSessionStartedEvent(session);
@@ -272,15 +384,23 @@ void ClientLoop() {
     if (sessionEegStream.is_open()) {
         sessionEegStream.close();
     }
+    if (montageStream.is_open()) {
+        montageStream.close();
+    }
+    if (coherenceStream.is_open()) {
+        coherenceStream.close();
+    }
 
     exit(0);
 }
 
 int main(int argc, char* argv[]) {
     parseArgs(argc, argv, &licenseKey, &bipolarMode, &writeCsv);
+    montageSpec = std::string(findArgValue(argc, argv, "--montage").value_or(bipolarMode ? "bipolar" : ""));
+    pairsSpec = std::string(findArgValue(argc, argv, "--pairs").value_or(""));
 
     std::cout << std::boolalpha
-              << "Bipolar mode: " << bipolarMode << '\n'
+              << "Montage: " << (montageSpec.empty() ? "monopolar" : montageSpec) << '\n'
               << "Write to CSV: " << writeCsv << std::endl;
 
     std::cout << "To quit the example type 'q' and press enter" << std::endl;
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cmath>
 #include <format>
 #include <fstream>
 #include <future>
@@ -9,6 +12,16 @@
 
 #include "Capsule/CClient.h"
 #include "Capsule/CDevice.h"
+#include <artifact_detector.hpp>
+#include <block_allocator.hpp>
+#include <head_motion.hpp>
+#include <iir_filter.hpp>
+#include <ppg_beats.hpp>
+#include <signal_block.hpp>
+#include <signal_history.hpp>
+#include <spectrogram.hpp>
+#include <stream_aligner.hpp>
+#include <stream_monitor.hpp>
 
 using namespace std::chrono_literals;
 
@@ -24,49 +37,325 @@ bool writeCsv = false;
 bool clientStopRequested = false;
 bool clientDisconnecting = false;
 
+// Last seconds of every signal, filled here and read by analytics on any thread
+double historySeconds = 30.0;
+std::unique_ptr<signal_processing::SignalHistory> eegHistory;
+std::unique_ptr<signal_processing::SignalHistory> ppgHistory;
+std::unique_ptr<signal_processing::SignalHistory> memsHistory;
+
+// Sample loss and timing of every signal, gaps are also written to device_gaps.csv
+signal_processing::StreamMonitor eegMonitor("EEG");
+signal_processing::StreamMonitor ppgMonitor("PPG");
+signal_processing::StreamMonitor memsMonitor("MEMS");
+std::ofstream gapsStream;
+
+void printMonitorStats() {
+    signal_processing::PrintStats(std::cout, eegMonitor);
+    signal_processing::PrintStats(std::cout, ppgMonitor);
+    signal_processing::PrintStats(std::cout, memsMonitor);
+}
+
+// All signals resampled onto one clock, enabled with --align=<Hz>
+constexpr auto kAlignmentLatency = 200ms;
+double alignRate = 0.0;
+std::unique_ptr<signal_processing::StreamAligner> aligner;
+std::size_t eegAlignedStream = 0;
+std::size_t ppgAlignedStream = 0;
+std::size_t memsAlignedStream = 0;
+std::ofstream fusedStream;
+
+void onAlignedFrames(const signal_processing::SignalBlock& frames, uint32_t staleStreams) {
+    if (staleStreams != 0) {
+        std::cout << "Aligned " << frames.SamplesCount() << " frames, lagging streams:";
+        for (std::size_t stream = 0; stream < signal_processing::StreamAligner::kMaxStreams; ++stream) {
+            if ((staleStreams & (1U << stream)) != 0) {
+                std::cout << ' ' << aligner->StreamName(stream);
+            }
+        }
+        std::cout << std::endl;
+    }
+    if (!writeCsv || !fusedStream.is_open()) {
+        return;
+    }
+    const auto timepoints = frames.Timepoints();
+    const int32_t channels = frames.ChannelsCount();
+    for (int32_t i = 0; i < frames.SamplesCount(); ++i) {
+        fusedStream << timepoints[i];
+        for (int32_t j = 0; j < channels; ++j) {
+            fusedStream << ',' << frames.Channel(j)[i];
+        }
+        fusedStream << '\n';
+    }
+}
+
+// Beat-to-beat timing from PPG, the detector is created once the PPG rate is known
+constexpr double kHrvWindowSec = 60.0;
+std::unique_ptr<signal_processing::PpgBeatDetector> beatDetector;
+signal_processing::HrvEngine hrv(kHrvWindowSec);
+std::ofstream beatsStream;
+
+void onBeat(const signal_processing::PpgBeat& beat) {
+    if (!beat.rrMs) {
+        std::cout << "PPG beat at " << beat.timepoint << " (no valid RR)" << std::endl;
+        hrv.Break();
+        return;
+    }
+    hrv.Add(beat.timepoint, *beat.rrMs);
+    const auto metrics = hrv.Metrics();
+    std::cout << "PPG beat: RR " << *beat.rrMs << " ms, HR " << 60000.0 / *beat.rrMs << " bpm, "
+              << "RMSSD " << metrics.rmssdMs << " ms, SDNN " << metrics.sdnnMs << " ms, "
+              << "pNN50 " << metrics.pnn50 << "%, stress index " << metrics.stressIndex << std::endl;
+    if (writeCsv && beatsStream.is_open()) {
+        beatsStream << beat.timepoint << ',' << *beat.rrMs << ',' << metrics.rmssdMs << ',' << metrics.sdnnMs << ','
+                    << metrics.pnn50 << ',' << metrics.stressIndex << '\n';
+    }
+}
+
 std::ofstream ppgStream;
 void onPPGData(clCDevice, clCPPGTimedData ppgData) {
-    const int32_t count = clCPPGTimedData_GetCount(ppgData);
+    const signal_processing::SignalBlock block = signal_processing::CopyPPGBlock(ppgData);
+    const int32_t count = block.SamplesCount();
     std::cout << "PPG raw data received " << count << " samples" << std::endl;
+    ppgMonitor.Observe(block);
+    ppgHistory->Push(block);
+    if (!beatDetector && ppgMonitor.Stats().sampleRate > 0.0) {
+        beatDetector = std::make_unique<signal_processing::PpgBeatDetector>(ppgMonitor.Stats().sampleRate);
+        beatDetector->SetBeatHandler(onBeat);
+    }
+    if (beatDetector) {
+        beatDetector->Push(block);
+    }
+    if (aligner) {
+        aligner->Push(ppgAlignedStream, block);
+    }
 
     if (!writeCsv || !ppgStream.is_open()) {
         return;
     }
+    const auto timepoints = block.Timepoints();
+    const auto values = block.Channel(0);
     for (int32_t i = 0; i < count; ++i) {
-        ppgStream << clCPPGTimedData_GetTimepoint(ppgData, i) << ',' << clCPPGTimedData_GetValue(ppgData, i) << std::endl;
+        ppgStream << timepoints[i] << ',' << values[i] << std::endl;
     }
 }
 
+// Artifact intervals of the raw EEG, written to device_artifacts.csv. Head
+// motion comes from the MEMS stream; the detector is created once the EEG
+// rate is known.
+signal_processing::HeadMotionEngine headMotion;
+std::unique_ptr<signal_processing::ArtifactDetector> artifactDetector;
+std::ofstream artifactsStream;
+
+void onArtifactInterval(const signal_processing::ArtifactInterval& interval) {
+    using namespace signal_processing;
+    std::cout << "EEG artifact: " << interval.begin << " - " << interval.end << std::endl;
+    if (!writeCsv || !artifactsStream.is_open()) {
+        return;
+    }
+    artifactsStream << interval.begin << ',' << interval.end << ','
+                    << ((interval.causes & kArtifactAmplitude) != 0) << ','
+                    << ((interval.causes & kArtifactGradient) != 0) << ','
+                    << ((interval.causes & kArtifactLineNoise) != 0) << ','
+                    << ((interval.causes & kArtifactMotion) != 0) << '\n';
+}
+
 std::ofstream memsStream;
 void onMEMSData(clCDevice, clCMEMSTimedData memsData) {
-    const int32_t count = clCMEMSTimedData_GetCount(memsData);
+    using namespace signal_processing;
+    const SignalBlock block = CopyMEMSBlock(memsData);
+    const int32_t count = block.SamplesCount();
     std::cout << "MEMS raw data received " << count << " samples" << std::endl;
+    memsMonitor.Observe(block);
+    memsHistory->Push(block);
+    headMotion.Push(block);
+    if (artifactDetector) {
+        artifactDetector->SetMotion(headMotion.Pose().timepoint, headMotion.IsMoving());
+    }
+    if (aligner) {
+        aligner->Push(memsAlignedStream, block);
+    }
 
     if (!writeCsv || !memsStream.is_open()) {
         return;
     }
+    const auto timepoints = block.Timepoints();
     for (int32_t i = 0; i < count; ++i) {
-        const auto acc = clCMEMSTimedData_GetAccelerometer(memsData, i);
-        const auto gyro = clCMEMSTimedData_GetGyroscope(memsData, i);
-        memsStream << clCMEMSTimedData_GetTimepoint(memsData, i) << ','
-                   << acc.x << ',' << acc.y << ',' << acc.z << ','
-                   << gyro.x << ',' << gyro.y << ',' << gyro.z << std::endl;
+        memsStream << timepoints[i] << ','
+                   << block.Channel(kAccelerometerX)[i] << ',' << block.Channel(kAccelerometerY)[i] << ','
+                   << block.Channel(kAccelerometerZ)[i] << ',' << block.Channel(kGyroscopeX)[i] << ','
+                   << block.Channel(kGyroscopeY)[i] << ',' << block.Channel(kGyroscopeZ)[i] << std::endl;
+    }
+}
+
+// Own EEG filtering, enabled with --notch=<Hz> and/or --highpass=<Hz>.
+// Created once the EEG rate is known.
+std::optional<double> notchFrequency;
+std::optional<double> highPassCutoff;
+std::unique_ptr<signal_processing::FilterBank> eegFilter;
+std::ofstream filteredStream;
+
+void filterEEG(const signal_processing::SignalBlock& block) {
+    using namespace signal_processing;
+    if (!notchFrequency && !highPassCutoff) {
+        return;
+    }
+    if (!eegFilter) {
+        const double sampleRate = eegMonitor.Stats().sampleRate;
+        if (sampleRate <= 0.0) {
+            return;
+        }
+        FilterBankConfig config;
+        config.sampleRate = sampleRate;
+        config.notchFrequency = notchFrequency;
+        config.highPassCutoff = highPassCutoff;
+        config.bands = {{"theta", 4.0, 8.0}, {"alpha", 8.0, 13.0}, {"beta", 13.0, 30.0}};
+        eegFilter = std::make_unique<FilterBank>(std::move(config), block.ChannelsCount());
+    }
+
+    const auto& filtered = eegFilter->Process(block);
+    std::cout << "EEG band RMS:";
+    for (std::size_t band = 0; band < filtered.bands.size(); ++band) {
+        const auto& bandBlock = filtered.bands[band];
+        double sum = 0.0;
+        for (int32_t channel = 0; channel < bandBlock.ChannelsCount(); ++channel) {
+            for (const float value : bandBlock.Channel(channel)) {
+                sum += static_cast<double>(value) * value;
+            }
+        }
+        const auto count = static_cast<double>(bandBlock.ChannelsCount()) * bandBlock.SamplesCount();
+        std::cout << ' ' << eegFilter->Config().bands[band].name << ' ' << (count > 0 ? std::sqrt(sum / count) : 0.0);
+    }
+    std::cout << std::endl;
+
+    if (!writeCsv || !filteredStream.is_open()) {
+        return;
+    }
+    const auto timepoints = filtered.cleaned.Timepoints();
+    for (int32_t i = 0; i < filtered.cleaned.SamplesCount(); ++i) {
+        filteredStream << timepoints[i];
+        for (int32_t j = 0; j < filtered.cleaned.ChannelsCount(); ++j) {
+            filteredStream << ',' << filtered.cleaned.Channel(j)[i];
+        }
+        filteredStream << '\n';
+    }
+}
+
+void detectArtifacts(const signal_processing::SignalBlock& block) {
+    using namespace signal_processing;
+    if (!artifactDetector) {
+        const double sampleRate = eegMonitor.Stats().sampleRate;
+        if (sampleRate <= 0.0) {
+            return;
+        }
+        ArtifactDetectorConfig config;
+        config.sampleRate = sampleRate;
+        config.lineFrequency = notchFrequency.value_or(config.lineFrequency);
+        artifactDetector = std::make_unique<ArtifactDetector>(config, block.ChannelsCount());
+        artifactDetector->SubscribeIntervals(onArtifactInterval);
+    }
+    artifactDetector->Push(block);
+}
+
+// Live spectrogram of the raw EEG, enabled with --spectrogram=<bin width Hz>,
+// ten columns a second. The viewer reads new columns in place from the ring
+// and writes them to device_spectrogram.csv.
+constexpr double kSpectrogramColumnsPerSec = 10.0;
+std::optional<double> spectrogramBinWidth;
+std::unique_ptr<signal_processing::Spectrogram> spectrogram;
+uint64_t spectrogramViewed = 0;
+std::ofstream spectrogramStream;
+
+void viewSpectrogram() {
+    const uint64_t written = spectrogram->ColumnsWritten();
+    const uint64_t oldest = written > spectrogram->Config().columns ? written - spectrogram->Config().columns : 0;
+    const std::size_t bins = spectrogram->BinsCount();
+    for (uint64_t index = std::max(spectrogramViewed, oldest); index < written; ++index) {
+        // a view into the ring, valid as the writer runs on this thread
+        const auto column = spectrogram->Column(index);
+        if (!column) {
+            continue;
+        }
+        if (index + 1 == written) {
+            std::cout << "EEG spectrogram peak, Hz:";
+            for (int32_t channel = 0; channel < spectrogram->ChannelsCount(); ++channel) {
+                const auto values = column->values.subspan(static_cast<std::size_t>(channel) * bins, bins);
+                // above the drift of the raw signal
+                const auto peak = std::max_element(values.begin() + std::min<std::size_t>(2, bins), values.end());
+                std::cout << ' ' << static_cast<double>(peak - values.begin()) * spectrogram->BinWidth();
+            }
+            std::cout << std::endl;
+        }
+        if (writeCsv && spectrogramStream.is_open()) {
+            for (int32_t channel = 0; channel < spectrogram->ChannelsCount(); ++channel) {
+                spectrogramStream << column->timepoint << ',' << channel;
+                for (const float value : column->values.subspan(static_cast<std::size_t>(channel) * bins, bins)) {
+                    spectrogramStream << ',' << value;
+                }
+                spectrogramStream << '\n';
+            }
+        }
+    }
+    spectrogramViewed = written;
+}
+
+void updateSpectrogram(const signal_processing::SignalBlock& block) {
+    using namespace signal_processing;
+    if (!spectrogramBinWidth) {
+        return;
+    }
+    if (!spectrogram) {
+        const double sampleRate = eegMonitor.Stats().sampleRate;
+        if (sampleRate <= 0.0) {
+            return;
+        }
+        SpectrogramConfig config;
+        config.sampleRate = sampleRate;
+        config.fftSamples = std::bit_ceil(static_cast<std::size_t>(std::ceil(sampleRate / *spectrogramBinWidth)));
+        config.hopSamples = static_cast<std::size_t>(std::max(1.0, std::round(sampleRate / kSpectrogramColumnsPerSec)));
+        spectrogram = std::make_unique<Spectrogram>(config, block.ChannelsCount());
+        std::cout << "EEG spectrogram: " << spectrogram->BinsCount() << " bins of " << spectrogram->BinWidth()
+                  << " Hz, " << spectrogram->Config().fftSamples << "-sample window" << std::endl;
+        if (spectrogramStream.is_open()) {
+            // power in dB of every bin, named after its frequency
+            spectrogramStream << "timestamp,channel";
+            for (std::size_t bin = 0; bin < spectrogram->BinsCount(); ++bin) {
+                spectrogramStream << ",power_db_" << static_cast<double>(bin) * spectrogram->BinWidth();
+            }
+            spectrogramStream << '\n';
+        }
+    }
+    // viewed once a second
+    const auto viewedColumns = static_cast<uint64_t>(kSpectrogramColumnsPerSec);
+    const uint64_t before = spectrogram->ColumnsWritten();
+    spectrogram->Push(block);
+    if (spectrogram->ColumnsWritten() / viewedColumns != before / viewedColumns) {
+        viewSpectrogram();
     }
 }
 
 std::ofstream eegStream;
 void onEEGData(clCDevice, clCEEGTimedData eegData) {
-    const int32_t samples = clCEEGTimedData_GetSamplesCount(eegData);
-    const int32_t channels = clCEEGTimedData_GetChannelsCount(eegData);
+    const signal_processing::SignalBlock block = signal_processing::CopyEEGBlock(eegData);
+    const int32_t samples = block.SamplesCount();
+    const int32_t channels = block.ChannelsCount();
     std::cout << "EEG raw data received " << channels << " channels and " << samples << " samples" << std::endl;
+    eegMonitor.Observe(block);
+    eegHistory->Push(block);
+    filterEEG(block);
+    detectArtifacts(block);
+    updateSpectrogram(block);
+    if (aligner) {
+        aligner->Push(eegAlignedStream, block);
+    }
 
     if (!writeCsv || !eegStream.is_open()) {
         return;
     }
+    const auto timepoints = block.Timepoints();
     for (int32_t i = 0; i < samples; ++i) {
-        eegStream << clCEEGTimedData_GetTimepoint(eegData, i) << ',';
+        eegStream << timepoints[i] << ',';
         for (int32_t j = 0; j < channels; ++j) {
-            eegStream << clCEEGTimedData_GetValue(eegData, j, i);
+            eegStream << block.Channel(j)[i];
             if (j == channels - 1) {
                 eegStream << std::endl;
             } else {
@@ -88,10 +377,29 @@ void onConnectionStateChanged([[maybe_unused]] clCDevice device, clCDeviceConnec
     if (writeCsv) {
         ppgStream.open("device_ppg.csv");
         ppgStream << "timestamp,value\n";
+        beatsStream.open("device_beats.csv");
+        beatsStream << "timestamp,rr,rmssd,sdnn,pnn50,stress_index\n";
         memsStream.open("device_mems.csv");
         memsStream << "timestamp,ax,ay,az,gx,gy,gz\n";
         eegStream.open("device_eeg.csv");
         eegStream << "timestamp,";
+        if (notchFrequency || highPassCutoff) {
+            filteredStream.open("device_eeg_filtered.csv");
+            filteredStream << "timestamp,";
+        }
+        artifactsStream.open("device_artifacts.csv");
+        artifactsStream << "begin,end,amplitude,gradient,line_noise,motion\n";
+        if (spectrogramBinWidth) {
+            // one row per channel and column, the header is written once the bins are known
+            spectrogramStream.open("device_spectrogram.csv");
+        }
+        gapsStream.open("device_gaps.csv");
+        gapsStream << "stream,before,after,missing\n";
+        for (auto* monitor : {&eegMonitor, &ppgMonitor, &memsMonitor}) {
+            monitor->SetGapHandler([name = monitor->Name()](uint64_t before, uint64_t after, uint64_t missing) {
+                gapsStream << name << ',' << before << ',' << after << ',' << missing << std::endl;
+            });
+        }
     }
 
     // get channel names
@@ -109,13 +417,35 @@ void onConnectionStateChanged([[maybe_unused]] clCDevice device, clCDeviceConnec
         std::cout << "\tChannel " << clCString_CStr(channelName)
                   << " has index " << clCDevice_GetChannelIndexByName(channelNames, clCString_CStr(channelName)) << std::endl;
         eegStream << clCString_CStr(channelName);
+        filteredStream << clCString_CStr(channelName);
         if (i == channelsCount - 1) {
             eegStream << std::endl;
+            filteredStream << std::endl;
         } else {
             eegStream << ',';
+            filteredStream << ',';
         }
         clCString_Free(channelName);
     }
+
+    if (alignRate > 0.0) {
+        using namespace signal_processing;
+        aligner = std::make_unique<StreamAligner>(alignRate, kAlignmentLatency);
+        eegAlignedStream = aligner->AddStream("eeg", channelsCount);
+        ppgAlignedStream = aligner->AddStream("ppg", 1);
+        memsAlignedStream = aligner->AddStream("mems", kMEMSChannelsCount);
+        aligner->SetFramesHandler(onAlignedFrames);
+        if (writeCsv) {
+            fusedStream.open("device_fused.csv");
+            fusedStream << "timestamp";
+            for (int32_t i = 0; i < channelsCount; ++i) {
+                clCString channelName = clCDevice_GetChannelNameByIndex(channelNames, i);
+                fusedStream << ',' << clCString_CStr(channelName);
+                clCString_Free(channelName);
+            }
+            fusedStream << ",ppg,ax,ay,az,gx,gy,gz" << std::endl;
+        }
+    }
 }
 
 void onDeviceList(clCDeviceLocator locator, clCDeviceInfoList devices, clCDeviceLocatorFailReason error) {
@@ -240,15 +570,56 @@ void ClientLoop() {
     if (eegStream.is_open()) {
         eegStream.close();
     }
+    if (filteredStream.is_open()) {
+        filteredStream.close();
+    }
+    if (fusedStream.is_open()) {
+        fusedStream.close();
+    }
+    if (gapsStream.is_open()) {
+        gapsStream.close();
+    }
+    if (beatsStream.is_open()) {
+        beatsStream.close();
+    }
+    if (artifactDetector) {
+        artifactDetector->Flush();
+    }
+    if (artifactsStream.is_open()) {
+        artifactsStream.close();
+    }
+    if (spectrogram) {
+        viewSpectrogram();
+    }
+    if (spectrogramStream.is_open()) {
+        spectrogramStream.close();
+    }
+    printMonitorStats();
+    block_memory::PrintStats(std::cout);
 
     exit(0);
 }
 
 int main(int argc, char* argv[]) {
     parseArgs(argc, argv, nullptr, nullptr, &writeCsv);
-
-    std::cout << std::boolalpha << "Write to CSV: " << writeCsv << std::endl;
-    std::cout << "To quit the example type 'q' and press enter" << std::endl;
+    historySeconds = findArgNumber(argc, argv, "--history").value_or(historySeconds);
+    alignRate = findArgNumber(argc, argv, "--align").value_or(alignRate);
+    notchFrequency = findArgNumber(argc, argv, "--notch");
+    highPassCutoff = findArgNumber(argc, argv, "--highpass");
+    spectrogramBinWidth = findArgNumber(argc, argv, "--spectrogram");
+    eegHistory = std::make_unique<signal_processing::SignalHistory>(historySeconds);
+    ppgHistory = std::make_unique<signal_processing::SignalHistory>(historySeconds);
+    memsHistory = std::make_unique<signal_processing::SignalHistory>(historySeconds);
+
+    std::cout << std::boolalpha << "Write to CSV: " << writeCsv << '\n'
+              << "Signal history: " << historySeconds << " s" << '\n'
+              << "Aligned rate: " << (alignRate > 0.0 ? std::to_string(alignRate) + " Hz" : "off") << '\n'
+              << "EEG filters: notch " << (notchFrequency ? std::to_string(*notchFrequency) + " Hz" : "off")
+              << ", high-pass " << (highPassCutoff ? std::to_string(*highPassCutoff) + " Hz" : "off")
+              << " (" << signal_processing::FilterInstructionSet() << ")" << '\n'
+              << "EEG spectrogram: " << (spectrogramBinWidth ? std::to_string(*spectrogramBinWidth) + " Hz bins" : "off")
+              << std::endl;
+    std::cout << "To quit the example type 'q' and press enter, 's' prints stream statistics" << std::endl;
 
     // Getting the version of the library
     // and an example of working with a clCString
@@ -277,6 +648,9 @@ int main(int argc, char* argv[]) {
             clientStopRequested = true;
             break;
         }
+        if (input == 's' || input == 'S') {
+            printMonitorStats();
+        }
     }
     future.wait();
 
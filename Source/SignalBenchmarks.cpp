@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <async_logger.hpp>
+#include <band_power.hpp>
+#include <iir_filter.hpp>
+#include <spectrogram.hpp>
+#include <trend_forecaster.hpp>
+#include <windowed_quantiles.hpp>
+#include <signal_block.hpp>
+
+#include "Capsule/CNFBBaseline.h"
+
+// Throughput and consistency checks of the signal processing code on
+// synthetic data, no device needed
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+signal_processing::SignalBlock makeNoiseBlock(int32_t channels, int32_t samples, std::mt19937& random) {
+    std::normal_distribution<float> noise(0.0f, 10.0f);
+    auto block = signal_processing::SignalBlock::Allocate(channels, samples);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        for (float& value : block.Channel(channel)) {
+            value = noise(random);
+        }
+    }
+    for (int32_t sample = 0; sample < samples; ++sample) {
+        block.Timepoints()[sample] = static_cast<uint64_t>(sample) * 1000;
+    }
+    return block;
+}
+
+// 64 channels at 1 kHz in 40 ms blocks, notch, high-pass and three bands
+bool benchmarkFilterBank() {
+    using namespace signal_processing;
+    constexpr int32_t kChannels = 64;
+    constexpr double kSampleRate = 1000.0;
+    constexpr int32_t kBlockSamples = 40;
+    constexpr int32_t kBlocks = 2500;
+
+    FilterBankConfig config;
+    config.sampleRate = kSampleRate;
+    config.notchFrequency = 50.0;
+    config.highPassCutoff = 1.0;
+    config.bands = {{"theta", 4.0, 8.0}, {"alpha", 8.0, 13.0}, {"beta", 13.0, 30.0}};
+    FilterBank bank(config, kChannels);
+
+    std::mt19937 random(42);
+    std::vector<SignalBlock> blocks;
+    for (int32_t i = 0; i < 16; ++i) {
+        blocks.push_back(makeNoiseBlock(kChannels, kBlockSamples, random));
+    }
+
+    // the same stream through the reference implementation, channel by channel
+    const std::vector<BiquadCoefficients> cleaning = {
+            NotchCoefficients(*config.notchFrequency, kSampleRate, config.notchQ),
+            HighPassCoefficients(*config.highPassCutoff, kSampleRate, kButterworthQ)};
+    std::vector<std::vector<float>> referenceState(kChannels, std::vector<float>(2 * cleaning.size(), 0.0f));
+    bool identical = true;
+
+    for (int32_t i = 0; i < kBlocks && identical; ++i) {
+        const auto& block = blocks[i % blocks.size()];
+        const auto& output = bank.Process(block);
+        for (int32_t channel = 0; channel < kChannels; ++channel) {
+            std::vector<float> values(block.Channel(channel).begin(), block.Channel(channel).end());
+            FilterReference(cleaning, values, referenceState[channel]);
+            const auto filtered = output.cleaned.Channel(channel);
+            identical = identical && std::memcmp(values.data(), filtered.data(), values.size() * sizeof(float)) == 0;
+        }
+    }
+
+    const auto start = Clock::now();
+    for (int32_t i = 0; i < kBlocks; ++i) {
+        bank.Process(blocks[i % blocks.size()]);
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    const double signalSeconds = kBlocks * kBlockSamples / kSampleRate;
+
+    std::cout << "Filter bank (" << FilterInstructionSet() << "), " << kChannels << " channels at " << kSampleRate
+              << " Hz: " << signalSeconds / elapsed << "x real time, "
+              << elapsed / kBlocks * 1e6 << " us per block" << '\n'
+              << "\tbit-identical to reference: " << std::boolalpha << identical << std::endl;
+    return identical && elapsed < signalSeconds;
+}
+
+// 64 channels at 1 kHz with a 10 Hz sine of known power, updated at 10 Hz
+bool benchmarkBandPower() {
+    using namespace signal_processing;
+    constexpr int32_t kChannels = 64;
+    constexpr double kSampleRate = 1000.0;
+    constexpr int32_t kBlockSamples = 40;
+    constexpr int32_t kBlocks = 500;
+    constexpr float kAmplitude = 20.0f;
+
+    BandPowerConfig config;
+    config.sampleRate = kSampleRate;
+    config.windowSamples = 2000;
+    config.segmentSamples = 1024;
+    config.hopSamples = 100;
+    config.bands = DefaultPowerBands();
+    // narrow enough for Goertzel
+    config.bands.push_back({"peak", 9.25, 10.75});
+    BandPowerEngine engine(config, kChannels);
+
+    std::vector<float> lastPowers;
+    engine.SetPowersHandler([&lastPowers](uint64_t, std::span<const float> powers) {
+        lastPowers.assign(powers.begin(), powers.end());
+    });
+
+    std::mt19937 random(7);
+    std::vector<SignalBlock> blocks;
+    for (int32_t i = 0; i < kBlocks; ++i) {
+        auto block = makeNoiseBlock(kChannels, kBlockSamples, random);
+        for (int32_t sample = 0; sample < kBlockSamples; ++sample) {
+            const double t = (i * kBlockSamples + sample) / kSampleRate;
+            const auto sine = static_cast<float>(kAmplitude * std::sin(2.0 * 3.14159265358979 * 10.0 * t));
+            for (int32_t channel = 0; channel < kChannels; ++channel) {
+                block.Channel(channel)[sample] = block.Channel(channel)[sample] * 0.1f + sine;
+            }
+        }
+        blocks.push_back(std::move(block));
+    }
+
+    const auto start = Clock::now();
+    for (const auto& block : blocks) {
+        engine.Push(block);
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    const double signalSeconds = kBlocks * kBlockSamples / kSampleRate;
+
+    // a sine of amplitude A has power A^2 / 2
+    const double expected = kAmplitude * kAmplitude / 2.0;
+    const double alpha = lastPowers.empty() ? 0.0 : lastPowers[1];
+    const double peak = lastPowers.empty() ? 0.0 : lastPowers[3];
+    const bool accurate = std::abs(alpha - expected) < 0.1 * expected && std::abs(peak - expected) < 0.1 * expected;
+    std::cout << "Band power, " << kChannels << " channels at " << kSampleRate << " Hz, "
+              << engine.UpdatesCount() << " updates: " << signalSeconds / elapsed << "x real time, "
+              << elapsed / std::max<uint64_t>(engine.UpdatesCount(), 1) * 1e6 << " us per update" << '\n'
+              << "\talpha " << alpha << ", narrow peak band " << peak << ", expected " << expected << std::endl;
+    return accurate && elapsed < signalSeconds;
+}
+
+// 64 channels at 1 kHz with a 10 Hz sine, 0.5 Hz bins and a column every 50 ms
+bool benchmarkSpectrogram() {
+    using namespace signal_processing;
+    constexpr int32_t kChannels = 64;
+    constexpr double kSampleRate = 1000.0;
+    constexpr int32_t kBlockSamples = 40;
+    constexpr int32_t kBlocks = 500;
+
+    SpectrogramConfig config;
+    config.sampleRate = kSampleRate;
+    config.fftSamples = 2048;
+    config.hopSamples = 50;
+    config.maxFrequency = 45.0;
+    Spectrogram spectrogram(config, kChannels);
+
+    std::mt19937 random(13);
+    std::vector<SignalBlock> blocks;
+    for (int32_t i = 0; i < kBlocks; ++i) {
+        auto block = makeNoiseBlock(kChannels, kBlockSamples, random);
+        for (int32_t sample = 0; sample < kBlockSamples; ++sample) {
+            const double t = (i * kBlockSamples + sample) / kSampleRate;
+            const auto sine = static_cast<float>(20.0 * std::sin(2.0 * 3.14159265358979 * 10.0 * t));
+            for (int32_t channel = 0; channel < kChannels; ++channel) {
+                block.Channel(channel)[sample] = block.Channel(channel)[sample] * 0.1f + sine;
+            }
+        }
+        blocks.push_back(std::move(block));
+    }
+
+    const auto start = Clock::now();
+    for (const auto& block : blocks) {
+        spectrogram.Push(block);
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    const double signalSeconds = kBlocks * kBlockSamples / kSampleRate;
+    const uint64_t columns = std::max<uint64_t>(spectrogram.ColumnsWritten(), 1);
+
+    // the newest column of every channel must peak at the sine
+    bool accurate = spectrogram.ColumnsWritten() > 0;
+    if (const auto column = spectrogram.Column(spectrogram.ColumnsWritten() - 1)) {
+        const std::size_t bins = spectrogram.BinsCount();
+        for (int32_t channel = 0; channel < kChannels; ++channel) {
+            const auto values = column->values.subspan(static_cast<std::size_t>(channel) * bins, bins);
+            const auto peak = std::max_element(values.begin(), values.end()) - values.begin();
+            accurate = accurate && std::abs(static_cast<double>(peak) * spectrogram.BinWidth() - 10.0) < 1.0;
+        }
+    }
+    std::cout << "Spectrogram, " << kChannels << " channels at " << kSampleRate << " Hz, " << config.fftSamples
+              << "-point STFT every " << config.hopSamples << " samples: " << signalSeconds / elapsed
+              << "x real time, " << elapsed / static_cast<double>(columns * kChannels) * 1e6
+              << " us per column per channel" << '\n'
+              << "\t" << spectrogram.BinsCount() << " bins of " << spectrogram.BinWidth() << " Hz, peak at 10 Hz: "
+              << std::boolalpha << accurate << std::endl;
+    return accurate && elapsed < signalSeconds;
+}
+
+// Five percentiles of a 60 s window of a 10 Hz metric after every update,
+// locally and through repeated clCNFBBaseline_Get calls
+bool benchmarkQuantiles() {
+    constexpr float kWindowSec = 60.0f;
+    constexpr int64_t kStepMs = 100;
+    constexpr int32_t kUpdates = 20000;
+    const std::array<double, 5> percentiles = {5.0, 25.0, 50.0, 75.0, 95.0};
+
+    std::mt19937 random(11);
+    std::lognormal_distribution<float> metric(0.0f, 0.5f);
+    std::vector<float> values(kUpdates);
+    for (float& value : values) {
+        value = metric(random);
+    }
+
+    signal_processing::WindowedQuantiles local(static_cast<int64_t>(kWindowSec * 1000));
+    std::array<float, percentiles.size()> localResult{};
+    auto start = Clock::now();
+    for (int32_t i = 0; i < kUpdates; ++i) {
+        local.Push(values[i], i * kStepMs);
+        local.Quantiles(percentiles, localResult);
+    }
+    const double localElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    clCNFBBaseline baseline = clCNFBBaseline_Create(kWindowSec, kStepMs / 1000.0f);
+    std::array<float, percentiles.size()> sdkResult{};
+    start = Clock::now();
+    for (int32_t i = 0; i < kUpdates; ++i) {
+        clCNFBBaseline_PushNFB(baseline, values[i], i * kStepMs);
+        for (std::size_t p = 0; p < percentiles.size(); ++p) {
+            sdkResult[p] = clCNFBBaseline_Get(baseline, static_cast<uint8_t>(percentiles[p]));
+        }
+    }
+    const double sdkElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    clCNFBBaseline_Destroy(baseline);
+
+    // against sorted copies of the window, with NaNs mixed in that both must skip
+    signal_processing::WindowedQuantiles checked(static_cast<int64_t>(kWindowSec * 1000));
+    std::deque<std::pair<int64_t, float>> window;
+    std::vector<float> sorted;
+    bool matches = true;
+    for (int32_t i = 0; i < kUpdates && matches; ++i) {
+        const int64_t timestamp = i * kStepMs;
+        const float value = i % 97 == 13 ? std::numeric_limits<float>::quiet_NaN() : values[i];
+        checked.Push(value, timestamp);
+        while (!window.empty() && window.front().first < timestamp - static_cast<int64_t>(kWindowSec * 1000)) {
+            window.pop_front();
+        }
+        if (std::isfinite(value)) {
+            window.emplace_back(timestamp, value);
+        }
+        if (i % 100 != 0) {
+            continue;
+        }
+        sorted.clear();
+        for (const auto& [_, windowValue] : window) {
+            sorted.push_back(windowValue);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        matches = checked.Size() == sorted.size();
+        for (std::size_t p = 0; p < percentiles.size() && matches && !sorted.empty(); ++p) {
+            const double position = percentiles[p] / 100.0 * static_cast<double>(sorted.size() - 1);
+            const auto lower = static_cast<std::size_t>(position);
+            const float upper = sorted[std::min(lower + 1, sorted.size() - 1)];
+            const float expected = sorted[lower] + static_cast<float>(position - lower) * (upper - sorted[lower]);
+            matches = std::abs(checked.Quantile(percentiles[p]) - expected) <= 1e-5f * std::abs(expected);
+        }
+    }
+
+    std::cout << "Windowed quantiles, " << percentiles.size() << " percentiles of " << local.Size()
+              << " values per update: " << localElapsed / kUpdates * 1e6 << " us locally, "
+              << sdkElapsed / kUpdates * 1e6 << " us with clCNFBBaseline" << '\n'
+              << "\tlast median: " << localResult[2] << " locally, " << sdkResult[2] << " with clCNFBBaseline"
+              << "\n\tmatches a sorted window: " << std::boolalpha << matches << std::endl;
+    return matches;
+}
+
+// Forecast after every update of an 8 hour 1 Hz fatigue score rising
+// linearly under noise; the true crossing must lie within the bounds
+bool benchmarkTrendForecaster() {
+    constexpr int32_t kUpdates = 8 * 3600;
+    constexpr double kStart = 20.0;
+    constexpr double kSlope = 1.0 / 600.0;
+    constexpr double kThreshold = 70.0;
+
+    std::mt19937 random(17);
+    std::normal_distribution<double> noise(0.0, 3.0);
+    std::vector<double> values(kUpdates);
+    for (int32_t i = 0; i < kUpdates; ++i) {
+        values[i] = kStart + kSlope * i + noise(random);
+    }
+
+    signal_processing::TrendForecasterConfig config;
+    config.threshold = kThreshold;
+    signal_processing::TrendForecaster forecaster(config);
+    std::optional<signal_processing::TrendForecast> forecast;
+    // forecast made one hour before the crossing
+    constexpr int32_t kCheckedUpdate = static_cast<int32_t>((kThreshold - kStart) / kSlope) - 3600;
+    std::optional<signal_processing::TrendForecast> checked;
+    const auto start = Clock::now();
+    for (int32_t i = 0; i < kUpdates; ++i) {
+        forecaster.Update(static_cast<uint64_t>(i) * 1'000'000, values[i]);
+        forecast = forecaster.Forecast();
+        if (i == kCheckedUpdate) {
+            checked = forecast;
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    const bool accurate = checked && checked->earliest && checked->latest && *checked->earliest <= 3600.0
+                          && *checked->latest >= 3600.0;
+    std::cout << "Trend forecaster: " << elapsed / kUpdates * 1e9 << " ns per update and forecast";
+    if (checked && checked->timeToThreshold) {
+        std::cout << ", an hour before the crossing: " << *checked->timeToThreshold << " s ("
+                  << checked->earliest.value_or(-1.0) << " - " << checked->latest.value_or(-1.0) << " s)";
+    }
+    std::cout << (accurate ? "" : ", the crossing is outside of the bounds") << std::endl;
+    return accurate;
+}
+
+// Cost on the calling thread of a record like the ones of the data callbacks,
+// in batches that fit the thread buffer, flushed between the batches
+bool benchmarkLogger() {
+    constexpr int32_t kBatches = 200;
+    constexpr int32_t kBatchRecords = 256;
+    const logging::Category category{"benchmark"};
+
+    std::ostringstream out;
+    std::ostringstream errors;
+    logging::Logger logger(out, errors);
+    double elapsed = 0.0;
+    for (int32_t batch = 0; batch < kBatches; ++batch) {
+        const auto start = Clock::now();
+        for (int32_t i = 0; i < kBatchRecords; ++i) {
+            logger.Log(logging::Level::Info, category, "{} relaxation {}, concentration {}", i, 0.25 * i, 0.5f);
+        }
+        elapsed += std::chrono::duration<double>(Clock::now() - start).count();
+        logger.Flush();
+    }
+
+    const std::string text = out.str();
+    const auto lines = static_cast<int32_t>(std::count(text.begin(), text.end(), '\n'));
+    const bool complete = lines == kBatches * kBatchRecords;
+    std::cout << "Logger: " << elapsed / (kBatches * kBatchRecords) * 1e9 << " ns per record on the caller, "
+              << lines << " of " << kBatches * kBatchRecords << " records written" << std::endl;
+    return complete;
+}
+
+} // namespace
+
+int main() {
+    bool ok = true;
+    ok = benchmarkFilterBank() && ok;
+    ok = benchmarkBandPower() && ok;
+    ok = benchmarkSpectrogram() && ok;
+    ok = benchmarkQuantiles() && ok;
+    ok = benchmarkTrendForecaster() && ok;
+    ok = benchmarkLogger() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+#include <alpha_peak_tracker.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// broadband range used for artifact detection, Hz
+constexpr double kBroadbandLow = 1.0;
+constexpr double kBroadbandHigh = 40.0;
+} // namespace
+
+AlphaPeakTracker::AlphaPeakTracker(AlphaPeakTrackerConfig config)
+        : config_{std::move(config)}
+{
+}
+
+bool AlphaPeakTracker::Update(std::span<const double> psd, double binWidth) {
+    if (binWidth <= 0.0 || psd.empty()) {
+        return false;
+    }
+    if (binWidth != binWidth_) {
+        Resize(psd.size(), binWidth);
+    }
+
+    const std::size_t broadbandFirst = std::min(static_cast<std::size_t>(std::ceil(kBroadbandLow / binWidth)), psd.size());
+    const std::size_t broadbandLast = std::min(static_cast<std::size_t>(kBroadbandHigh / binWidth) + 1, psd.size());
+    double broadband = 0.0;
+    for (std::size_t bin = broadbandFirst; bin < broadbandLast; ++bin) {
+        broadband += psd[bin];
+    }
+    const double logPower = std::log(std::max(broadband, 1e-12));
+    if (baselineLogPower_ && accepted_ >= config_.warmupSpectra
+        && logPower - *baselineLogPower_ > std::log(config_.artifactRatio)) {
+        if (++consecutiveRejected_ < config_.reacquireSpectra) {
+            ++rejected_;
+            return false;
+        }
+        // the level has changed for good, follow it instead of rejecting
+        // forever; this spectrum is accepted, not counted as rejected
+        baselineLogPower_ = logPower;
+    }
+    consecutiveRejected_ = 0;
+    baselineLogPower_ = baselineLogPower_ ? *baselineLogPower_ + config_.smoothing * (logPower - *baselineLogPower_)
+                                          : logPower;
+
+    // the first spectra are averaged, later ones smoothed
+    const double weight = std::max(config_.smoothing, 1.0 / static_cast<double>(accepted_ + 1));
+    for (std::size_t i = 0; i < smoothed_.size() && firstBin_ + i < psd.size(); ++i) {
+        smoothed_[i] += weight * (psd[firstBin_ + i] - smoothed_[i]);
+    }
+    ++accepted_;
+    if (accepted_ >= config_.warmupSpectra) {
+        FindPeak();
+    }
+    return true;
+}
+
+std::optional<double> AlphaPeakTracker::PeakFrequency() const {
+    return peakFrequency_;
+}
+
+uint64_t AlphaPeakTracker::AcceptedCount() const {
+    return accepted_;
+}
+
+uint64_t AlphaPeakTracker::RejectedCount() const {
+    return rejected_;
+}
+
+void AlphaPeakTracker::Resize(std::size_t bins, double binWidth) {
+    // one bin of margin on each side for the parabola
+    binWidth_ = binWidth;
+    const auto first = static_cast<std::size_t>(std::max(std::floor(config_.searchLow / binWidth) - 1.0, 0.0));
+    const std::size_t last = std::min(static_cast<std::size_t>(std::ceil(config_.searchHigh / binWidth)) + 2, bins);
+    firstBin_ = std::min(first, last);
+    smoothed_.assign(last - firstBin_, 0.0);
+    baselineLogPower_.reset();
+    peakFrequency_.reset();
+    accepted_ = 0;
+    consecutiveRejected_ = 0;
+}
+
+void AlphaPeakTracker::FindPeak() {
+    if (smoothed_.size() < 3) {
+        return;
+    }
+    // the margin bins may only be neighbours of the peak
+    const auto peak = std::max_element(smoothed_.begin() + 1, smoothed_.end() - 1);
+    const auto index = static_cast<std::size_t>(peak - smoothed_.begin());
+    const double frequency = static_cast<double>(firstBin_ + index) * binWidth_;
+    if (frequency <= config_.searchLow || frequency >= config_.searchHigh) {
+        // a maximum at the border is the slope of another rhythm, not a peak
+        return;
+    }
+    const double left = std::log(std::max(smoothed_[index - 1], 1e-12));
+    const double center = std::log(std::max(smoothed_[index], 1e-12));
+    const double right = std::log(std::max(smoothed_[index + 1], 1e-12));
+    const double curvature = left - 2.0 * center + right;
+    const double offset = curvature < 0.0 ? 0.5 * (left - right) / curvature : 0.0;
+    peakFrequency_ = frequency + std::clamp(offset, -0.5, 0.5) * binWidth_;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,188 @@
+#include <artifact_detector.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace signal_processing
+{
+namespace
+{
+// time constant of the channel baseline, seconds
+constexpr double kBaselineSec = 2.0;
+
+template<typename Handlers>
+void Erase(Handlers& handlers, std::size_t id) {
+    std::erase_if(handlers, [id](const auto& handler) { return handler.first == id; });
+}
+} // namespace
+
+ArtifactDetector::ArtifactDetector(ArtifactDetectorConfig config, int32_t channels)
+        : config_{std::move(config)}
+        , channels_{channels}
+        , holdSamples_{static_cast<std::size_t>(std::lround(config_.holdSec * config_.sampleRate))}
+        , baselines_(static_cast<std::size_t>(channels), 0.0f)
+        , lastValues_(static_cast<std::size_t>(channels), 0.0f)
+        , lineNoise_{config_.lineFrequency, config_.sampleRate,
+                     static_cast<std::size_t>(std::lround(config_.lineWindowSec * config_.sampleRate)),
+                     static_cast<std::size_t>(std::lround(config_.lineSampleWindowSec * config_.sampleRate)), channels}
+{
+}
+
+const ArtifactDetectorConfig& ArtifactDetector::Config() const {
+    return config_;
+}
+
+std::size_t ArtifactDetector::Subscribe(MaskHandler handler) {
+    maskHandlers_.emplace_back(nextId_, std::move(handler));
+    return nextId_++;
+}
+
+std::size_t ArtifactDetector::SubscribeIntervals(IntervalHandler handler) {
+    intervalHandlers_.emplace_back(nextId_, std::move(handler));
+    return nextId_++;
+}
+
+void ArtifactDetector::Unsubscribe(std::size_t id) {
+    Erase(maskHandlers_, id);
+    Erase(intervalHandlers_, id);
+}
+
+void ArtifactDetector::SetMotion(uint64_t timepoint, bool moving) {
+    const bool last = motion_.empty() ? moving_ : motion_.back().second;
+    if (moving != last) {
+        motion_.emplace_back(timepoint, moving);
+    }
+}
+
+void ArtifactDetector::Push(const SignalBlock& block) {
+    const std::size_t samples = static_cast<std::size_t>(block.SamplesCount());
+    if (samples == 0) {
+        return;
+    }
+    const int32_t channels = std::min(block.ChannelsCount(), channels_);
+    if (!started_) {
+        for (int32_t channel = 0; channel < channels; ++channel) {
+            baselines_[channel] = block.Channel(channel)[0];
+            lastValues_[channel] = block.Channel(channel)[0];
+        }
+        started_ = true;
+    }
+
+    causes_.assign(samples, 0);
+    channelCauses_.resize(samples);
+    channelMask_ = 0;
+    const float amplitudeLimit = config_.amplitudeLimit;
+    const float gradientLimit = config_.gradientLimit;
+    const auto baselineAlpha = static_cast<float>(1.0 - std::exp(-static_cast<double>(samples)
+                                                                 / (config_.sampleRate * kBaselineSec)));
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const float* values = block.Channel(channel).data();
+        const float baseline = baselines_[channel];
+        uint8_t* causes = channelCauses_.data();
+        // comparisons turned into bits, so the loop has no branches
+        causes[0] = static_cast<uint8_t>((std::abs(values[0] - baseline) > amplitudeLimit ? kArtifactAmplitude : 0)
+                                         | (std::abs(values[0] - lastValues_[channel]) > gradientLimit
+                                                    ? kArtifactGradient
+                                                    : 0));
+        for (std::size_t i = 1; i < samples; ++i) {
+            const uint8_t amplitude = std::abs(values[i] - baseline) > amplitudeLimit ? kArtifactAmplitude : 0;
+            const uint8_t gradient = std::abs(values[i] - values[i - 1]) > gradientLimit ? kArtifactGradient : 0;
+            causes[i] = static_cast<uint8_t>(amplitude | gradient);
+        }
+        uint8_t any = 0;
+        float sum = 0.0f;
+        for (std::size_t i = 0; i < samples; ++i) {
+            causes_[i] |= causes[i];
+            any |= causes[i];
+            sum += values[i];
+        }
+        if (any != 0 && channel < 64) {
+            channelMask_ |= uint64_t{1} << channel;
+        }
+        baselines_[channel] = baseline + baselineAlpha * (sum / static_cast<float>(samples) - baseline);
+        lastValues_[channel] = values[samples - 1];
+    }
+
+    DetectLineNoise(block);
+    DetectMotion(block.Timepoints());
+    Hold(block.Timepoints());
+    Emit(block.Timepoints());
+}
+
+const LineNoiseMeter& ArtifactDetector::LineNoise() const {
+    return lineNoise_;
+}
+
+void ArtifactDetector::DetectLineNoise(const SignalBlock& block) {
+    lineNoise_.Push(block);
+    const int32_t channels = std::min(block.ChannelsCount(), channels_);
+    const float limit = config_.lineNoiseRatio;
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto ratios = lineNoise_.SampleRatios(channel);
+        uint8_t any = 0;
+        for (std::size_t i = 0; i < ratios.size() && i < causes_.size(); ++i) {
+            const uint8_t cause = ratios[i] > limit ? kArtifactLineNoise : 0;
+            causes_[i] |= cause;
+            any |= cause;
+        }
+        if (any != 0 && channel < 64) {
+            channelMask_ |= uint64_t{1} << channel;
+        }
+    }
+}
+
+void ArtifactDetector::DetectMotion(std::span<const uint64_t> timepoints) {
+    for (std::size_t i = 0; i < timepoints.size(); ++i) {
+        while (!motion_.empty() && motion_.front().first <= timepoints[i]) {
+            moving_ = motion_.front().second;
+            motion_.pop_front();
+        }
+        if (moving_) {
+            causes_[i] |= kArtifactMotion;
+        }
+    }
+}
+
+void ArtifactDetector::Hold(std::span<const uint64_t> timepoints) {
+    for (std::size_t i = 0; i < timepoints.size(); ++i) {
+        if (causes_[i] != 0) {
+            holdLeft_ = holdSamples_;
+            heldCauses_ = causes_[i];
+        } else if (holdLeft_ > 0) {
+            causes_[i] = heldCauses_;
+            --holdLeft_;
+        }
+    }
+}
+
+void ArtifactDetector::Emit(std::span<const uint64_t> timepoints) {
+    for (std::size_t i = 0; i < timepoints.size(); ++i) {
+        if (causes_[i] != 0) {
+            if (!openInterval_) {
+                openInterval_ = ArtifactInterval{timepoints[i], timepoints[i], 0};
+            }
+            openInterval_->end = timepoints[i];
+            openInterval_->causes |= causes_[i];
+        } else if (openInterval_) {
+            Flush();
+        }
+    }
+
+    const ArtifactMask mask{timepoints, causes_, channelMask_};
+    for (const auto& [id, handler] : maskHandlers_) {
+        handler(mask);
+    }
+}
+
+void ArtifactDetector::Flush() {
+    if (!openInterval_) {
+        return;
+    }
+    const ArtifactInterval interval = *openInterval_;
+    openInterval_.reset();
+    for (const auto& [id, handler] : intervalHandlers_) {
+        handler(interval);
+    }
+}
+
+} // namespace signal_processing
@@ -0,0 +1,301 @@
+#include <async_logger.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+namespace logging
+{
+namespace
+{
+constexpr int64_t kNsPerSecond = 1'000'000'000;
+constexpr auto kIdlePeriod = std::chrono::milliseconds(5);
+// marks the bytes skipped at the end of a ring
+constexpr uint8_t kSkipMarker = 0xFF;
+
+std::atomic<uint64_t> nextLoggerId{1};
+
+const char kLevelLetters[] = {'D', 'I', 'W', 'E'};
+} // namespace
+
+namespace detail
+{
+void FormatArgumentsMismatch() {
+}
+
+ThreadBuffer::ThreadBuffer(std::size_t capacity)
+        : data_(std::bit_ceil(std::max<std::size_t>(capacity, 64)))
+{
+}
+
+uint8_t* ThreadBuffer::Reserve(std::size_t size) {
+    const std::size_t capacity = data_.size();
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    const std::size_t tail = tail_.load(std::memory_order_acquire);
+    const std::size_t offset = head % capacity;
+    const std::size_t contiguous = capacity - offset;
+    // a record never wraps, the end of the ring is skipped instead
+    skipped_ = size > contiguous ? contiguous : 0;
+    if (size + skipped_ > capacity - (head - tail)) {
+        return nullptr;
+    }
+    if (skipped_ == 0) {
+        return data_.data() + offset;
+    }
+    const auto skipped = static_cast<uint32_t>(skipped_);
+    std::memcpy(data_.data() + offset, &skipped, sizeof(skipped));
+    data_[offset + sizeof(skipped)] = kSkipMarker;
+    return data_.data();
+}
+
+void ThreadBuffer::Commit(std::size_t size) {
+    head_.store(head_.load(std::memory_order_relaxed) + skipped_ + size, std::memory_order_release);
+}
+
+const uint8_t* ThreadBuffer::Peek() {
+    const std::size_t capacity = data_.size();
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    while (tail != head) {
+        const uint8_t* record = data_.data() + tail % capacity;
+        if (record[sizeof(uint32_t)] != kSkipMarker) {
+            return record;
+        }
+        uint32_t skipped = 0;
+        std::memcpy(&skipped, record, sizeof(skipped));
+        tail += skipped;
+        tail_.store(tail, std::memory_order_release);
+    }
+    return nullptr;
+}
+
+void ThreadBuffer::Release(std::size_t size) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+uint64_t ThreadBuffer::TakeDropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+}
+
+void ThreadBuffer::CountDropped() {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace detail
+
+const char* LevelName(Level level) {
+    switch (level) {
+    case Level::Debug:
+        return "debug";
+    case Level::Info:
+        return "info";
+    case Level::Warning:
+        return "warning";
+    case Level::Error:
+        return "error";
+    default:
+        return "unknown";
+    }
+}
+
+std::optional<Level> ParseLevel(std::string_view name) {
+    for (const auto level : {Level::Debug, Level::Info, Level::Warning, Level::Error}) {
+        if (name == LevelName(level)) {
+            return level;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<uint32_t> Category::Admit(int64_t nowNs) const {
+    if (maxPerSecond_ == 0) {
+        return 0;
+    }
+    // racing threads may let a few extra records through when the second changes
+    const int64_t second = nowNs / kNsPerSecond;
+    if (second_.load(std::memory_order_relaxed) != second) {
+        second_.store(second, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < maxPerSecond_) {
+        return suppressed_.exchange(0, std::memory_order_relaxed);
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+Logger::Logger(std::ostream& out, std::ostream& errors)
+        : id_{nextLoggerId.fetch_add(1)}
+        , out_{out}
+        , errors_{errors}
+        , originNs_{NowNs()}
+        , thread_{[this] { Run(); }}
+{
+}
+
+Logger::~Logger() {
+    stopping_ = true;
+    thread_.join();
+    Drain();
+}
+
+void Logger::SetLevel(Level level) {
+    level_.store(level, std::memory_order_relaxed);
+}
+
+detail::ThreadBuffer& Logger::CurrentBuffer() {
+    // loggers are told apart by id, an address can be reused by a later one
+    thread_local std::vector<std::pair<uint64_t, std::shared_ptr<detail::ThreadBuffer>>> threadBuffers;
+    for (const auto& [id, buffer] : threadBuffers) {
+        if (id == id_) {
+            return *buffer;
+        }
+    }
+    auto buffer = std::make_shared<detail::ThreadBuffer>(kThreadBufferBytes);
+    {
+        std::lock_guard lock(buffersMutex_);
+        buffers_.push_back(buffer);
+    }
+    threadBuffers.emplace_back(id_, buffer);
+    return *buffer;
+}
+
+void Logger::Run() {
+    while (!stopping_) {
+        if (!Drain()) {
+            std::this_thread::sleep_for(kIdlePeriod);
+        }
+    }
+}
+
+void Logger::Flush() {
+    Drain();
+}
+
+bool Logger::Drain() {
+    std::lock_guard drainLock(drainMutex_);
+    std::vector<std::shared_ptr<detail::ThreadBuffer>> buffers;
+    {
+        std::lock_guard lock(buffersMutex_);
+        buffers = buffers_;
+    }
+
+    linesCount_ = 0;
+    const auto nextLine = [this]() -> Line& {
+        if (linesCount_ == lines_.size()) {
+            lines_.emplace_back();
+        }
+        return lines_[linesCount_++];
+    };
+    for (const auto& buffer : buffers) {
+        if (const uint64_t dropped = buffer->TakeDropped(); dropped > 0) {
+            auto& line = nextLine();
+            FormatPrefix(NowNs(), Level::Warning, "logging", line);
+            line.text += std::to_string(dropped) + " records dropped, thread buffer full";
+        }
+        while (const uint8_t* record = buffer->Peek()) {
+            Format(record, nextLine());
+            uint32_t size = 0;
+            std::memcpy(&size, record, sizeof(size));
+            buffer->Release(size);
+        }
+    }
+    if (linesCount_ == 0) {
+        return false;
+    }
+
+    // threads are merged by the time of the call
+    std::stable_sort(lines_.begin(), lines_.begin() + static_cast<std::ptrdiff_t>(linesCount_),
+                     [](const Line& left, const Line& right) { return left.timestampNs < right.timestampNs; });
+    bool errorsWritten = false;
+    for (std::size_t i = 0; i < linesCount_; ++i) {
+        const bool error = lines_[i].level >= Level::Warning;
+        (error ? errors_ : out_) << lines_[i].text << '\n';
+        errorsWritten = errorsWritten || error;
+    }
+    out_.flush();
+    if (errorsWritten) {
+        errors_.flush();
+    }
+    return true;
+}
+
+void Logger::FormatPrefix(int64_t timestampNs, Level level, const char* category, Line& line) const {
+    // seconds since the logger started, level letter and category
+    char prefix[64];
+    const int64_t elapsedNs = std::max<int64_t>(timestampNs - originNs_, 0);
+    std::snprintf(prefix, sizeof(prefix), "[%6" PRId64 ".%06" PRId64 "] %c ", elapsedNs / kNsPerSecond,
+                  (elapsedNs % kNsPerSecond) / 1000, kLevelLetters[static_cast<std::size_t>(level) & 3]);
+    line.timestampNs = timestampNs;
+    line.level = level;
+    line.text = prefix;
+    line.text += category;
+    line.text += ": ";
+}
+
+void Logger::Format(const uint8_t* record, Line& line) const {
+    detail::RecordHeader header{};
+    std::memcpy(&header, record, sizeof(header));
+    const uint8_t* argument = record + sizeof(header);
+    FormatPrefix(header.timestampNs, header.level, header.category->Name(), line);
+
+    const auto appendArgument = [&line, &argument]() {
+        const auto type = static_cast<detail::ArgumentType>(*argument++);
+        if (type == detail::ArgumentType::String) {
+            uint32_t size = 0;
+            std::memcpy(&size, argument, sizeof(size));
+            argument += sizeof(size);
+            line.text.append(reinterpret_cast<const char*>(argument), size);
+            argument += size;
+            return;
+        }
+        uint64_t bits = 0;
+        std::memcpy(&bits, argument, sizeof(bits));
+        argument += sizeof(bits);
+        char number[32];
+        switch (type) {
+        case detail::ArgumentType::Bool:
+            line.text += bits != 0 ? "true" : "false";
+            return;
+        case detail::ArgumentType::Char:
+            line.text += static_cast<char>(bits);
+            return;
+        case detail::ArgumentType::Signed:
+            std::snprintf(number, sizeof(number), "%" PRId64, static_cast<int64_t>(bits));
+            break;
+        case detail::ArgumentType::Unsigned:
+            std::snprintf(number, sizeof(number), "%" PRIu64, bits);
+            break;
+        default:
+            // as std::ostream prints by default
+            std::snprintf(number, sizeof(number), "%g", std::bit_cast<double>(bits));
+            break;
+        }
+        line.text += number;
+    };
+
+    std::size_t arguments = 0;
+    for (const char* c = header.format; *c != '\0'; ++c) {
+        if ((c[0] == '{' && c[1] == '{') || (c[0] == '}' && c[1] == '}')) {
+            line.text += *c++;
+        } else if (c[0] == '{' && c[1] == '}' && arguments < header.argumentsCount) {
+            appendArgument();
+            ++arguments;
+            ++c;
+        } else {
+            line.text += *c;
+        }
+    }
+    if (header.suppressed > 0) {
+        line.text += " [" + std::to_string(header.suppressed) + " suppressed before]";
+    }
+}
+
+Logger& DefaultLogger() {
+    static Logger logger(std::cout, std::cerr);
+    return logger;
+}
+
+} // namespace logging
@@ -0,0 +1,288 @@
+#include <band_power.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <numeric>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// bands narrower than this many Welch bins go through Goertzel
+constexpr double kGoertzelMaxBins = 2.0;
+
+double MeanOf(std::span<const float> values) {
+    return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+}
+
+double SquaresSum(const std::vector<float>& window) {
+    return std::accumulate(window.begin(), window.end(), 0.0,
+                           [](double sum, float value) { return sum + static_cast<double>(value) * value; });
+}
+} // namespace
+
+std::vector<PowerBand> DefaultPowerBands() {
+    return {{"theta", 4.0, 8.0}, {"alpha", 8.0, 13.0}, {"beta", 13.0, 30.0}};
+}
+
+std::vector<PowerBand> IndividualPowerBands(const clCIndividualNFBData& data) {
+    const double lower = data.lowerFrequency;
+    const double upper = data.upperFrequency;
+    return {{"theta", std::max(lower - 4.0, 1.0), lower}, {"alpha", lower, upper}, {"beta", upper, std::max(upper + 17.0, 30.0)}};
+}
+
+BandPowerEngine::BandPowerEngine(BandPowerConfig config, int32_t channels)
+        : config_{std::move(config)}
+        , channels_{std::max(channels, 0)}
+        , plan_{config_.segmentSamples}
+{
+    config_.segmentSamples = plan_.Size();
+    config_.windowSamples = std::max(config_.windowSamples, config_.segmentSamples);
+    config_.hopSamples = std::max<std::size_t>(config_.hopSamples, 1);
+    segmentWindow_ = HannWindow(config_.segmentSamples);
+    fullWindow_ = HannWindow(config_.windowSamples);
+    segmentScale_ = 2.0 / (config_.sampleRate * SquaresSum(segmentWindow_));
+    fullScale_ = 2.0 / (config_.sampleRate * SquaresSum(fullWindow_));
+
+    // segments that fit in the window at once
+    const std::size_t bins = plan_.BinsCount();
+    segmentSlots_ = (config_.windowSamples - config_.segmentSamples) / (config_.segmentSamples / 2) + 1;
+    segmentSpectra_.assign(segmentSlots_ * static_cast<std::size_t>(channels_) * bins, 0.0);
+    psdSums_.assign(static_cast<std::size_t>(channels_) * bins, 0.0);
+
+    history_.assign(static_cast<std::size_t>(channels_) * config_.windowSamples, 0.0f);
+    linear_.resize(config_.windowSamples);
+    segment_.resize(config_.segmentSamples);
+    windowed_.resize(config_.windowSamples);
+    spectrum_.resize(plan_.BinsCount());
+    psd_.resize(plan_.BinsCount());
+    meanPsd_.resize(plan_.BinsCount());
+    PlanBands();
+}
+
+const BandPowerConfig& BandPowerEngine::Config() const {
+    return config_;
+}
+
+int32_t BandPowerEngine::ChannelsCount() const {
+    return channels_;
+}
+
+std::size_t BandPowerEngine::BandsCount() const {
+    return config_.bands.size();
+}
+
+void BandPowerEngine::SetBands(std::vector<PowerBand> bands) {
+    config_.bands = std::move(bands);
+    PlanBands();
+}
+
+void BandPowerEngine::SetPowersHandler(PowersHandler handler) {
+    handler_ = std::move(handler);
+}
+
+void BandPowerEngine::SetSpectrumHandler(SpectrumHandler handler) {
+    spectrumHandler_ = std::move(handler);
+}
+
+std::size_t BandPowerEngine::BinsCount() const {
+    return plan_.BinsCount();
+}
+
+void BandPowerEngine::SetChannelSpectraHandler(ChannelSpectraHandler handler) {
+    channelSpectraHandler_ = std::move(handler);
+    channelPsds_.assign(channelSpectraHandler_ ? static_cast<std::size_t>(channels_) * plan_.BinsCount() : 0, 0.0);
+}
+
+uint64_t BandPowerEngine::UpdatesCount() const {
+    return updates_;
+}
+
+void BandPowerEngine::PlanBands() {
+    const double binWidth = config_.sampleRate / static_cast<double>(config_.segmentSamples);
+    const double fineBinWidth = config_.sampleRate / static_cast<double>(config_.windowSamples);
+    const std::size_t bins = plan_.BinsCount();
+    bandPlans_.clear();
+    needsWelch_ = false;
+    for (const auto& band : config_.bands) {
+        BandPlan plan;
+        plan.goertzel = band.high - band.low < kGoertzelMaxBins * binWidth;
+        if (plan.goertzel) {
+            // every bin of the whole window inside the band, at least the center
+            for (double frequency = std::ceil(band.low / fineBinWidth) * fineBinWidth; frequency < band.high;
+                 frequency += fineBinWidth) {
+                const double w = 2.0 * std::numbers::pi * frequency / config_.sampleRate;
+                plan.goertzelCoefficients.push_back(static_cast<float>(2.0 * std::cos(w)));
+            }
+            if (plan.goertzelCoefficients.empty()) {
+                const double w = std::numbers::pi * (band.low + band.high) / config_.sampleRate;
+                plan.goertzelCoefficients.push_back(static_cast<float>(2.0 * std::cos(w)));
+            }
+        } else {
+            plan.firstBin = std::min(static_cast<std::size_t>(std::ceil(band.low / binWidth)), bins);
+            plan.lastBin = std::min(static_cast<std::size_t>(std::ceil(band.high / binWidth)), bins);
+            needsWelch_ = true;
+        }
+        bandPlans_.push_back(std::move(plan));
+    }
+    powers_.assign(static_cast<std::size_t>(channels_) * bandPlans_.size(), 0.0f);
+}
+
+void BandPowerEngine::Push(const SignalBlock& block) {
+    const auto timepoints = block.Timepoints();
+    const int32_t channels = std::min(block.ChannelsCount(), channels_);
+    const std::size_t windowSamples = config_.windowSamples;
+    for (std::size_t sample = 0; sample < timepoints.size(); ++sample) {
+        for (int32_t channel = 0; channel < channels; ++channel) {
+            history_[static_cast<std::size_t>(channel) * windowSamples + writeIndex_] = block.Channel(channel)[sample];
+        }
+        writeIndex_ = (writeIndex_ + 1) % windowSamples;
+        filled_ = std::min(filled_ + 1, windowSamples);
+        ++samplesPushed_;
+        const std::size_t segmentSamples = config_.segmentSamples;
+        if (samplesPushed_ >= segmentSamples && (samplesPushed_ - segmentSamples) % (segmentSamples / 2) == 0) {
+            TransformSegment();
+        }
+        if (++sinceUpdate_ >= config_.hopSamples && filled_ == windowSamples) {
+            Update(timepoints[sample]);
+            sinceUpdate_ = 0;
+        }
+    }
+}
+
+void BandPowerEngine::Update(uint64_t timepoint) {
+    const std::size_t windowSamples = config_.windowSamples;
+    const std::size_t bands = bandPlans_.size();
+    const double binWidth = config_.sampleRate / static_cast<double>(config_.segmentSamples);
+    const double fineBinWidth = config_.sampleRate / static_cast<double>(windowSamples);
+    const bool computeSpectrum = needsWelch_ || spectrumHandler_ || channelSpectraHandler_;
+    const bool goertzel = std::any_of(bandPlans_.begin(), bandPlans_.end(), [](const BandPlan& plan) { return plan.goertzel; });
+    DropOldSegments();
+    std::fill(meanPsd_.begin(), meanPsd_.end(), 0.0);
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        if (goertzel) {
+            // oldest sample first
+            const float* ring = history_.data() + static_cast<std::size_t>(channel) * windowSamples;
+            std::copy(ring + writeIndex_, ring + windowSamples, linear_.begin());
+            std::copy(ring, ring + writeIndex_,
+                      linear_.begin() + static_cast<std::ptrdiff_t>(windowSamples - writeIndex_));
+        }
+
+        if (computeSpectrum) {
+            WelchPsd(channel);
+        }
+        if (spectrumHandler_) {
+            for (std::size_t bin = 0; bin < meanPsd_.size(); ++bin) {
+                meanPsd_[bin] += psd_[bin] / channels_;
+            }
+        }
+        if (channelSpectraHandler_) {
+            const auto offset = static_cast<std::ptrdiff_t>(static_cast<std::size_t>(channel) * psd_.size());
+            std::copy(psd_.begin(), psd_.end(), channelPsds_.begin() + offset);
+        }
+        for (std::size_t band = 0; band < bands; ++band) {
+            const auto& plan = bandPlans_[band];
+            double power = 0.0;
+            if (plan.goertzel) {
+                power = GoertzelPower(linear_, plan) * fullScale_ * fineBinWidth;
+            } else {
+                for (std::size_t bin = plan.firstBin; bin < plan.lastBin; ++bin) {
+                    power += psd_[bin];
+                }
+                power *= binWidth;
+            }
+            powers_[static_cast<std::size_t>(channel) * bands + band] = static_cast<float>(power);
+        }
+    }
+    ++updates_;
+    if (handler_) {
+        handler_(timepoint, powers_);
+    }
+    if (spectrumHandler_) {
+        spectrumHandler_(timepoint, meanPsd_, binWidth);
+    }
+    if (channelSpectraHandler_) {
+        channelSpectraHandler_(timepoint, channelPsds_, binWidth);
+    }
+}
+
+void BandPowerEngine::TransformSegment() {
+    const std::size_t windowSamples = config_.windowSamples;
+    const std::size_t segmentSamples = config_.segmentSamples;
+    const std::size_t bins = plan_.BinsCount();
+    DropOldSegments();
+    double* spectra = segmentSpectra_.data() + (nextSegment_ % segmentSlots_) * static_cast<std::size_t>(channels_) * bins;
+    // the segment ends with the last written sample
+    const std::size_t first = (writeIndex_ + windowSamples - segmentSamples) % windowSamples;
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        const float* ring = history_.data() + static_cast<std::size_t>(channel) * windowSamples;
+        for (std::size_t i = 0; i < segmentSamples; ++i) {
+            segment_[i] = ring[(first + i) % windowSamples];
+        }
+        // the offset of raw EEG would leak into the lowest bins
+        const auto mean = static_cast<float>(MeanOf(segment_));
+        for (std::size_t i = 0; i < segmentSamples; ++i) {
+            segment_[i] = (segment_[i] - mean) * segmentWindow_[i];
+        }
+        plan_.Forward(segment_, spectrum_);
+        double* periodogram = spectra + static_cast<std::size_t>(channel) * bins;
+        double* sums = psdSums_.data() + static_cast<std::size_t>(channel) * bins;
+        for (std::size_t bin = 0; bin < bins; ++bin) {
+            periodogram[bin] = std::norm(spectrum_[bin]);
+            sums[bin] += periodogram[bin];
+        }
+    }
+    ++nextSegment_;
+}
+
+// Segments that started before the window are taken out of the sums
+void BandPowerEngine::DropOldSegments() {
+    const std::size_t bins = plan_.BinsCount();
+    const uint64_t step = config_.segmentSamples / 2;
+    const uint64_t windowStart = samplesPushed_ > config_.windowSamples ? samplesPushed_ - config_.windowSamples : 0;
+    while (oldestSegment_ < nextSegment_ && oldestSegment_ * step < windowStart) {
+        const double* spectra = segmentSpectra_.data()
+                                + (oldestSegment_ % segmentSlots_) * static_cast<std::size_t>(channels_) * bins;
+        for (std::size_t i = 0; i < psdSums_.size(); ++i) {
+            psdSums_[i] -= spectra[i];
+        }
+        ++oldestSegment_;
+    }
+}
+
+void BandPowerEngine::WelchPsd(int32_t channel) {
+    const std::size_t bins = plan_.BinsCount();
+    const double* sums = psdSums_.data() + static_cast<std::size_t>(channel) * bins;
+    const auto segments = std::max<uint64_t>(nextSegment_ - oldestSegment_, 1);
+    const double scale = segmentScale_ / static_cast<double>(segments);
+    for (std::size_t bin = 0; bin < bins; ++bin) {
+        // rounding of the running sums must not turn an empty bin negative
+        psd_[bin] = std::max(sums[bin], 0.0) * scale;
+    }
+    // DC and Nyquist are not doubled in a one-sided spectrum
+    psd_.front() /= 2.0;
+    psd_.back() /= 2.0;
+}
+
+float BandPowerEngine::GoertzelPower(std::span<const float> window, const BandPlan& band) {
+    const auto mean = static_cast<float>(MeanOf(window));
+    for (std::size_t i = 0; i < window.size(); ++i) {
+        windowed_[i] = (window[i] - mean) * fullWindow_[i];
+    }
+    float power = 0.0f;
+    for (const float coefficient : band.goertzelCoefficients) {
+        float s1 = 0.0f;
+        float s2 = 0.0f;
+        for (const float value : windowed_) {
+            const float s0 = value + coefficient * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        power += s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+    }
+    return power;
+}
+
+} // namespace signal_processing
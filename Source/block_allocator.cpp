@@ -0,0 +1,246 @@
+#include <block_allocator.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <new>
+#include <optional>
+
+namespace block_memory
+{
+namespace
+{
+using detail::BlockHeader;
+
+// memory requested from the system at once for small size classes
+constexpr std::size_t kSlabSize = std::size_t{256} << 10;
+// blocks a thread keeps per size class before handing half of them back
+constexpr std::size_t kLocalLimit = 32;
+// blocks moved from the shared list to a thread at once
+constexpr std::size_t kRefillBatch = 8;
+constexpr uint32_t kOversizedClass = kSizeClasses;
+
+static_assert(kMinBlockSize << (kSizeClasses - 1) == kMaxBlockSize);
+static_assert(sizeof(BlockHeader) == kBlockAlignment);
+
+constexpr std::size_t BlockSizeOf(std::size_t sizeClass) {
+    return kMinBlockSize << sizeClass;
+}
+
+std::optional<std::size_t> SizeClassOf(std::size_t size) {
+    if (size > kMaxBlockSize) {
+        return std::nullopt;
+    }
+    const std::size_t blockSize = std::bit_ceil(std::max(size, kMinBlockSize));
+    return static_cast<std::size_t>(std::countr_zero(blockSize) - std::countr_zero(kMinBlockSize));
+}
+
+struct Counters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> releases{0};
+    std::atomic<uint64_t> localHits{0};
+    std::atomic<uint64_t> sharedRefills{0};
+    std::atomic<uint64_t> slabAllocations{0};
+    std::atomic<uint64_t> oversizedAllocations{0};
+    std::atomic<uint64_t> bytesInUse{0};
+    std::atomic<uint64_t> bytesReserved{0};
+    std::array<std::atomic<uint64_t>, kSizeClasses> blocksInUse{};
+    std::array<std::atomic<uint64_t>, kSizeClasses> blocksReserved{};
+};
+
+struct SharedPool {
+    std::mutex mutex;
+    std::array<BlockHeader*, kSizeClasses> free{};
+    Counters counters;
+};
+
+// Never destroyed: thread caches may hand blocks back during program exit,
+// and slabs are not returned to the system anyway
+SharedPool& Shared() {
+    static SharedPool* pool = new SharedPool();
+    return *pool;
+}
+
+// Requires the shared mutex
+void CarveSlab(SharedPool& shared, std::size_t sizeClass) {
+    const std::size_t stride = sizeof(BlockHeader) + BlockSizeOf(sizeClass);
+    const std::size_t slabSize = std::max(kSlabSize, stride);
+    auto* slab = static_cast<std::byte*>(::operator new(slabSize, std::align_val_t{kBlockAlignment}));
+    const std::size_t blocks = slabSize / stride;
+    for (std::size_t i = 0; i < blocks; ++i) {
+        auto* header = new (slab + i * stride) BlockHeader();
+        header->sizeClass = static_cast<uint32_t>(sizeClass);
+        header->next = shared.free[sizeClass];
+        shared.free[sizeClass] = header;
+    }
+    shared.counters.slabAllocations.fetch_add(1, std::memory_order_relaxed);
+    shared.counters.bytesReserved.fetch_add(slabSize, std::memory_order_relaxed);
+    shared.counters.blocksReserved[sizeClass].fetch_add(blocks, std::memory_order_relaxed);
+}
+
+// Per-thread free lists
+struct LocalCache {
+    std::array<BlockHeader*, kSizeClasses> free{};
+    std::array<std::size_t, kSizeClasses> count{};
+
+    ~LocalCache();
+
+    // Moves count blocks of the class to the shared list
+    void Return(std::size_t sizeClass, std::size_t blocks) {
+        auto& shared = Shared();
+        std::lock_guard lock(shared.mutex);
+        for (std::size_t i = 0; i < blocks && free[sizeClass] != nullptr; ++i) {
+            BlockHeader* header = free[sizeClass];
+            free[sizeClass] = header->next;
+            --count[sizeClass];
+            header->next = shared.free[sizeClass];
+            shared.free[sizeClass] = header;
+        }
+    }
+
+    void Refill(std::size_t sizeClass) {
+        auto& shared = Shared();
+        std::lock_guard lock(shared.mutex);
+        if (shared.free[sizeClass] == nullptr) {
+            CarveSlab(shared, sizeClass);
+        }
+        for (std::size_t i = 0; i < kRefillBatch && shared.free[sizeClass] != nullptr; ++i) {
+            BlockHeader* header = shared.free[sizeClass];
+            shared.free[sizeClass] = header->next;
+            header->next = free[sizeClass];
+            free[sizeClass] = header;
+            ++count[sizeClass];
+        }
+        shared.counters.sharedRefills.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// trivially destructible, so it can be checked while thread-local objects are destroyed
+thread_local bool localCacheDestroyed = false;
+thread_local LocalCache localCache;
+
+LocalCache::~LocalCache() {
+    for (std::size_t sizeClass = 0; sizeClass < kSizeClasses; ++sizeClass) {
+        Return(sizeClass, count[sizeClass]);
+    }
+    localCacheDestroyed = true;
+}
+
+void ReleaseToShared(BlockHeader* header) {
+    auto& shared = Shared();
+    std::lock_guard lock(shared.mutex);
+    header->next = shared.free[header->sizeClass];
+    shared.free[header->sizeClass] = header;
+}
+} // namespace
+
+namespace detail
+{
+void ReleaseBlock(BlockHeader* header) {
+    auto& counters = Shared().counters;
+    counters.releases.fetch_add(1, std::memory_order_relaxed);
+    if (header->sizeClass == kOversizedClass) {
+        counters.bytesInUse.fetch_sub(header->size, std::memory_order_relaxed);
+        counters.bytesReserved.fetch_sub(sizeof(BlockHeader) + header->size, std::memory_order_relaxed);
+        header->~BlockHeader();
+        ::operator delete(header, std::align_val_t{kBlockAlignment});
+        return;
+    }
+    const std::size_t sizeClass = header->sizeClass;
+    counters.bytesInUse.fetch_sub(BlockSizeOf(sizeClass), std::memory_order_relaxed);
+    counters.blocksInUse[sizeClass].fetch_sub(1, std::memory_order_relaxed);
+    if (localCacheDestroyed) {
+        ReleaseToShared(header);
+        return;
+    }
+    auto& cache = localCache;
+    header->next = cache.free[sizeClass];
+    cache.free[sizeClass] = header;
+    if (++cache.count[sizeClass] > kLocalLimit) {
+        cache.Return(sizeClass, kLocalLimit / 2);
+    }
+}
+} // namespace detail
+
+BlockHandle Allocate(std::size_t size) {
+    auto& counters = Shared().counters;
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    BlockHeader* header = nullptr;
+    const auto sizeClass = SizeClassOf(size);
+    if (!sizeClass.has_value()) {
+        auto* memory = ::operator new(sizeof(BlockHeader) + size, std::align_val_t{kBlockAlignment});
+        header = new (memory) BlockHeader();
+        header->sizeClass = kOversizedClass;
+        counters.oversizedAllocations.fetch_add(1, std::memory_order_relaxed);
+        counters.bytesReserved.fetch_add(sizeof(BlockHeader) + size, std::memory_order_relaxed);
+        counters.bytesInUse.fetch_add(size, std::memory_order_relaxed);
+    } else if (localCacheDestroyed) {
+        // thread is exiting, bypass its cache
+        auto& shared = Shared();
+        std::lock_guard lock(shared.mutex);
+        if (shared.free[*sizeClass] == nullptr) {
+            CarveSlab(shared, *sizeClass);
+        }
+        header = shared.free[*sizeClass];
+        shared.free[*sizeClass] = header->next;
+    } else {
+        auto& cache = localCache;
+        if (cache.free[*sizeClass] != nullptr) {
+            counters.localHits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            cache.Refill(*sizeClass);
+        }
+        header = cache.free[*sizeClass];
+        cache.free[*sizeClass] = header->next;
+        --cache.count[*sizeClass];
+    }
+    if (sizeClass.has_value()) {
+        counters.bytesInUse.fetch_add(BlockSizeOf(*sizeClass), std::memory_order_relaxed);
+        counters.blocksInUse[*sizeClass].fetch_add(1, std::memory_order_relaxed);
+    }
+    header->next = nullptr;
+    header->size = size;
+    header->references.store(1, std::memory_order_relaxed);
+    return BlockHandle(header);
+}
+
+AllocatorStats Stats() {
+    const auto& counters = Shared().counters;
+    AllocatorStats stats;
+    stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+    stats.releases = counters.releases.load(std::memory_order_relaxed);
+    stats.localHits = counters.localHits.load(std::memory_order_relaxed);
+    stats.sharedRefills = counters.sharedRefills.load(std::memory_order_relaxed);
+    stats.slabAllocations = counters.slabAllocations.load(std::memory_order_relaxed);
+    stats.oversizedAllocations = counters.oversizedAllocations.load(std::memory_order_relaxed);
+    stats.bytesInUse = counters.bytesInUse.load(std::memory_order_relaxed);
+    stats.bytesReserved = counters.bytesReserved.load(std::memory_order_relaxed);
+    for (std::size_t sizeClass = 0; sizeClass < kSizeClasses; ++sizeClass) {
+        stats.sizeClasses[sizeClass].blockSize = BlockSizeOf(sizeClass);
+        stats.sizeClasses[sizeClass].blocksInUse = counters.blocksInUse[sizeClass].load(std::memory_order_relaxed);
+        stats.sizeClasses[sizeClass].blocksReserved = counters.blocksReserved[sizeClass].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void PrintStats(std::ostream& out) {
+    const auto stats = Stats();
+    out << "Block allocator: " << stats.allocations << " allocations, "
+        << stats.releases << " releases, "
+        << stats.localHits << " thread-local hits, "
+        << stats.sharedRefills << " shared refills, "
+        << stats.slabAllocations << " slabs, "
+        << stats.oversizedAllocations << " oversized, "
+        << stats.bytesInUse << " bytes in use of " << stats.bytesReserved << " reserved\n";
+    for (const auto& sizeClass : stats.sizeClasses) {
+        if (sizeClass.blocksReserved == 0) {
+            continue;
+        }
+        out << "\t" << sizeClass.blockSize << " B: " << sizeClass.blocksInUse << " in use of "
+            << sizeClass.blocksReserved << " blocks\n";
+    }
+    out << std::flush;
+}
+
+} // namespace block_memory
@@ -0,0 +1,205 @@
+#include <calibration_cache.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+namespace calibration
+{
+namespace
+{
+constexpr std::string_view kHeader =
+        "user,device,calibrated_at,individual_frequency,individual_peak_frequency,individual_peak_frequency_power,"
+        "individual_peak_frequency_suppression,individual_bandwidth,individual_normalized_power,lower_frequency,"
+        "upper_frequency";
+constexpr std::size_t kIndividualColumns = 8;
+constexpr std::size_t kColumns = 3 + kIndividualColumns;
+
+// Fields in the column order, for const and mutable structs alike
+template <typename Data>
+auto individualFields(Data& data) {
+    return std::array{&data.individualFrequency, &data.individualPeakFrequency, &data.individualPeakFrequencyPower,
+                      &data.individualPeakFrequencySuppression, &data.individualBandwidth,
+                      &data.individualNormalizedPower, &data.lowerFrequency, &data.upperFrequency};
+}
+
+std::vector<std::string_view> splitLine(std::string_view line) {
+    std::vector<std::string_view> fields;
+    while (true) {
+        const auto comma = line.find(',');
+        fields.push_back(line.substr(0, comma));
+        if (comma == std::string_view::npos) {
+            return fields;
+        }
+        line.remove_prefix(comma + 1);
+    }
+}
+
+template <typename T>
+bool parseField(std::string_view text, T& value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+std::optional<CalibrationRecord> parseRecord(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    const auto fields = splitLine(line);
+    if (fields.size() != kColumns || fields[0].empty() || fields[1].empty()) {
+        return std::nullopt;
+    }
+    CalibrationRecord record;
+    record.user = std::string(fields[0]);
+    record.device = std::string(fields[1]);
+    if (!parseField(fields[2], record.calibratedAt)) {
+        return std::nullopt;
+    }
+    const auto individual = individualFields(record.individual);
+    for (std::size_t i = 0; i < kIndividualColumns; ++i) {
+        if (!parseField(fields[3 + i], *individual[i])) {
+            return std::nullopt;
+        }
+    }
+    return record;
+}
+
+bool validKey(const std::string& text) {
+    return !text.empty() && text.find_first_of(",\r\n") == std::string::npos;
+}
+} // namespace
+
+PeakCheck CheckCachedPeak(double cachedPeak, std::optional<double> trackedPeak, uint64_t acceptedSpectra,
+                          const CachePolicy& policy) {
+    if (!trackedPeak || acceptedSpectra < policy.minSpectra) {
+        return PeakCheck::Pending;
+    }
+    if (std::abs(*trackedPeak - cachedPeak) > policy.maxPeakShiftHz) {
+        return PeakCheck::Rejected;
+    }
+    return acceptedSpectra >= policy.confirmSpectra ? PeakCheck::Confirmed : PeakCheck::Pending;
+}
+
+CalibrationCache::CalibrationCache(std::string path)
+        : path_{std::move(path)}
+{
+    std::ifstream in(path_);
+    if (!in.is_open()) {
+        return;
+    }
+    std::string line;
+    std::getline(in, line);
+    for (int32_t lineNumber = 2; std::getline(in, line); ++lineNumber) {
+        if (line.empty()) {
+            continue;
+        }
+        auto record = parseRecord(line);
+        if (!record) {
+            std::cerr << path_ << ":" << lineNumber << ": unreadable calibration, dropped" << std::endl;
+            continue;
+        }
+        // the last line of a user and device wins
+        if (const auto existing = FindRecord(record->user, record->device); existing != records_.end()) {
+            *existing = std::move(*record);
+        } else {
+            records_.push_back(std::move(*record));
+        }
+    }
+}
+
+std::optional<CalibrationRecord> CalibrationCache::Find(const std::string& user, const std::string& device,
+                                                        int64_t now, std::chrono::seconds maxAge) const {
+    const auto record = FindRecord(user, device);
+    if (record == records_.end() || now - record->calibratedAt > maxAge.count()) {
+        return std::nullopt;
+    }
+    return *record;
+}
+
+bool CalibrationCache::Save(CalibrationRecord record) {
+    if (!validKey(record.user) || !validKey(record.device)) {
+        std::cerr << "Calibration of '" << record.user << "' on '" << record.device
+                  << "' is not cached: names must not be empty or contain commas" << std::endl;
+        return false;
+    }
+    if (const auto existing = FindRecord(record.user, record.device); existing != records_.end()) {
+        *existing = std::move(record);
+    } else {
+        records_.push_back(std::move(record));
+    }
+    return Write();
+}
+
+bool CalibrationCache::Remove(const std::string& user, const std::string& device) {
+    const auto record = FindRecord(user, device);
+    if (record == records_.end()) {
+        return false;
+    }
+    records_.erase(record);
+    return Write();
+}
+
+std::size_t CalibrationCache::Size() const {
+    return records_.size();
+}
+
+std::vector<CalibrationRecord>::iterator CalibrationCache::FindRecord(const std::string& user,
+                                                                      const std::string& device) {
+    return records_.begin() + (std::as_const(*this).FindRecord(user, device) - records_.cbegin());
+}
+
+std::vector<CalibrationRecord>::const_iterator CalibrationCache::FindRecord(const std::string& user,
+                                                                            const std::string& device) const {
+    return std::find_if(records_.begin(), records_.end(), [&](const CalibrationRecord& record) {
+        return record.user == user && record.device == device;
+    });
+}
+
+bool CalibrationCache::Write() const {
+    // written next to the cache and renamed over it, so a crash leaves the old file
+    const std::string temporary = path_ + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Cannot write the calibration cache " << temporary << std::endl;
+            return false;
+        }
+        out << kHeader << '\n';
+        out.precision(std::numeric_limits<float>::max_digits10);
+        for (const auto& record : records_) {
+            out << record.user << ',' << record.device << ',' << record.calibratedAt;
+            for (const float* field : individualFields(record.individual)) {
+                out << ',' << *field;
+            }
+            out << '\n';
+        }
+        if (!out.flush()) {
+            std::cerr << "Cannot write the calibration cache " << temporary << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path_, error);
+    if (error) {
+        std::cerr << "Cannot replace the calibration cache " << path_ << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PrintRecord(std::ostream& out, const CalibrationRecord& record, int64_t now) {
+    const double ageDays = static_cast<double>(now - record.calibratedAt) / (24.0 * 3600.0);
+    out << "Calibration of " << record.user << " on " << record.device << ", " << ageDays << " days old: IAF "
+        << record.individual.individualFrequency << " Hz, IAPF " << record.individual.individualPeakFrequency
+        << " Hz, alpha " << record.individual.lowerFrequency << " - " << record.individual.upperFrequency << " Hz"
+        << std::endl;
+}
+
+} // namespace calibration
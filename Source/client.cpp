@@ -1,10 +1,14 @@
 #include <client.hpp>
 #include <WS2tcpip.h>
 
+#include <async_logger.hpp>
+
 namespace socket_communication
 {
 namespace
 {
+const logging::Category kClientLog{"client"};
+
 bool TestWinsock() {
     WSADATA wsaData;
     int iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -36,6 +40,30 @@ void SerializeData(const Data &data, char *buffer, size_t &buffer_size, uint32_t
     memcpy(buffer + buff_curr_size, &data.individualPeakFrequency.value, sizeof(float));
     buff_curr_size += sizeof(float);
 
+    memcpy(buffer + buff_curr_size, &data.trackedPeakFrequency.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.signalQuality.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.fatigueForecast.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.fatigueForecastEarliest.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.fatigueForecastLatest.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.concentrationForecast.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.concentrationForecastEarliest.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
+    memcpy(buffer + buff_curr_size, &data.concentrationForecastLatest.value, sizeof(float));
+    buff_curr_size += sizeof(float);
+
     buffer_size = buff_curr_size;
 }
 
@@ -103,17 +131,17 @@ void Client::SendData(const Data &data, uint32_t field_flags) {
     size_t buffer_size = 0;
     SerializeData(data, buffer, buffer_size, field_flags);
 
-    std::cout << "[Client]: Sending data" << std::endl;
+    logging::Debug(kClientLog, "Sending data");
     size_t bytes_sent = send(client_, buffer, static_cast<int>(buffer_size), 0);
     if (bytes_sent == SOCKET_ERROR) {
-        std::cout << "[Client]: Send failed: " << WSAGetLastError() << std::endl;
+        logging::Error(kClientLog, "Send failed: {}", WSAGetLastError());
         DisconnectFromServer(client_);
         while (!ConnectToServer(client_, servAddr_)) {
             std::cerr << "Connect to server failed, try again...\n";
             std::this_thread::sleep_for(std::chrono::seconds(5));
         }
     } else {
-        std::cout << "[Client]: Bytes Sent " << bytes_sent << std::endl;
+        logging::Debug(kClientLog, "Bytes sent {}", bytes_sent);
     }
 
 //        char response[1024];
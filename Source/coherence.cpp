@@ -0,0 +1,234 @@
+#include <coherence.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// "F3" -> {"F", 3}, names without a trailing number give nothing
+std::optional<std::pair<std::string_view, int>> SplitElectrode(std::string_view name) {
+    std::size_t digits = name.size();
+    while (digits > 0 && std::isdigit(static_cast<unsigned char>(name[digits - 1])) != 0) {
+        --digits;
+    }
+    int number = 0;
+    if (digits == 0 || digits == name.size()
+        || std::from_chars(name.data() + digits, name.data() + name.size(), number).ec != std::errc{}) {
+        return std::nullopt;
+    }
+    return std::pair{name.substr(0, digits), number};
+}
+
+std::optional<int32_t> FindChannel(std::span<const std::string> names, std::string_view name) {
+    const auto it = std::find(names.begin(), names.end(), name);
+    if (it == names.end()) {
+        return std::nullopt;
+    }
+    return static_cast<int32_t>(it - names.begin());
+}
+} // namespace
+
+std::vector<ChannelPair> HomologousPairs(std::span<const std::string> names) {
+    std::vector<ChannelPair> pairs;
+    for (int32_t left = 0; left < static_cast<int32_t>(names.size()); ++left) {
+        const auto electrode = SplitElectrode(names[left]);
+        if (!electrode || electrode->second % 2 == 0) {
+            continue;
+        }
+        for (int32_t right = 0; right < static_cast<int32_t>(names.size()); ++right) {
+            const auto other = SplitElectrode(names[right]);
+            if (other && other->first == electrode->first && other->second == electrode->second + 1) {
+                pairs.push_back({names[left] + ":" + names[right], left, right});
+            }
+        }
+    }
+    return pairs;
+}
+
+std::optional<std::vector<ChannelPair>> ParsePairs(std::string_view spec, std::span<const std::string> names) {
+    std::vector<ChannelPair> pairs;
+    while (!spec.empty()) {
+        const auto comma = spec.find(',');
+        const auto item = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view{} : spec.substr(comma + 1);
+        const auto colon = item.find(':');
+        if (colon == std::string_view::npos) {
+            std::cerr << "Channel pair without ':' " << item << std::endl;
+            return std::nullopt;
+        }
+        const auto left = FindChannel(names, item.substr(0, colon));
+        const auto right = FindChannel(names, item.substr(colon + 1));
+        if (!left || !right) {
+            std::cerr << "Unknown channel in pair " << item << std::endl;
+            return std::nullopt;
+        }
+        pairs.push_back({std::string(item), *left, *right});
+    }
+    return pairs;
+}
+
+CoherenceEngine::CoherenceEngine(CoherenceConfig config, std::vector<ChannelPair> pairs)
+        : config_{std::move(config)}
+        , pairs_{std::move(pairs)}
+        , plan_{config_.segmentSamples}
+        , window_{HannWindow(plan_.Size())}
+        , bins_{plan_.BinsCount()}
+        , hop_{std::max<std::size_t>(plan_.Size() / 2, 1)}
+{
+    config_.segmentSamples = plan_.Size();
+    config_.averagedSegments = std::max<std::size_t>(config_.averagedSegments, 1);
+    const double binWidth = config_.sampleRate / static_cast<double>(config_.segmentSamples);
+    for (const auto& band : config_.bands) {
+        bandBins_.emplace_back(std::min(static_cast<std::size_t>(std::ceil(band.low / binWidth)), bins_),
+                               std::min(static_cast<std::size_t>(std::ceil(band.high / binWidth)), bins_));
+    }
+
+    auto inputIndex = [this](int32_t channel) {
+        const auto it = std::find(inputs_.begin(), inputs_.end(), channel);
+        if (it != inputs_.end()) {
+            return static_cast<std::size_t>(it - inputs_.begin());
+        }
+        inputs_.push_back(channel);
+        return inputs_.size() - 1;
+    };
+    for (const auto& pair : pairs_) {
+        const std::size_t left = inputIndex(pair.left);
+        const std::size_t right = inputIndex(pair.right);
+        pairInputs_.emplace_back(left, right);
+    }
+
+    const std::size_t inputs = inputs_.size();
+    const std::size_t slots = config_.averagedSegments;
+    history_.assign(inputs * config_.segmentSamples, 0.0f);
+    segment_.resize(config_.segmentSamples);
+    spectra_.resize(inputs * bins_);
+    autoHistory_.assign(slots * inputs * bins_, 0.0f);
+    autoSums_.assign(inputs * bins_, 0.0);
+    crossHistory_.assign(slots * pairs_.size() * bins_, {});
+    crossSums_.assign(pairs_.size() * bins_, {});
+    coherence_.assign(pairs_.size() * bandBins_.size(), 0.0f);
+    asymmetry_.assign(pairs_.size() * bandBins_.size(), 0.0f);
+}
+
+std::span<const ChannelPair> CoherenceEngine::Pairs() const {
+    return pairs_;
+}
+
+std::size_t CoherenceEngine::BandsCount() const {
+    return bandBins_.size();
+}
+
+const CoherenceConfig& CoherenceEngine::Config() const {
+    return config_;
+}
+
+void CoherenceEngine::SetMeasuresHandler(MeasuresHandler handler) {
+    handler_ = std::move(handler);
+}
+
+void CoherenceEngine::Push(const SignalBlock& block) {
+    if (pairs_.empty()) {
+        return;
+    }
+    const auto timepoints = block.Timepoints();
+    const std::size_t segmentSamples = config_.segmentSamples;
+    for (std::size_t sample = 0; sample < timepoints.size(); ++sample) {
+        for (std::size_t input = 0; input < inputs_.size(); ++input) {
+            const int32_t channel = inputs_[input];
+            history_[input * segmentSamples + writeIndex_] = channel < block.ChannelsCount()
+                                                                     ? block.Channel(channel)[sample]
+                                                                     : 0.0f;
+        }
+        writeIndex_ = (writeIndex_ + 1) % segmentSamples;
+        filled_ = std::min(filled_ + 1, segmentSamples);
+        if (++sinceUpdate_ >= hop_ && filled_ == segmentSamples) {
+            Update(timepoints[sample]);
+            sinceUpdate_ = 0;
+        }
+    }
+}
+
+void CoherenceEngine::Update(uint64_t timepoint) {
+    const std::size_t segmentSamples = config_.segmentSamples;
+    const std::size_t inputs = inputs_.size();
+    float* autoSlot = autoHistory_.data() + slot_ * inputs * bins_;
+    for (std::size_t input = 0; input < inputs; ++input) {
+        // oldest sample first, without the offset of raw EEG
+        const float* ring = history_.data() + input * segmentSamples;
+        std::copy(ring + writeIndex_, ring + segmentSamples, segment_.begin());
+        std::copy(ring, ring + writeIndex_, segment_.begin() + static_cast<std::ptrdiff_t>(segmentSamples - writeIndex_));
+        const float mean = std::accumulate(segment_.begin(), segment_.end(), 0.0f) / static_cast<float>(segmentSamples);
+        for (std::size_t i = 0; i < segmentSamples; ++i) {
+            segment_[i] = (segment_[i] - mean) * window_[i];
+        }
+        const auto spectrum = std::span(spectra_).subspan(input * bins_, bins_);
+        plan_.Forward(segment_, spectrum);
+
+        double* sums = autoSums_.data() + input * bins_;
+        float* slot = autoSlot + input * bins_;
+        for (std::size_t bin = 0; bin < bins_; ++bin) {
+            const float power = std::norm(spectrum[bin]);
+            sums[bin] += static_cast<double>(power) - slot[bin];
+            slot[bin] = power;
+        }
+    }
+
+    std::complex<float>* crossSlot = crossHistory_.data() + slot_ * pairs_.size() * bins_;
+    for (std::size_t pair = 0; pair < pairs_.size(); ++pair) {
+        const std::complex<float>* left = spectra_.data() + pairInputs_[pair].first * bins_;
+        const std::complex<float>* right = spectra_.data() + pairInputs_[pair].second * bins_;
+        std::complex<double>* sums = crossSums_.data() + pair * bins_;
+        std::complex<float>* slot = crossSlot + pair * bins_;
+        for (std::size_t bin = 0; bin < bins_; ++bin) {
+            // written out, std::complex operator* is slow without -ffast-math
+            const float re = left[bin].real() * right[bin].real() + left[bin].imag() * right[bin].imag();
+            const float im = left[bin].imag() * right[bin].real() - left[bin].real() * right[bin].imag();
+            sums[bin] += std::complex<double>(re - slot[bin].real(), im - slot[bin].imag());
+            slot[bin] = {re, im};
+        }
+    }
+
+    slot_ = (slot_ + 1) % config_.averagedSegments;
+    segments_ = std::min(segments_ + 1, config_.averagedSegments);
+    if (segments_ == config_.averagedSegments) {
+        Publish(timepoint);
+    }
+}
+
+void CoherenceEngine::Publish(uint64_t timepoint) {
+    const std::size_t bands = bandBins_.size();
+    for (std::size_t pair = 0; pair < pairs_.size(); ++pair) {
+        const double* left = autoSums_.data() + pairInputs_[pair].first * bins_;
+        const double* right = autoSums_.data() + pairInputs_[pair].second * bins_;
+        const std::complex<double>* cross = crossSums_.data() + pair * bins_;
+        for (std::size_t band = 0; band < bands; ++band) {
+            const auto [first, last] = bandBins_[band];
+            double coherence = 0.0;
+            double leftPower = 0.0;
+            double rightPower = 0.0;
+            for (std::size_t bin = first; bin < last; ++bin) {
+                const double denominator = left[bin] * right[bin];
+                coherence += denominator > 0.0 ? std::norm(cross[bin]) / denominator : 0.0;
+                leftPower += left[bin];
+                rightPower += right[bin];
+            }
+            const std::size_t index = pair * bands + band;
+            coherence_[index] = last > first ? static_cast<float>(coherence / static_cast<double>(last - first)) : 0.0f;
+            asymmetry_[index] = leftPower > 0.0 && rightPower > 0.0
+                                        ? static_cast<float>(std::log(rightPower) - std::log(leftPower))
+                                        : 0.0f;
+        }
+    }
+    if (handler_) {
+        handler_(timepoint, coherence_, asymmetry_);
+    }
+}
+
+} // namespace signal_processing
@@ -0,0 +1,158 @@
+#include <device_discovery.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iostream>
+#include <utility>
+
+namespace device_discovery
+{
+namespace
+{
+std::string TakeString(clCString string) {
+    std::string result = clCString_CStr(string);
+    clCString_Free(string);
+    return result;
+}
+
+std::string ToLower(std::string_view value) {
+    std::string result(value);
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return result;
+}
+
+constexpr std::array<std::pair<std::string_view, clCDeviceType>, 6> kDeviceTypeNames{{
+    {"band", clC_DT_NeiryBand},
+    {"buds", clC_DT_NeiryBuds},
+    {"headphones", clC_DT_NeiryHeadphones},
+    {"impulse", clC_DT_NeiryImpulse},
+    {"any", clC_DT_NeiryAny},
+    {"brainbit2", clC_DT_BrainBit2},
+}};
+} // namespace
+
+const char* DeviceTypeName(clCDeviceType type) {
+    switch (type) {
+    case clC_DT_NeiryBand:
+        return "NeiryBand";
+    case clC_DT_NeiryBuds:
+        return "NeiryBuds";
+    case clC_DT_NeiryHeadphones:
+        return "NeiryHeadphones";
+    case clC_DT_NeiryImpulse:
+        return "NeiryImpulse";
+    case clC_DT_NeiryAny:
+        return "NeiryAny";
+    case clC_DT_BrainBit2:
+        return "BrainBit2";
+    default:
+        return "Other";
+    }
+}
+
+std::optional<clCDeviceType> ParseDeviceType(std::string_view name) {
+    const auto lowered = ToLower(name);
+    for (const auto& [shortName, type] : kDeviceTypeNames) {
+        if (lowered == shortName || lowered == ToLower(DeviceTypeName(type))) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
+
+bool DeviceFilter::Empty() const {
+    return !id.has_value() && !serial.has_value() && !type.has_value();
+}
+
+bool DeviceFilter::Matches(clCDeviceInfo info) const {
+    // found devices report their concrete type, NeiryAny only widens the locator
+    if (type.has_value() && *type != clC_DT_NeiryAny && clCDeviceInfo_GetType(info) != *type) {
+        return false;
+    }
+    const auto deviceID = TakeString(clCDeviceInfo_GetID(info));
+    if (id.has_value() && deviceID != *id) {
+        return false;
+    }
+    if (serial.has_value() && deviceID.find(*serial) == std::string::npos) {
+        const auto deviceName = TakeString(clCDeviceInfo_GetName(info));
+        if (deviceName.find(*serial) == std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::optional<DeviceFilter> ParseDeviceFilter(int argc, char* argv[]) {
+    using namespace std::string_view_literals;
+    DeviceFilter filter;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        const auto pos = arg.find('=');
+        if (pos == arg.npos || pos + 1 == arg.size()) {
+            continue;
+        }
+        const auto flag = arg.substr(0, pos);
+        const auto value = arg.substr(pos + 1);
+        if (flag == "--device"sv) {
+            filter.id.emplace(value);
+        } else if (flag == "--serial"sv) {
+            filter.serial.emplace(value);
+        } else if (flag == "--device-type"sv) {
+            filter.type = ParseDeviceType(value);
+            if (!filter.type.has_value()) {
+                std::cerr << "Unknown device type " << value
+                          << ", expected band, buds, headphones, impulse, brainbit2 or any" << std::endl;
+                return std::nullopt;
+            }
+        }
+    }
+    return filter;
+}
+
+DeviceScan::DeviceScan(DeviceFilter filter, int32_t scanTimeSec)
+        : filter_{std::move(filter)}
+        , scanTimeSec_{scanTimeSec}
+{
+}
+
+clCDeviceType DeviceScan::LocatorType() const {
+    return filter_.type.value_or(clC_DT_NeiryBand);
+}
+
+int32_t DeviceScan::NextWindowSec() {
+    if (Finished()) {
+        return 0;
+    }
+    const int32_t window = EarlySelection() ? std::min(kProbeWindowSec, scanTimeSec_ - requestedSec_)
+                                            : scanTimeSec_ - requestedSec_;
+    requestedSec_ += window;
+    return window;
+}
+
+std::optional<int32_t> DeviceScan::OnDeviceList(clCDeviceInfoList devices, std::ostream& log) {
+    std::optional<int32_t> selected;
+    const int32_t count = clCDeviceInfoList_GetCount(devices);
+    for (int32_t i = 0; i < count; ++i) {
+        const clCDeviceInfo deviceDescriptor = clCDeviceInfoList_GetDeviceInfo(devices, i);
+        if (seenDevices_.insert(TakeString(clCDeviceInfo_GetID(deviceDescriptor))).second) {
+            log << "\t " << TakeString(clCDeviceInfo_GetDescription(deviceDescriptor))
+                << " (found after " << requestedSec_ << " s)" << std::endl;
+        }
+        if (!selected.has_value() && filter_.Matches(deviceDescriptor)) {
+            selected = i;
+        }
+    }
+    return selected;
+}
+
+bool DeviceScan::EarlySelection() const {
+    return !filter_.Empty();
+}
+
+bool DeviceScan::Finished() const {
+    return requestedSec_ >= scanTimeSec_;
+}
+
+} // namespace device_discovery
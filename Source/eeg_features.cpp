@@ -0,0 +1,200 @@
+#include <eeg_features.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+double Variance(double sum, double squares, std::size_t count) {
+    if (count == 0) {
+        return 0.0;
+    }
+    const double mean = sum / static_cast<double>(count);
+    return std::max(squares / static_cast<double>(count) - mean * mean, 0.0);
+}
+
+// Bins [first, last) of a frequency range
+std::pair<std::size_t, std::size_t> BinRange(double low, double high, double binWidth, std::size_t bins) {
+    return {std::min(static_cast<std::size_t>(std::ceil(low / binWidth)), bins),
+            std::min(static_cast<std::size_t>(std::ceil(high / binWidth)), bins)};
+}
+
+double BandPower(std::span<const double> psd, const std::vector<PowerBand>& bands, std::string_view name,
+                 double binWidth) {
+    for (const auto& band : bands) {
+        if (band.name == name) {
+            const auto [first, last] = BinRange(band.low, band.high, binWidth, psd.size());
+            double power = 0.0;
+            for (std::size_t bin = first; bin < last; ++bin) {
+                power += psd[bin];
+            }
+            return power;
+        }
+    }
+    return 0.0;
+}
+
+float Ratio(double numerator, double denominator) {
+    return denominator > 0.0 ? static_cast<float>(numerator / denominator) : 0.0f;
+}
+} // namespace
+
+const char* EegFeatureName(EegFeature feature) {
+    switch (feature) {
+    case kSpectralEntropy:
+        return "spectral_entropy";
+    case kHjorthActivity:
+        return "hjorth_activity";
+    case kHjorthMobility:
+        return "hjorth_mobility";
+    case kHjorthComplexity:
+        return "hjorth_complexity";
+    case kThetaBetaRatio:
+        return "theta_beta";
+    case kAlphaThetaBetaRatio:
+        return "alpha_theta_beta";
+    case kLineLength:
+        return "line_length";
+    default:
+        return "unknown";
+    }
+}
+
+EegFeatureExtractor::EegFeatureExtractor(EegFeatureConfig config, int32_t channels)
+        : config_{std::move(config)}
+        , channels_{std::max(channels, 0)}
+        , states_(static_cast<std::size_t>(channels_))
+        , features_(static_cast<std::size_t>(channels_) * kEegFeaturesCount, 0.0f)
+{
+}
+
+void EegFeatureExtractor::SetFeaturesHandler(FeaturesHandler handler) {
+    handler_ = std::move(handler);
+}
+
+void EegFeatureExtractor::SetBands(std::vector<PowerBand> bands) {
+    config_.bands = std::move(bands);
+}
+
+void EegFeatureExtractor::Push(const SignalBlock& block) {
+    const std::size_t samples = static_cast<std::size_t>(block.SamplesCount());
+    const int32_t channels = std::min(block.ChannelsCount(), channels_);
+    if (samples == 0) {
+        return;
+    }
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        auto& state = states_[channel];
+        const float* values = block.Channel(channel).data();
+        if (!state.offset) {
+            // sums of squares of the raw offset would swamp the variance
+            state.offset = values[0];
+        }
+        const float offset = *state.offset;
+        BlockSums sums;
+        sums.samples = samples;
+        float previous = state.previous;
+        float previousDiff = state.previousDiff;
+        std::size_t seen = state.seen;
+        for (std::size_t i = 0; i < samples; ++i) {
+            const double x = values[i] - offset;
+            sums.x += x;
+            sums.x2 += x * x;
+            if (seen >= 1) {
+                const float diff = values[i] - previous;
+                sums.dx += diff;
+                sums.dx2 += static_cast<double>(diff) * diff;
+                sums.lineLength += std::abs(diff);
+                ++sums.diffs;
+                if (seen >= 2) {
+                    const double secondDiff = diff - previousDiff;
+                    sums.d2x += secondDiff;
+                    sums.d2x2 += secondDiff * secondDiff;
+                    ++sums.secondDiffs;
+                }
+                previousDiff = diff;
+            }
+            previous = values[i];
+            ++seen;
+        }
+        state.previous = previous;
+        state.previousDiff = previousDiff;
+        state.seen = seen;
+
+        auto& window = state.window;
+        window.push_back(sums);
+        std::size_t windowSamples = 0;
+        for (const auto& blockSums : window) {
+            windowSamples += blockSums.samples;
+        }
+        while (window.size() > 1 && windowSamples - window.front().samples >= config_.windowSamples) {
+            windowSamples -= window.front().samples;
+            window.pop_front();
+        }
+    }
+}
+
+void EegFeatureExtractor::OnSpectra(uint64_t timepoint, std::span<const double> psds, double binWidth) {
+    if (channels_ == 0) {
+        return;
+    }
+    const std::size_t bins = psds.size() / static_cast<std::size_t>(channels_);
+    const auto [entropyFirst, entropyLast] = BinRange(config_.entropyLow, config_.entropyHigh, binWidth, bins);
+    const std::size_t entropyBins = entropyLast - entropyFirst;
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        const auto psd = psds.subspan(static_cast<std::size_t>(channel) * bins, bins);
+        float* features = features_.data() + static_cast<std::size_t>(channel) * kEegFeaturesCount;
+
+        // Shannon entropy of the normalized spectrum, 1 for a flat one
+        double total = 0.0;
+        for (std::size_t bin = entropyFirst; bin < entropyLast; ++bin) {
+            total += psd[bin];
+        }
+        double entropy = 0.0;
+        if (total > 0.0 && entropyBins > 1) {
+            for (std::size_t bin = entropyFirst; bin < entropyLast; ++bin) {
+                const double p = psd[bin] / total;
+                entropy -= p > 0.0 ? p * std::log(p) : 0.0;
+            }
+            entropy /= std::log(static_cast<double>(entropyBins));
+        }
+        features[kSpectralEntropy] = static_cast<float>(entropy);
+
+        const double theta = BandPower(psd, config_.bands, "theta", binWidth);
+        const double alpha = BandPower(psd, config_.bands, "alpha", binWidth);
+        const double beta = BandPower(psd, config_.bands, "beta", binWidth);
+        features[kThetaBetaRatio] = Ratio(theta, beta);
+        features[kAlphaThetaBetaRatio] = Ratio(alpha + theta, beta);
+
+        BlockSums window;
+        for (const auto& sums : states_[channel].window) {
+            window.samples += sums.samples;
+            window.diffs += sums.diffs;
+            window.secondDiffs += sums.secondDiffs;
+            window.x += sums.x;
+            window.x2 += sums.x2;
+            window.dx += sums.dx;
+            window.dx2 += sums.dx2;
+            window.d2x += sums.d2x;
+            window.d2x2 += sums.d2x2;
+            window.lineLength += sums.lineLength;
+        }
+        const double activity = Variance(window.x, window.x2, window.samples);
+        const double diffVariance = Variance(window.dx, window.dx2, window.diffs);
+        const double secondDiffVariance = Variance(window.d2x, window.d2x2, window.secondDiffs);
+        const double mobility = activity > 0.0 ? std::sqrt(diffVariance / activity) : 0.0;
+        const double diffMobility = diffVariance > 0.0 ? std::sqrt(secondDiffVariance / diffVariance) : 0.0;
+        features[kHjorthActivity] = static_cast<float>(activity);
+        features[kHjorthMobility] = static_cast<float>(mobility);
+        features[kHjorthComplexity] = mobility > 0.0 ? static_cast<float>(diffMobility / mobility) : 0.0f;
+        features[kLineLength] = static_cast<float>(window.lineLength);
+    }
+    if (handler_) {
+        handler_(timepoint, features_);
+    }
+}
+
+} // namespace signal_processing
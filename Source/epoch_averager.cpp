@@ -0,0 +1,166 @@
+#include <epoch_averager.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace signal_processing
+{
+
+EpochAverager::EpochAverager(EpochConfig config, const SignalHistory& history)
+        : config_{std::move(config)}
+        , history_{history}
+        , conditions_(config_.conditions)
+{
+}
+
+void EpochAverager::SetAverageHandler(AverageHandler handler) {
+    handler_ = std::move(handler);
+}
+
+uint64_t EpochAverager::DroppedCount() const {
+    return dropped_;
+}
+
+void EpochAverager::Mark(std::size_t condition, uint64_t timepoint) {
+    if (condition < conditions_.size()) {
+        pending_.push_back({condition, timepoint});
+    }
+}
+
+bool EpochAverager::Prepare() {
+    if (prepared_) {
+        return true;
+    }
+    if (!history_.Ready()) {
+        return false;
+    }
+    channels_ = history_.ChannelsCount();
+    preSamples_ = history_.SamplesFor(config_.preSec);
+    samples_ = preSamples_ + history_.SamplesFor(config_.postSec);
+    const std::size_t size = static_cast<std::size_t>(channels_) * samples_;
+    for (auto& condition : conditions_) {
+        condition.mean.assign(size, 0.0f);
+        condition.m2.assign(size, 0.0f);
+        condition.variance.assign(size, 0.0f);
+    }
+    epoch_.resize(size);
+    prepared_ = true;
+    return true;
+}
+
+void EpochAverager::Update() {
+    if (!Prepare()) {
+        return;
+    }
+    while (!pending_.empty()) {
+        const auto sample = FindSample(pending_.front().timepoint);
+        if (!sample) {
+            // the marker is newer than the history
+            return;
+        }
+        if (*sample != kTooOld && *sample + (samples_ - preSamples_) > history_.SamplesWritten()) {
+            // markers come in time order, the later ones are not complete either
+            return;
+        }
+        const Marker marker = pending_.front();
+        pending_.pop_front();
+        if (*sample == kTooOld || *sample < preSamples_ || !Cut(marker.condition, *sample - preSamples_)) {
+            ++dropped_;
+            continue;
+        }
+        if (handler_) {
+            handler_(MakeAverage(marker.condition));
+        }
+    }
+}
+
+// Index of the first sample at or after the timepoint, by binary search over
+// the timepoints still in the history. A marker more than a sample period
+// before the oldest retained sample has lost its own sample: kTooOld
+std::optional<uint64_t> EpochAverager::FindSample(uint64_t timepoint) const {
+    const uint64_t written = history_.SamplesWritten();
+    const uint64_t capacity = history_.Capacity();
+    const uint64_t oldest = written > capacity ? written - capacity : 0;
+    uint64_t low = oldest;
+    uint64_t high = written;
+    uint64_t value = 0;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        if (history_.ReadTimepoints(middle, std::span(&value, 1)).count == 0) {
+            // overwritten while searching, the marker is too old anyway
+            return kTooOld;
+        }
+        if (value < timepoint) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == written) {
+        return std::nullopt;
+    }
+    if (low == oldest) {
+        const auto periodUs = static_cast<uint64_t>(std::ceil(1e6 / history_.SampleRate()));
+        if (history_.ReadTimepoints(low, std::span(&value, 1)).count == 0 || value - timepoint > periodUs) {
+            return kTooOld;
+        }
+    }
+    return low;
+}
+
+bool EpochAverager::Cut(std::size_t conditionIndex, uint64_t first) {
+    auto& condition = conditions_[conditionIndex];
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        const auto out = std::span(epoch_).subspan(static_cast<std::size_t>(channel) * samples_, samples_);
+        const auto read = history_.Read(channel, first, out);
+        if (read.first != first || read.count != samples_) {
+            return false;
+        }
+        if (config_.baselineCorrection && preSamples_ > 0) {
+            const auto pre = out.first(preSamples_);
+            const float baseline = std::accumulate(pre.begin(), pre.end(), 0.0f) / static_cast<float>(preSamples_);
+            for (float& value : out) {
+                value -= baseline;
+            }
+        }
+    }
+
+    ++condition.epochs;
+    const auto weight = 1.0f / static_cast<float>(condition.epochs);
+    const auto varianceScale = condition.epochs > 1 ? 1.0f / static_cast<float>(condition.epochs - 1) : 0.0f;
+    float* mean = condition.mean.data();
+    float* m2 = condition.m2.data();
+    float* variance = condition.variance.data();
+    for (std::size_t i = 0; i < epoch_.size(); ++i) {
+        const float delta = epoch_[i] - mean[i];
+        mean[i] += delta * weight;
+        m2[i] += delta * (epoch_[i] - mean[i]);
+        variance[i] = m2[i] * varianceScale;
+    }
+    return true;
+}
+
+ErpAverage EpochAverager::MakeAverage(std::size_t condition) const {
+    const auto& state = conditions_[condition];
+    ErpAverage average;
+    average.condition = condition;
+    average.epochs = state.epochs;
+    average.channels = channels_;
+    average.samples = samples_;
+    average.preSamples = preSamples_;
+    average.sampleRate = history_.SampleRate();
+    average.mean = state.mean;
+    average.variance = state.variance;
+    return average;
+}
+
+std::optional<ErpAverage> EpochAverager::Average(std::size_t condition) const {
+    if (!prepared_ || condition >= conditions_.size()) {
+        return std::nullopt;
+    }
+    return MakeAverage(condition);
+}
+
+} // namespace signal_processing
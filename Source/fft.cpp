@@ -0,0 +1,80 @@
+#include <fft.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+namespace signal_processing
+{
+
+FftPlan::FftPlan(std::size_t size)
+        : size_{std::bit_ceil(std::max<std::size_t>(size, 2))}
+        , bitReversed_(size_)
+        , twiddles_(size_ / 2)
+        , scratch_(size_)
+{
+    const int bits = std::countr_zero(size_);
+    for (std::size_t i = 0; i < size_; ++i) {
+        std::size_t reversed = 0;
+        for (int bit = 0; bit < bits; ++bit) {
+            reversed |= ((i >> bit) & 1U) << (bits - 1 - bit);
+        }
+        bitReversed_[i] = reversed;
+    }
+    for (std::size_t i = 0; i < size_ / 2; ++i) {
+        const double angle = -2.0 * std::numbers::pi * static_cast<double>(i) / static_cast<double>(size_);
+        twiddles_[i] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+    }
+}
+
+std::size_t FftPlan::Size() const {
+    return size_;
+}
+
+std::size_t FftPlan::BinsCount() const {
+    return size_ / 2 + 1;
+}
+
+void FftPlan::Forward(std::span<const float> input, std::span<std::complex<float>> output) {
+    for (std::size_t i = 0; i < size_; ++i) {
+        scratch_[bitReversed_[i]] = {i < input.size() ? input[i] : 0.0f, 0.0f};
+    }
+    // iterative Cooley-Tukey butterflies
+    std::complex<float>* data = scratch_.data();
+    const std::complex<float>* twiddles = twiddles_.data();
+    for (std::size_t length = 2; length <= size_; length <<= 1) {
+        const std::size_t half = length / 2;
+        const std::size_t twiddleStep = size_ / length;
+        for (std::size_t start = 0; start < size_; start += length) {
+            std::complex<float>* even = data + start;
+            std::complex<float>* odd = even + half;
+            for (std::size_t k = 0; k < half; ++k) {
+                // written out: operator* checks for infinities and is several times slower
+                const float twiddleRe = twiddles[k * twiddleStep].real();
+                const float twiddleIm = twiddles[k * twiddleStep].imag();
+                const float oddRe = twiddleRe * odd[k].real() - twiddleIm * odd[k].imag();
+                const float oddIm = twiddleRe * odd[k].imag() + twiddleIm * odd[k].real();
+                const float evenRe = even[k].real();
+                const float evenIm = even[k].imag();
+                even[k] = {evenRe + oddRe, evenIm + oddIm};
+                odd[k] = {evenRe - oddRe, evenIm - oddIm};
+            }
+        }
+    }
+    const std::size_t bins = std::min(output.size(), BinsCount());
+    for (std::size_t i = 0; i < bins; ++i) {
+        output[i] = scratch_[i];
+    }
+}
+
+std::vector<float> HannWindow(std::size_t size) {
+    std::vector<float> window(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        const double phase = 2.0 * std::numbers::pi * static_cast<double>(i) / static_cast<double>(size);
+        window[i] = static_cast<float>(0.5 - 0.5 * std::cos(phase));
+    }
+    return window;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,192 @@
+#include <head_motion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// the filter converges from the initial orientation before events are reported
+constexpr uint64_t kSettleUs = 2'000'000;
+// longer steps come from gaps and would throw the integration off
+constexpr float kMaxStepSec = 0.1f;
+constexpr float kRadToDeg = static_cast<float>(180.0 / std::numbers::pi);
+// weight of the acceleration deviation in the energy, per g squared
+constexpr float kAccelerationWeight = 4.0f;
+
+float AngleDistance(const HeadPose& a, const HeadPose& b) {
+    return std::max(std::abs(a.pitch - b.pitch), std::abs(a.roll - b.roll));
+}
+} // namespace
+
+HeadMotionEngine::HeadMotionEngine(HeadMotionConfig config)
+        : config_{std::move(config)}
+{
+}
+
+void HeadMotionEngine::SetEventHandler(EventHandler handler) {
+    handler_ = std::move(handler);
+}
+
+const HeadPose& HeadMotionEngine::Pose() const {
+    return pose_;
+}
+
+bool HeadMotionEngine::IsMoving() const {
+    return pose_.motionEnergy > config_.movingEnergy;
+}
+
+void HeadMotionEngine::Push(const SignalBlock& block) {
+    if (block.ChannelsCount() < kMEMSChannelsCount) {
+        return;
+    }
+    const auto timepoints = block.Timepoints();
+    const float* accX = block.Channel(kAccelerometerX).data();
+    const float* accY = block.Channel(kAccelerometerY).data();
+    const float* accZ = block.Channel(kAccelerometerZ).data();
+    const float* gyroX = block.Channel(kGyroscopeX).data();
+    const float* gyroY = block.Channel(kGyroscopeY).data();
+    const float* gyroZ = block.Channel(kGyroscopeZ).data();
+    for (std::size_t i = 0; i < timepoints.size(); ++i) {
+        const uint64_t timepoint = timepoints[i];
+        if (lastTimepoint_ && timepoint <= *lastTimepoint_) {
+            continue;
+        }
+        const float dt = lastTimepoint_ ? std::min(static_cast<float>(timepoint - *lastTimepoint_) / 1e6f, kMaxStepSec)
+                                        : 0.0f;
+        lastTimepoint_ = timepoint;
+        if (!settledAt_) {
+            settledAt_ = timepoint + kSettleUs;
+        }
+
+        const float gx = gyroX[i] * config_.gyroscopeScale;
+        const float gy = gyroY[i] * config_.gyroscopeScale;
+        const float gz = gyroZ[i] * config_.gyroscopeScale;
+        UpdateOrientation(accX[i], accY[i], accZ[i], gx, gy, gz, dt);
+
+        // rotation power in (rad/s)^2 and deviation of |a| from gravity in g^2
+        const float magnitude = std::sqrt(accX[i] * accX[i] + accY[i] * accY[i] + accZ[i] * accZ[i]);
+        gravity_ = gravity_ ? *gravity_ + 0.001f * (magnitude - *gravity_) : magnitude;
+        const float deviation = *gravity_ > 0.0f ? magnitude / *gravity_ - 1.0f : 0.0f;
+        const float alpha = dt > 0.0f ? 1.0f - std::exp(-dt / config_.motionTimeConstantSec) : 1.0f;
+        rotationEnergy_ += alpha * (gx * gx + gy * gy + gz * gz - rotationEnergy_);
+        accelerationEnergy_ += alpha * (kAccelerationWeight * deviation * deviation - accelerationEnergy_);
+
+        pose_.timepoint = timepoint;
+        pose_.motionEnergy = rotationEnergy_ + accelerationEnergy_;
+        UpdateEvents();
+    }
+}
+
+// Madgwick's IMU update: gyroscope integration corrected by a gradient
+// descent step towards the gravity direction measured by the accelerometer
+void HeadMotionEngine::UpdateOrientation(float ax, float ay, float az, float gx, float gy, float gz, float dt) {
+    float q0 = pose_.w;
+    float q1 = pose_.x;
+    float q2 = pose_.y;
+    float q3 = pose_.z;
+
+    float qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+    float qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+    float qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+    float qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+    const float norm = std::sqrt(ax * ax + ay * ay + az * az);
+    if (norm > 0.0f) {
+        ax /= norm;
+        ay /= norm;
+        az /= norm;
+        const float _2q0 = 2.0f * q0;
+        const float _2q1 = 2.0f * q1;
+        const float _2q2 = 2.0f * q2;
+        const float _2q3 = 2.0f * q3;
+        const float _4q0 = 4.0f * q0;
+        const float _4q1 = 4.0f * q1;
+        const float _4q2 = 4.0f * q2;
+        const float _8q1 = 8.0f * q1;
+        const float _8q2 = 8.0f * q2;
+        const float q0q0 = q0 * q0;
+        const float q1q1 = q1 * q1;
+        const float q2q2 = q2 * q2;
+        const float q3q3 = q3 * q3;
+
+        float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+        float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+        float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+        float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+        const float stepNorm = std::sqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3);
+        if (stepNorm > 0.0f) {
+            s0 /= stepNorm;
+            s1 /= stepNorm;
+            s2 /= stepNorm;
+            s3 /= stepNorm;
+        }
+        // before the first time step the accelerometer alone sets the orientation
+        const float beta = dt > 0.0f ? config_.beta : 1.0f / std::max(kMaxStepSec, 1e-3f);
+        const float step = dt > 0.0f ? dt : kMaxStepSec;
+        qDot1 -= beta * s0;
+        qDot2 -= beta * s1;
+        qDot3 -= beta * s2;
+        qDot4 -= beta * s3;
+        q0 += qDot1 * step;
+        q1 += qDot2 * step;
+        q2 += qDot3 * step;
+        q3 += qDot4 * step;
+    } else {
+        q0 += qDot1 * dt;
+        q1 += qDot2 * dt;
+        q2 += qDot3 * dt;
+        q3 += qDot4 * dt;
+    }
+
+    const float quaternionNorm = std::sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    pose_.w = q0 / quaternionNorm;
+    pose_.x = q1 / quaternionNorm;
+    pose_.y = q2 / quaternionNorm;
+    pose_.z = q3 / quaternionNorm;
+
+    const float w = pose_.w;
+    const float x = pose_.x;
+    const float y = pose_.y;
+    const float z = pose_.z;
+    pose_.roll = std::atan2(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * kRadToDeg;
+    pose_.pitch = std::asin(std::clamp(2.0f * (w * y - z * x), -1.0f, 1.0f)) * kRadToDeg;
+    pose_.yaw = std::atan2(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * kRadToDeg;
+}
+
+void HeadMotionEngine::UpdateEvents() {
+    if (pose_.timepoint < *settledAt_) {
+        return;
+    }
+    if (!posture_) {
+        posture_ = pose_;
+        return;
+    }
+    const float distance = AngleDistance(pose_, *posture_);
+    if (!excursionStart_) {
+        if (distance > config_.nodDeg) {
+            excursionStart_ = pose_.timepoint;
+        }
+        return;
+    }
+    const auto excursionSec = static_cast<float>(pose_.timepoint - *excursionStart_) / 1e6f;
+    if (distance < config_.nodDeg / 2.0f) {
+        excursionStart_.reset();
+        if (excursionSec <= config_.nodMaxSec && handler_) {
+            handler_(HeadEvent::Nod, pose_);
+        }
+        return;
+    }
+    if (excursionSec >= config_.postureHoldSec && distance > config_.postureDeg && !IsMoving()) {
+        excursionStart_.reset();
+        posture_ = pose_;
+        if (handler_) {
+            handler_(HeadEvent::PostureChange, pose_);
+        }
+    }
+}
+
+} // namespace signal_processing
@@ -0,0 +1,276 @@
+#include <iir_filter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAPSULE_FILTER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace signal_processing
+{
+namespace
+{
+// sections whose state is kept in registers during one pass over the block
+constexpr std::size_t kSectionsPerPass = 8;
+
+struct ScalarLanes {
+    using Type = float;
+    static constexpr std::size_t kWidth = 1;
+    static Type Load(const float* p) { return *p; }
+    static void Store(float* p, Type v) { *p = v; }
+    static Type Set(float v) { return v; }
+    static Type Mul(Type a, Type b) { return a * b; }
+    static Type Add(Type a, Type b) { return a + b; }
+    static Type Sub(Type a, Type b) { return a - b; }
+};
+
+#if defined(__AVX2__)
+struct SimdLanes {
+    using Type = __m256;
+    static constexpr std::size_t kWidth = 8;
+    static constexpr const char* kName = "AVX2";
+    static Type Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, Type v) { _mm256_storeu_ps(p, v); }
+    static Type Set(float v) { return _mm256_set1_ps(v); }
+    static Type Mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+    static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+    static Type Sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+};
+#elif defined(CAPSULE_FILTER_SSE2)
+// always available on x64, the default when AVX2 is not enabled
+struct SimdLanes {
+    using Type = __m128;
+    static constexpr std::size_t kWidth = 4;
+    static constexpr const char* kName = "SSE2";
+    static Type Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, Type v) { _mm_storeu_ps(p, v); }
+    static Type Set(float v) { return _mm_set1_ps(v); }
+    static Type Mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+    static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+    static Type Sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+};
+#elif defined(__ARM_NEON)
+struct SimdLanes {
+    using Type = float32x4_t;
+    static constexpr std::size_t kWidth = 4;
+    static constexpr const char* kName = "NEON";
+    static Type Load(const float* p) { return vld1q_f32(p); }
+    static void Store(float* p, Type v) { vst1q_f32(p, v); }
+    static Type Set(float v) { return vdupq_n_f32(v); }
+    // vmulq + vaddq rather than vmlaq, which fuses on AArch64
+    static Type Mul(Type a, Type b) { return vmulq_f32(a, b); }
+    static Type Add(Type a, Type b) { return vaddq_f32(a, b); }
+    static Type Sub(Type a, Type b) { return vsubq_f32(a, b); }
+};
+#else
+struct SimdLanes : ScalarLanes {
+    static constexpr const char* kName = "scalar";
+};
+#endif
+
+// y = b0 x + z1, z1 = b1 x - a1 y + z2, z2 = b2 x - a2 y
+// written out the same way for every lane type
+template<typename Lanes>
+void RunSections(const BiquadCoefficients* sections, std::size_t sectionsCount, float* state,
+                 std::size_t stride, float* data, std::size_t samples, std::size_t lane) {
+    using V = typename Lanes::Type;
+    V b0[kSectionsPerPass], b1[kSectionsPerPass], b2[kSectionsPerPass], a1[kSectionsPerPass], a2[kSectionsPerPass];
+    V z1[kSectionsPerPass], z2[kSectionsPerPass];
+    for (std::size_t k = 0; k < sectionsCount; ++k) {
+        b0[k] = Lanes::Set(sections[k].b0);
+        b1[k] = Lanes::Set(sections[k].b1);
+        b2[k] = Lanes::Set(sections[k].b2);
+        a1[k] = Lanes::Set(sections[k].a1);
+        a2[k] = Lanes::Set(sections[k].a2);
+        z1[k] = Lanes::Load(state + (2 * k) * stride + lane);
+        z2[k] = Lanes::Load(state + (2 * k + 1) * stride + lane);
+    }
+    for (std::size_t sample = 0; sample < samples; ++sample) {
+        float* values = data + sample * stride + lane;
+        V x = Lanes::Load(values);
+        for (std::size_t k = 0; k < sectionsCount; ++k) {
+            const V y = Lanes::Add(Lanes::Mul(b0[k], x), z1[k]);
+            z1[k] = Lanes::Add(Lanes::Sub(Lanes::Mul(b1[k], x), Lanes::Mul(a1[k], y)), z2[k]);
+            z2[k] = Lanes::Sub(Lanes::Mul(b2[k], x), Lanes::Mul(a2[k], y));
+            x = y;
+        }
+        Lanes::Store(values, x);
+    }
+    for (std::size_t k = 0; k < sectionsCount; ++k) {
+        Lanes::Store(state + (2 * k) * stride + lane, z1[k]);
+        Lanes::Store(state + (2 * k + 1) * stride + lane, z2[k]);
+    }
+}
+
+std::size_t PaddedChannels(int32_t channels) {
+    const std::size_t width = SimdLanes::kWidth;
+    return (static_cast<std::size_t>(std::max(channels, 0)) + width - 1) / width * width;
+}
+
+void Interleave(const SignalBlock& block, std::vector<float>& data, std::size_t stride) {
+    const auto samples = static_cast<std::size_t>(block.SamplesCount());
+    const int32_t channels = std::min(block.ChannelsCount(), static_cast<int32_t>(stride));
+    data.assign(samples * stride, 0.0f);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto values = block.Channel(channel);
+        for (std::size_t sample = 0; sample < samples; ++sample) {
+            data[sample * stride + channel] = values[sample];
+        }
+    }
+}
+
+SignalBlock Deinterleave(const std::vector<float>& data, std::size_t stride, const SignalBlock& like) {
+    SignalBlock block = SignalBlock::Allocate(like.ChannelsCount(), like.SamplesCount());
+    std::copy(like.Timepoints().begin(), like.Timepoints().end(), block.Timepoints().begin());
+    const auto samples = static_cast<std::size_t>(like.SamplesCount());
+    const int32_t channels = std::min(like.ChannelsCount(), static_cast<int32_t>(stride));
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto values = block.Channel(channel);
+        for (std::size_t sample = 0; sample < samples; ++sample) {
+            values[sample] = data[sample * stride + channel];
+        }
+    }
+    return block;
+}
+
+BiquadCoefficients Normalize(double b0, double b1, double b2, double a0, double a1, double a2) {
+    return {static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+            static_cast<float>(a1 / a0), static_cast<float>(a2 / a0)};
+}
+} // namespace
+
+BiquadCoefficients NotchCoefficients(double frequency, double sampleRate, double q) {
+    const double w0 = 2.0 * std::numbers::pi * frequency / sampleRate;
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double cosW0 = std::cos(w0);
+    return Normalize(1.0, -2.0 * cosW0, 1.0, 1.0 + alpha, -2.0 * cosW0, 1.0 - alpha);
+}
+
+BiquadCoefficients HighPassCoefficients(double cutoff, double sampleRate, double q) {
+    const double w0 = 2.0 * std::numbers::pi * cutoff / sampleRate;
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double cosW0 = std::cos(w0);
+    return Normalize((1.0 + cosW0) / 2.0, -(1.0 + cosW0), (1.0 + cosW0) / 2.0,
+                     1.0 + alpha, -2.0 * cosW0, 1.0 - alpha);
+}
+
+BiquadCoefficients LowPassCoefficients(double cutoff, double sampleRate, double q) {
+    const double w0 = 2.0 * std::numbers::pi * cutoff / sampleRate;
+    const double alpha = std::sin(w0) / (2.0 * q);
+    const double cosW0 = std::cos(w0);
+    return Normalize((1.0 - cosW0) / 2.0, 1.0 - cosW0, (1.0 - cosW0) / 2.0,
+                     1.0 + alpha, -2.0 * cosW0, 1.0 - alpha);
+}
+
+const char* FilterInstructionSet() {
+    return SimdLanes::kName;
+}
+
+BiquadCascade::BiquadCascade(std::vector<BiquadCoefficients> sections, int32_t channels)
+        : sections_{std::move(sections)}
+        , channels_{channels}
+        , stride_{PaddedChannels(channels)}
+        , state_(2 * sections_.size() * stride_, 0.0f)
+{
+}
+
+int32_t BiquadCascade::ChannelsCount() const {
+    return channels_;
+}
+
+std::size_t BiquadCascade::Stride() const {
+    return stride_;
+}
+
+void BiquadCascade::ProcessInterleaved(float* data, std::size_t samples) {
+    // every pass runs up to kSectionsPerPass sections over the whole block,
+    // each section still sees the samples in order
+    for (std::size_t first = 0; first < sections_.size(); first += kSectionsPerPass) {
+        const std::size_t count = std::min(kSectionsPerPass, sections_.size() - first);
+        float* state = state_.data() + 2 * first * stride_;
+        for (std::size_t lane = 0; lane < stride_; lane += SimdLanes::kWidth) {
+            RunSections<SimdLanes>(sections_.data() + first, count, state, stride_, data, samples, lane);
+        }
+    }
+}
+
+void BiquadCascade::Process(SignalBlock& block) {
+    Interleave(block, scratch_, stride_);
+    const auto samples = static_cast<std::size_t>(block.SamplesCount());
+    ProcessInterleaved(scratch_.data(), samples);
+    for (int32_t channel = 0; channel < std::min(block.ChannelsCount(), channels_); ++channel) {
+        const auto values = block.Channel(channel);
+        for (std::size_t sample = 0; sample < samples; ++sample) {
+            values[sample] = scratch_[sample * stride_ + channel];
+        }
+    }
+}
+
+void BiquadCascade::Reset() {
+    std::fill(state_.begin(), state_.end(), 0.0f);
+}
+
+void FilterReference(std::span<const BiquadCoefficients> sections, std::span<float> values,
+                     std::span<float> state) {
+    for (float& value : values) {
+        float x = value;
+        for (std::size_t k = 0; k < sections.size(); ++k) {
+            const auto& c = sections[k];
+            float& z1 = state[2 * k];
+            float& z2 = state[2 * k + 1];
+            const float y = c.b0 * x + z1;
+            z1 = c.b1 * x - c.a1 * y + z2;
+            z2 = c.b2 * x - c.a2 * y;
+            x = y;
+        }
+        value = x;
+    }
+}
+
+FilterBank::FilterBank(FilterBankConfig config, int32_t channels)
+        : config_{std::move(config)}
+        , channels_{channels}
+{
+    std::vector<BiquadCoefficients> cleaning;
+    if (config_.notchFrequency.has_value()) {
+        cleaning.push_back(NotchCoefficients(*config_.notchFrequency, config_.sampleRate, config_.notchQ));
+    }
+    if (config_.highPassCutoff.has_value()) {
+        cleaning.push_back(HighPassCoefficients(*config_.highPassCutoff, config_.sampleRate, kButterworthQ));
+    }
+    cleaning_ = BiquadCascade(std::move(cleaning), channels_);
+    for (const auto& band : config_.bands) {
+        bands_.emplace_back(std::vector<BiquadCoefficients>{
+                HighPassCoefficients(band.low, config_.sampleRate, kButterworthQ),
+                LowPassCoefficients(band.high, config_.sampleRate, kButterworthQ)}, channels_);
+    }
+    output_.bands.resize(bands_.size());
+}
+
+const FilterBankConfig& FilterBank::Config() const {
+    return config_;
+}
+
+const FilterBank::Output& FilterBank::Process(const SignalBlock& raw) {
+    const std::size_t stride = cleaning_.Stride();
+    const auto samples = static_cast<std::size_t>(raw.SamplesCount());
+    Interleave(raw, cleaned_, stride);
+    cleaning_.ProcessInterleaved(cleaned_.data(), samples);
+    output_.cleaned = Deinterleave(cleaned_, stride, raw);
+    for (std::size_t band = 0; band < bands_.size(); ++band) {
+        band_ = cleaned_;
+        bands_[band].ProcessInterleaved(band_.data(), samples);
+        output_.bands[band] = Deinterleave(band_, stride, raw);
+    }
+    return output_;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,158 @@
+#include <line_noise.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace signal_processing
+{
+namespace
+{
+FilterBankConfig HighPassConfig(double sampleRate) {
+    FilterBankConfig config;
+    config.sampleRate = sampleRate;
+    config.highPassCutoff = 1.0;
+    return config;
+}
+
+// a sine of amplitude A gives |sum| = A * N / 2, its power is A^2 / 2
+double PowerRatio(double count, double inPhase, double quadrature, double sum, double squares) {
+    const double linePower = 2.0 * (inPhase * inPhase + quadrature * quadrature) / (count * count);
+    const double mean = sum / count;
+    const double variance = squares / count - mean * mean;
+    return variance > 0.0 ? std::min(linePower / variance, 1.0) : 0.0;
+}
+} // namespace
+
+LineNoiseMeter::LineNoiseMeter(double lineFrequency, double sampleRate, std::size_t windowSamples,
+                               std::size_t sampleWindowSamples, int32_t channels)
+        : windowSamples_{std::max<std::size_t>(windowSamples, 1)}
+        , sampleWindowSamples_{std::max<std::size_t>(sampleWindowSamples, 1)}
+        , highPass_{HighPassConfig(sampleRate), channels}
+        , offsets_(static_cast<std::size_t>(channels))
+        , windows_(static_cast<std::size_t>(channels))
+        , ratios_(static_cast<std::size_t>(channels))
+        , sliding_(static_cast<std::size_t>(channels))
+        , sampleRatios_(static_cast<std::size_t>(channels))
+{
+    for (auto& sliding : sliding_) {
+        sliding.terms.resize(sampleWindowSamples_);
+    }
+    if (lineFrequency > 0.0 && lineFrequency * 2.0 < sampleRate) {
+        step_ = 2.0 * std::numbers::pi * lineFrequency / sampleRate;
+    }
+}
+
+std::optional<double> LineNoiseMeter::Ratio(int32_t channel) const {
+    return ratios_[channel];
+}
+
+std::span<const float> LineNoiseMeter::SampleRatios(int32_t channel) const {
+    return sampleRatios_[channel];
+}
+
+const SignalBlock& LineNoiseMeter::HighPassed() const {
+    return highPassed_;
+}
+
+void LineNoiseMeter::Push(const SignalBlock& block) {
+    const std::size_t samples = static_cast<std::size_t>(block.SamplesCount());
+    const int32_t channels = std::min(block.ChannelsCount(), static_cast<int32_t>(windows_.size()));
+    if (samples == 0) {
+        return;
+    }
+
+    SignalBlock shifted = SignalBlock::Allocate(channels, block.SamplesCount());
+    std::copy(block.Timepoints().begin(), block.Timepoints().end(), shifted.Timepoints().begin());
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto values = block.Channel(channel);
+        if (!offsets_[channel]) {
+            offsets_[channel] = values[0];
+        }
+        const float offset = *offsets_[channel];
+        std::transform(values.begin(), values.end(), shifted.Channel(channel).begin(),
+                       [offset](float value) { return value - offset; });
+    }
+    highPassed_ = highPass_.Process(shifted).cleaned;
+    if (step_ == 0.0) {
+        return;
+    }
+
+    cos_.resize(samples);
+    sin_.resize(samples);
+    for (std::size_t i = 0; i < samples; ++i) {
+        const double phase = phase_ + step_ * static_cast<double>(i);
+        cos_[i] = static_cast<float>(std::cos(phase));
+        sin_[i] = static_cast<float>(std::sin(phase));
+    }
+    phase_ = std::fmod(phase_ + step_ * static_cast<double>(samples), 2.0 * std::numbers::pi);
+
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const float* values = highPassed_.Channel(channel).data();
+        float inPhase = 0.0f;
+        float quadrature = 0.0f;
+        float sum = 0.0f;
+        float squares = 0.0f;
+        for (std::size_t i = 0; i < samples; ++i) {
+            inPhase += values[i] * cos_[i];
+            quadrature += values[i] * sin_[i];
+            sum += values[i];
+            squares += values[i] * values[i];
+        }
+        auto& window = windows_[channel];
+        window.push_back({samples, inPhase, quadrature, sum, squares});
+
+        auto& sliding = sliding_[channel];
+        auto& sampleRatios = sampleRatios_[channel];
+        sampleRatios.resize(samples);
+        const auto slidingCount = static_cast<double>(sampleWindowSamples_);
+        for (std::size_t i = 0; i < samples; ++i) {
+            const SampleTerms terms{values[i] * cos_[i], values[i] * sin_[i], values[i], values[i] * values[i]};
+            SampleTerms& oldest = sliding.terms[sliding.next];
+            if (sliding.filled == sampleWindowSamples_) {
+                sliding.inPhase -= oldest.inPhase;
+                sliding.quadrature -= oldest.quadrature;
+                sliding.sum -= oldest.value;
+                sliding.squares -= oldest.square;
+            } else {
+                ++sliding.filled;
+            }
+            sliding.inPhase += terms.inPhase;
+            sliding.quadrature += terms.quadrature;
+            sliding.sum += terms.value;
+            sliding.squares += terms.square;
+            oldest = terms;
+            sliding.next = (sliding.next + 1) % sampleWindowSamples_;
+            sampleRatios[i] = sliding.filled < sampleWindowSamples_
+                                      ? 0.0f
+                                      : static_cast<float>(PowerRatio(slidingCount, sliding.inPhase, sliding.quadrature,
+                                                                      sliding.sum, sliding.squares));
+        }
+
+        BlockSums total;
+        for (const auto& sums : window) {
+            total.samples += sums.samples;
+            total.inPhase += sums.inPhase;
+            total.quadrature += sums.quadrature;
+            total.sum += sums.sum;
+            total.squares += sums.squares;
+        }
+        while (window.size() > 1 && total.samples - window.front().samples >= windowSamples_) {
+            total.samples -= window.front().samples;
+            total.inPhase -= window.front().inPhase;
+            total.quadrature -= window.front().quadrature;
+            total.sum -= window.front().sum;
+            total.squares -= window.front().squares;
+            window.pop_front();
+        }
+        if (total.samples < windowSamples_) {
+            ratios_[channel].reset();
+            continue;
+        }
+
+        ratios_[channel] = PowerRatio(static_cast<double>(total.samples), total.inPhase, total.quadrature, total.sum,
+                                      total.squares);
+    }
+}
+
+} // namespace signal_processing
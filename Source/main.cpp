@@ -1,16 +1,80 @@
+#include <array>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
 #include <format>
 #include <future>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <thread>
 
 #include "ExampleUtils.hpp"
 
 #include "CClientAPI.h"
+#include <alpha_peak_tracker.hpp>
+#include <artifact_detector.hpp>
+#include <async_logger.hpp>
+#include <band_power.hpp>
+#include <calibration_cache.hpp>
 #include <client.hpp>
+#include <device_discovery.hpp>
+#include <eeg_features.hpp>
+#include <epoch_averager.hpp>
+#include <head_motion.hpp>
+#include <pipeline_config.hpp>
+#include <signal_block.hpp>
+#include <signal_history.hpp>
+#include <signal_quality.hpp>
+#include <startup_timeline.hpp>
+#include <stream_monitor.hpp>
+#include <time_series_store.hpp>
+#include <trend_forecaster.hpp>
+#include <windowed_quantiles.hpp>
 
 using namespace std::chrono_literals;
 
+// Records of the data callbacks go through the asynchronous logger, so that
+// the ClientLoop thread never waits for the console. Chatty sources are
+// limited to a few records a second.
+const logging::Category kQualityLog{"quality"};
+const logging::Category kSpectrumLog{"spectrum"};
+const logging::Category kFeaturesLog{"features"};
+const logging::Category kErpLog{"erp"};
+const logging::Category kNfbLog{"nfb", 20};
+const logging::Category kProductivityLog{"productivity", 20};
+const logging::Category kCardioLog{"cardio", 20};
+const logging::Category kHeadLog{"head", 10};
+const logging::Category kEmotionsLog{"emotions", 20};
+const logging::Category kStatesLog{"states", 20};
+const logging::Category kCalibrationLog{"calibration"};
+const logging::Category kForecastLog{"forecast"};
+
+// Classifiers, device modes and sinks of this run, --pipeline=<path> replaces the defaults
+pipeline::PipelineConfig pipelineConfig = pipeline::DefaultPipeline();
+
+bool logged(pipeline::Classifier source) {
+    return pipelineConfig.Routes(source, pipeline::kSinkLog);
+}
+
+// Classifier values of every session, kept for charts over days in
+// metrics.tsdb or --metrics=<path>
+std::string metricsStorePath = "metrics.tsdb";
+std::unique_ptr<time_series::Store> metricsStore;
+constexpr int64_t kMetricsReportMinutes = 10;
+
+void storeMetric(pipeline::Classifier source, const char* name, float value) {
+    if (!metricsStore || !pipelineConfig.Routes(source, pipeline::kSinkStore)) {
+        return;
+    }
+    // wall clock, so that sessions of different days line up
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+    metricsStore->Append(name, now.count(), value);
+}
+
 // objects for establishing a connection with the device and capsule
 clCClient client = nullptr;
 clCSession session = nullptr;
@@ -26,6 +90,9 @@ clCNFBMetricProductivity productivity = nullptr;
 clCCardio cardio = nullptr;
 // object for processing the user's MEMS
 clCMEMS mems = nullptr;
+// objects for estimating emotions and physiological states, off by default
+clCEmotions emotions = nullptr;
+clCPhysiologicalStates physiologicalStates = nullptr;
 
 uint32_t s_time = 0;
 uint32_t deviceConnectionTime = 0;
@@ -36,18 +103,387 @@ bool clientDisconnecting = false;
 // License key
 std::string licenseKey;
 
+// Device search: with --device, --serial or --device-type the first matching device
+// is connected to as soon as it is found, otherwise the first one after the whole window
+constexpr int32_t kDeviceSearchTimeSec = 15;
+device_discovery::DeviceScan deviceScan({}, kDeviceSearchTimeSec);
+
 
 std::shared_ptr<socket_communication::Client> socketClient;
 
+// timestamps of lifecycle events to find out which startup phase is slow
+instrumentation::StartupTimeline startupTimeline;
+const std::string kStartupHistoryPath = "startup_history.csv";
+// set from the input thread, the report is written by the client loop
+std::atomic<bool> startupReportRequested = false;
+
+void reportStartup(bool sessionEnded) {
+    // session stop and disconnect both end the run, report it once
+    static bool finalReportWritten = false;
+    if (sessionEnded) {
+        if (finalReportWritten) {
+            return;
+        }
+        finalReportWritten = true;
+    }
+    startupTimeline.Report(std::cout);
+    if (sessionEnded && startupTimeline.AppendToHistory(kStartupHistoryPath)) {
+        instrumentation::ReportStartupHistory(kStartupHistoryPath, std::cout);
+    }
+}
+
+// Calibrations of returning users. With --user=<name> the individual NFB data
+// of the user on the selected device is kept between runs; a cached
+// calibration younger than --calibration-max-age=<days> is applied to the
+// local processing as soon as the session starts.
+const std::string kCalibrationCachePath = "calibration_cache.csv";
+std::unique_ptr<calibration::CalibrationCache> calibrationCache;
+calibration::CachePolicy calibrationPolicy;
+std::string calibrationUser;
+std::string selectedDeviceID;
+// applied from the cache, until the live alpha peak confirms or rejects it
+std::optional<calibration::CalibrationRecord> cachedCalibration;
+// the eyes-closed calibration is run when the calibrator is ready
+bool calibrationRequested = true;
+
+int64_t unixSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
+}
+
+bool calibrationCached() {
+    return calibrationCache && !calibrationUser.empty() && !selectedDeviceID.empty();
+}
+
+void calibrateIndividualNFB(clCNFBCalibrator calibrator) {
+    std::cout << "Calibrator is ready to calibrate NFB\n"
+              << "Close your eyes for 30 seconds" << std::endl;
+    clCError error = clC_Error_OK;
+    clCNFBCalibrator_CalibrateIndividualNFBQuick(calibrator, &error);
+}
+
+
+// Local band powers of the session EEG, updated much more often than the NFB
+// feedback and compared with it. Bands follow the calibration once it is done.
+constexpr double kBandPowerWindowSec = 2.0;
+constexpr double kBandPowerUpdateHz = 10.0;
+signal_processing::StreamMonitor eegMonitor("EEG");
+std::unique_ptr<signal_processing::BandPowerEngine> bandPowers;
+std::optional<std::vector<signal_processing::PowerBand>> individualBands;
+// band power averaged over channels, in the order of the engine bands
+std::vector<float> channelMeanBandPowers;
+
+// Head orientation from every MEMS sample, its motion state feeds the artifact detector
+signal_processing::HeadMotionEngine headMotion;
+constexpr uint64_t kHeadPosePrintPeriodUs = 1'000'000;
+uint64_t headPosePrintedAt = 0;
+
+// Local artifact marks of the session EEG, created together with the band
+// powers. Spectra whose window overlaps an artifact are left out of the alpha
+// peak tracking.
+std::unique_ptr<signal_processing::ArtifactDetector> artifactDetector;
+std::optional<uint64_t> lastArtifactTimepoint;
+uint64_t artifactIntervals = 0;
+uint64_t artifactDurationUs = 0;
+
+void onArtifactMask(const signal_processing::ArtifactMask& mask) {
+    for (std::size_t i = mask.causes.size(); i-- > 0;) {
+        if (mask.causes[i] != 0) {
+            lastArtifactTimepoint = mask.timepoints[i];
+            return;
+        }
+    }
+}
+
+void onArtifactInterval(const signal_processing::ArtifactInterval& interval) {
+    ++artifactIntervals;
+    artifactDurationUs += interval.end - interval.begin;
+}
+
+// Contact and signal quality of every channel, published once a second. The
+// device runs in signal-and-resistance mode, so no separate resistance check
+// interrupts the acquisition.
+std::unique_ptr<signal_processing::SignalQualityEngine> signalQuality;
+
+void onSignalQuality(const signal_processing::SignalQualityReport& report) {
+    if (logged(pipeline::Classifier::SignalQuality)) {
+        logging::Info(kQualityLog, "Signal quality {}", report.score);
+        for (std::size_t channel = 0; channel < report.channels.size(); ++channel) {
+            logging::Debug(kQualityLog, "channel {}: score {}, resistance {}, line noise {}", channel,
+                           report.channels[channel].score, report.channels[channel].resistance.value_or(-1.0f),
+                           report.channels[channel].lineNoiseRatio);
+        }
+    }
+    if (!pipelineConfig.Routes(pipeline::Classifier::SignalQuality, pipeline::kSinkSocket)) {
+        return;
+    }
+
+    socket_communication::Data dataForSend{};
+    dataForSend.signalQuality.value = report.score;
+    socketClient->SendData(dataForSend, dataForSend.signalQuality.code);
+}
+
+// Alpha peak refined during the whole session, published every few seconds
+constexpr uint64_t kTrackedPeakPublishPeriodUs = 5'000'000;
+signal_processing::AlphaPeakTracker alphaPeakTracker;
+uint64_t trackedPeakPublishedAt = 0;
+
+// The first minutes of clean spectra decide whether the cached calibration
+// still fits the user; a rejected one is dropped and the user calibrates again
+void validateCachedCalibration() {
+    const double cachedPeak = cachedCalibration->individual.individualPeakFrequency;
+    const auto trackedPeak = alphaPeakTracker.PeakFrequency();
+    const auto check = calibration::CheckCachedPeak(cachedPeak, trackedPeak, alphaPeakTracker.AcceptedCount(),
+                                                    calibrationPolicy);
+    if (check == calibration::PeakCheck::Pending) {
+        return;
+    }
+    if (check == calibration::PeakCheck::Confirmed) {
+        logging::Info(kCalibrationLog, "Cached calibration confirmed: alpha peak {} Hz, cached {} Hz", *trackedPeak,
+                      cachedPeak);
+        cachedCalibration.reset();
+        return;
+    }
+    logging::Warning(kCalibrationLog, "Alpha peak moved to {} Hz from the cached {} Hz, calibrating again",
+                     *trackedPeak, cachedPeak);
+    calibrationCache->Remove(calibrationUser, selectedDeviceID);
+    cachedCalibration.reset();
+    if (!calibrationRequested) {
+        calibrationRequested = true;
+        if (calibrator && clCNFBCalibrator_IsReady(calibrator)) {
+            calibrateIndividualNFB(calibrator);
+        }
+    }
+}
 
-void onResistances([[maybe_unused]] clCDevice device, clCResistances resistances) {
-    // Get total number of resistance channels.
+void onEEGSpectrum(uint64_t timepoint, std::span<const double> psd, double binWidth) {
+    const auto windowUs = static_cast<uint64_t>(kBandPowerWindowSec * 1e6);
+    if ((lastArtifactTimepoint && *lastArtifactTimepoint + windowUs > timepoint)
+        || !alphaPeakTracker.Update(psd, binWidth)) {
+        return;
+    }
+    if (cachedCalibration) {
+        validateCachedCalibration();
+    }
+    const auto peak = alphaPeakTracker.PeakFrequency();
+    if (!peak || timepoint < trackedPeakPublishedAt + kTrackedPeakPublishPeriodUs) {
+        return;
+    }
+    trackedPeakPublishedAt = timepoint;
+    logging::Info(kSpectrumLog, "Tracked alpha peak: {} Hz ({} spectra rejected as artifacts)", *peak,
+                  alphaPeakTracker.RejectedCount());
+    if (!pipelineConfig.Routes(pipeline::Classifier::Nfb, pipeline::kSinkSocket)) {
+        return;
+    }
+
+    socket_communication::Data dataForSend{};
+    dataForSend.trackedPeakFrequency.value = static_cast<float>(*peak);
+    socketClient->SendData(dataForSend, dataForSend.trackedPeakFrequency.code);
+}
+
+// Pearson correlation of two series, updated one pair at a time
+struct RunningCorrelation {
+    uint64_t count = 0;
+    double meanX = 0.0;
+    double meanY = 0.0;
+    double m2X = 0.0;
+    double m2Y = 0.0;
+    double coMoment = 0.0;
+
+    void Add(double x, double y) {
+        ++count;
+        const double dx = x - meanX;
+        const double dy = y - meanY;
+        meanX += dx / static_cast<double>(count);
+        meanY += dy / static_cast<double>(count);
+        m2X += dx * (x - meanX);
+        m2Y += dy * (y - meanY);
+        coMoment += dx * (y - meanY);
+    }
+
+    double Value() const {
+        return m2X > 0.0 && m2Y > 0.0 ? coMoment / std::sqrt(m2X * m2Y) : 0.0;
+    }
+};
+
+// in the order the feedback functions are added in onNFBInitializedEvent
+const std::array<std::string, 3> kFeedbackRhythms = {"alpha", "beta", "theta"};
+std::array<RunningCorrelation, 3> feedbackCorrelations;
+uint64_t feedbackUpdates = 0;
+
+void onBandPowers(uint64_t, std::span<const float> powers) {
+    const std::size_t bands = bandPowers->BandsCount();
+    const int32_t channels = bandPowers->ChannelsCount();
+    channelMeanBandPowers.assign(bands, 0.0f);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        for (std::size_t band = 0; band < bands; ++band) {
+            channelMeanBandPowers[band] += powers[static_cast<std::size_t>(channel) * bands + band] / channels;
+        }
+    }
+}
+
+// Per-channel features for the models, computed from the band power spectra
+constexpr uint64_t kFeaturesPrintPeriodUs = 10'000'000;
+std::unique_ptr<signal_processing::EegFeatureExtractor> eegFeatures;
+uint64_t featuresPrintedAt = 0;
+
+void onEEGFeatures(uint64_t timepoint, std::span<const float> features) {
+    using namespace signal_processing;
+    if (timepoint < featuresPrintedAt + kFeaturesPrintPeriodUs) {
+        return;
+    }
+    featuresPrintedAt = timepoint;
+    static_assert(kEegFeaturesCount == 7, "every feature has a place in the record");
+    for (std::size_t channel = 0; (channel + 1) * kEegFeaturesCount <= features.size(); ++channel) {
+        const float* values = features.data() + channel * kEegFeaturesCount;
+        logging::Info(kFeaturesLog, "EEG features, channel {}: {} {}, {} {}, {} {}, {} {}, {} {}, {} {}, {} {}",
+                      channel, EegFeatureName(kSpectralEntropy), values[kSpectralEntropy],
+                      EegFeatureName(kHjorthActivity), values[kHjorthActivity], EegFeatureName(kHjorthMobility),
+                      values[kHjorthMobility], EegFeatureName(kHjorthComplexity), values[kHjorthComplexity],
+                      EegFeatureName(kThetaBetaRatio), values[kThetaBetaRatio], EegFeatureName(kAlphaThetaBetaRatio),
+                      values[kAlphaThetaBetaRatio], EegFeatureName(kLineLength), values[kLineLength]);
+    }
+}
+
+// Event-related averages: keys 1-5 mark a stimulus of that condition, the
+// marker is set from the client loop and the epoch is cut from the history
+constexpr double kEegHistorySec = 10.0;
+signal_processing::SignalHistory eegHistory(kEegHistorySec);
+signal_processing::EpochAverager erp({}, eegHistory);
+std::atomic<int> markerRequested{-1};
+
+void onErpAverage(const signal_processing::ErpAverage& average) {
+    logging::Info(kErpLog, "ERP condition {}, {} epochs", average.condition + 1, average.epochs);
+    for (int32_t channel = 0; channel < average.channels; ++channel) {
+        const auto mean = average.mean.subspan(static_cast<std::size_t>(channel) * average.samples, average.samples);
+        const auto peak = std::max_element(mean.begin(), mean.end(),
+                                           [](float a, float b) { return std::abs(a) < std::abs(b); });
+        const double latencyMs = (static_cast<double>(peak - mean.begin()) - static_cast<double>(average.preSamples))
+                                 * 1000.0 / average.sampleRate;
+        logging::Info(kErpLog, "\tchannel {}: peak {} at {} ms", channel, *peak, latencyMs);
+    }
+}
+
+void markStimulus(int condition) {
+    if (!session) {
+        return;
+    }
+    clCSession_MarkActivity(session, static_cast<clCUserActivity>(condition));
+    // Stamp the marker with the newest EEG timepoint rather than a client
+    // clock whose unit the SDK does not document; it lags the stimulus by at
+    // most one block of transport delay
+    if (!eegHistory.Ready()) {
+        return;
+    }
+    const uint64_t written = eegHistory.SamplesWritten();
+    uint64_t timepoint = 0;
+    if (written > 0 && eegHistory.ReadTimepoints(written - 1, std::span(&timepoint, 1)).count == 1) {
+        erp.Mark(static_cast<std::size_t>(condition), timepoint);
+    }
+}
+
+void onSessionEEGData([[maybe_unused]] clCSession session, clCEEGTimedData data) {
+    using namespace signal_processing;
+    const SignalBlock block = CopyEEGBlock(data);
+    eegMonitor.Observe(block);
+    eegHistory.Push(block);
+    erp.Update();
+    if (!bandPowers) {
+        // the SDK does not report the EEG rate, wait until it is inferred
+        const double sampleRate = eegMonitor.Stats().sampleRate;
+        if (sampleRate <= 0.0) {
+            return;
+        }
+        BandPowerConfig config;
+        config.sampleRate = sampleRate;
+        config.windowSamples = static_cast<std::size_t>(std::lround(kBandPowerWindowSec * sampleRate));
+        config.segmentSamples = std::bit_floor(static_cast<std::size_t>(sampleRate));
+        config.hopSamples = static_cast<std::size_t>(std::lround(sampleRate / kBandPowerUpdateHz));
+        config.bands = individualBands.value_or(DefaultPowerBands());
+        bandPowers = std::make_unique<BandPowerEngine>(std::move(config), block.ChannelsCount());
+        bandPowers->SetPowersHandler(onBandPowers);
+        bandPowers->SetSpectrumHandler(onEEGSpectrum);
+
+        EegFeatureConfig featureConfig;
+        featureConfig.sampleRate = sampleRate;
+        featureConfig.windowSamples = bandPowers->Config().windowSamples;
+        featureConfig.bands = bandPowers->Config().bands;
+        eegFeatures = std::make_unique<EegFeatureExtractor>(std::move(featureConfig), block.ChannelsCount());
+        eegFeatures->SetFeaturesHandler(onEEGFeatures);
+        bandPowers->SetChannelSpectraHandler([](uint64_t timepoint, std::span<const double> psds, double binWidth) {
+            eegFeatures->OnSpectra(timepoint, psds, binWidth);
+        });
+
+        ArtifactDetectorConfig artifactConfig;
+        artifactConfig.sampleRate = sampleRate;
+        artifactDetector = std::make_unique<ArtifactDetector>(artifactConfig, block.ChannelsCount());
+        artifactDetector->Subscribe(onArtifactMask);
+        artifactDetector->SubscribeIntervals(onArtifactInterval);
+
+        if (pipelineConfig.Enabled(pipeline::Classifier::SignalQuality)) {
+            SignalQualityConfig qualityConfig;
+            qualityConfig.sampleRate = sampleRate;
+            signalQuality = std::make_unique<SignalQualityEngine>(qualityConfig, block.ChannelsCount(),
+                                                                  artifactDetector->LineNoise());
+            signalQuality->SetReportHandler(onSignalQuality);
+        }
+    }
+    // marks and time-domain sums first, so that the spectra of this block already see them;
+    // the quality reads the line noise the detector has just measured
+    artifactDetector->Push(block);
+    if (signalQuality) {
+        signalQuality->Push(block);
+    }
+    eegFeatures->Push(block);
+    bandPowers->Push(block);
+}
+
+// Relative power of a rhythm among the local bands, comparable to the NFB feedback
+std::optional<double> localRelativePower(const std::string& rhythm) {
+    if (!bandPowers || channelMeanBandPowers.empty()) {
+        return std::nullopt;
+    }
+    const auto& bands = bandPowers->Config().bands;
+    double total = 0.0;
+    std::optional<double> power;
+    for (std::size_t band = 0; band < bands.size(); ++band) {
+        total += channelMeanBandPowers[band];
+        if (bands[band].name == rhythm) {
+            power = channelMeanBandPowers[band];
+        }
+    }
+    if (!power || total <= 0.0) {
+        return std::nullopt;
+    }
+    return *power / total;
+}
+
+void printBandPowerComparison() {
+    if (!bandPowers) {
+        return;
+    }
+    std::cout << "Band powers: " << bandPowers->UpdatesCount() << " local updates, "
+              << feedbackUpdates << " NFB feedback updates" << '\n';
+    for (std::size_t rhythm = 0; rhythm < kFeedbackRhythms.size(); ++rhythm) {
+        std::cout << "\t" << kFeedbackRhythms[rhythm] << ": correlation with NFB feedback "
+                  << feedbackCorrelations[rhythm].Value() << " over " << feedbackCorrelations[rhythm].count
+                  << " updates" << '\n';
+    }
+    std::cout << std::flush;
+}
+
+void onResistances(clCDevice device, clCResistances resistances) {
+    if (!signalQuality) {
+        return;
+    }
+    // resistance channels are matched to the EEG channels by name
+    clCDeviceChannelNames channelNames = clCDevice_GetChannelNames(device);
     const int32_t count = clCResistances_GetCount(resistances);
-    std::cout << "Resistances: " << count << std::endl;
     for (int32_t i = 0; i < count; ++i) {
-        const char* channelName = clCString_CStr(clCResistances_GetChannelName(resistances, i));
-        const float value = clCResistances_GetValue(resistances, i);
-        std::cout << "\t " << channelName << " = " << value << std::endl;
+        clCString channelName = clCResistances_GetChannelName(resistances, i);
+        const int32_t channel = clCDevice_GetChannelIndexByName(channelNames, clCString_CStr(channelName));
+        clCString_Free(channelName);
+        signalQuality->SetResistance(channel, clCResistances_GetValue(resistances, i));
     }
 }
 
@@ -66,7 +502,31 @@ void onUpdateUserState([[maybe_unused]] clCNFB nfb, const clCNFBUserState* userS
     // Getting NFB user data
     // if artifacts or weak resistance on the electrodes are observed,
     // the data will not be changed
-    std::cout << "NFB update state: alpha = " << userState->feedbackData[0] << " , beta = " << userState->feedbackData[1] << " , theta = " << userState->feedbackData[2] << std::endl;
+    if (logged(pipeline::Classifier::Nfb)) {
+        logging::Info(kNfbLog, "NFB update state: alpha = {} , beta = {} , theta = {}", userState->feedbackData[0],
+                      userState->feedbackData[1], userState->feedbackData[2]);
+    }
+    storeMetric(pipeline::Classifier::Nfb, "nfb_alpha", userState->feedbackData[0]);
+    storeMetric(pipeline::Classifier::Nfb, "nfb_beta", userState->feedbackData[1]);
+    storeMetric(pipeline::Classifier::Nfb, "nfb_theta", userState->feedbackData[2]);
+
+    ++feedbackUpdates;
+    // nan until the local band powers are available
+    std::array<double, kFeedbackRhythms.size()> localPowers;
+    localPowers.fill(std::numeric_limits<double>::quiet_NaN());
+    for (std::size_t rhythm = 0; rhythm < kFeedbackRhythms.size() && rhythm < userState->feedbackSize; ++rhythm) {
+        const auto local = localRelativePower(kFeedbackRhythms[rhythm]);
+        if (!local) {
+            continue;
+        }
+        feedbackCorrelations[rhythm].Add(*local, userState->feedbackData[rhythm]);
+        localPowers[rhythm] = *local;
+    }
+    if (!logged(pipeline::Classifier::Nfb)) {
+        return;
+    }
+    logging::Debug(kNfbLog, "\tlocal relative power: alpha = {}, beta = {}, theta = {}", localPowers[0], localPowers[1],
+                   localPowers[2]);
 }
 
 void onNFBErrorEvent([[maybe_unused]] clCNFB nfb, const char* error) {
@@ -74,26 +534,158 @@ void onNFBErrorEvent([[maybe_unused]] clCNFB nfb, const char* error) {
 }
 
 void onProductivityArtifacts([[maybe_unused]] clCNFBMetricProductivity productivity, [[maybe_unused]] const clCNFBUserArtifacts*) {
-    std::cout << "Productivity received information about artifacts" << std::endl;
+    if (logged(pipeline::Classifier::Productivity)) {
+        logging::Debug(kProductivityLog, "Productivity received information about artifacts");
+    }
 }
 
 void onProductivityIndividualInfo([[maybe_unused]] clCNFBMetricProductivity productivity,
                                   [[maybe_unused]] const clCNFBMetricsProductivityIndividualIndexes*) {
-    std::cout << "Productivity received individual indexes" << std::endl;
+    if (logged(pipeline::Classifier::Productivity)) {
+        logging::Info(kProductivityLog, "Productivity received individual indexes");
+    }
+}
+
+void onProductivityBaselines(clCNFBMetricProductivity, const clCNFBMetricsProductivityBaselines* baselines) {
+    if (logged(pipeline::Classifier::Productivity)) {
+        logging::Info(kProductivityLog, "Productivity baselines: gravity {}, fatigue {}, relax {}, concentration {}",
+                      baselines->gravityBaseline, baselines->fatigueBaseline, baselines->relaxBaseline,
+                      baselines->concentrationBaseline);
+    }
+}
+
+void reportMetrics() {
+    if (!metricsStore) {
+        return;
+    }
+    for (const char* name : {"concentration_score", "fatigue_score", "heart_rate"}) {
+        const auto last = metricsStore->LastTimestamp(name);
+        if (!last.has_value()) {
+            continue;
+        }
+        std::cout << name << " per minute over the last " << kMetricsReportMinutes << " min (mean, min - max):";
+        const int64_t from = *last - kMetricsReportMinutes * time_series::ResolutionMs(time_series::Resolution::Minute);
+        for (const auto& minute : metricsStore->Range(name, from, *last, time_series::Resolution::Minute)) {
+            std::cout << ' ' << minute.mean << " (" << minute.min << " - " << minute.max << ")";
+        }
+        std::cout << '\n';
+    }
+    time_series::PrintStats(std::cout, metricsStore->Stats());
 }
 
 void onProductivtyScoreUpdate([[maybe_unused]] clCNFBMetricProductivity productivity, float productivityScore) {
-    std::cout << "Productivity received productivity score: " << productivityScore << std::endl;
+    if (logged(pipeline::Classifier::Productivity)) {
+        logging::Info(kProductivityLog, "Productivity received productivity score: {}", productivityScore);
+    }
+    storeMetric(pipeline::Classifier::Productivity, "productivity_score", productivityScore);
+}
+
+// Recent distribution of the productivity scores, the local counterpart of clCNFBBaseline
+constexpr int64_t kScoreBaselineWindowUs = 5 * 60 * 1'000'000LL;
+const std::array<double, 3> kScoreBaselinePercentiles = {10.0, 50.0, 90.0};
+signal_processing::WindowedQuantiles fatigueBaseline(kScoreBaselineWindowUs);
+signal_processing::WindowedQuantiles concentrationBaseline(kScoreBaselineWindowUs);
+
+void updateScoreBaseline(const char* name, signal_processing::WindowedQuantiles& baseline, float score) {
+    baseline.Push(score, static_cast<int64_t>(clCClient_GetTimeMicro()));
+    std::array<float, kScoreBaselinePercentiles.size()> quantiles{};
+    baseline.Quantiles(kScoreBaselinePercentiles, quantiles);
+    if (!logged(pipeline::Classifier::Productivity)) {
+        return;
+    }
+    logging::Info(kProductivityLog, "\t{} over the last 5 min: p10 {}, p50 {}, p90 {}", name, quantiles[0],
+                  quantiles[1], quantiles[2]);
+}
+
+// Fatigue and concentration extrapolated to the alert thresholds, so that
+// the notification app can warn before a limit is reached. Thresholds are
+// set with --fatigue-threshold and --concentration-threshold.
+constexpr uint64_t kForecastPublishPeriodUs = 10'000'000;
+signal_processing::TrendForecaster fatigueForecaster({.threshold = 70.0, .rising = true});
+signal_processing::TrendForecaster concentrationForecaster({.threshold = 30.0, .rising = false});
+uint64_t forecastPublishedAt = 0;
+
+template <typename Field>
+void setForecastField(Field& field, std::optional<double> seconds, uint32_t& fieldFlags) {
+    if (seconds) {
+        field.value = static_cast<float>(*seconds);
+        fieldFlags |= field.code;
+    }
+}
+
+void logForecast(const char* name, const signal_processing::TrendForecaster& forecaster,
+                 const signal_processing::TrendForecast& forecast) {
+    // -1 stands for a bound that never reaches the threshold
+    logging::Info(kForecastLog, "{} {} changes by {} per min, reaches {} in {} s ({} - {} s)", name, forecast.level,
+                  forecast.slope * 60.0, forecaster.Config().threshold, forecast.timeToThreshold.value_or(-1.0),
+                  forecast.earliest.value_or(-1.0), forecast.latest.value_or(-1.0));
+}
+
+void updateForecasts(float fatigueScore, float concentrationScore) {
+    const uint64_t now = clCClient_GetTimeMicro();
+    fatigueForecaster.Update(now, fatigueScore);
+    concentrationForecaster.Update(now, concentrationScore);
+    if (now < forecastPublishedAt + kForecastPublishPeriodUs) {
+        return;
+    }
+    const auto fatigue = fatigueForecaster.Forecast();
+    const auto concentration = concentrationForecaster.Forecast();
+    if (!fatigue && !concentration) {
+        return;
+    }
+    forecastPublishedAt = now;
+
+    socket_communication::Data data{};
+    uint32_t field_flags = 0;
+    if (fatigue) {
+        if (logged(pipeline::Classifier::Productivity)) {
+            logForecast("Fatigue", fatigueForecaster, *fatigue);
+        }
+        setForecastField(data.fatigueForecast, fatigue->timeToThreshold, field_flags);
+        setForecastField(data.fatigueForecastEarliest, fatigue->earliest, field_flags);
+        setForecastField(data.fatigueForecastLatest, fatigue->latest, field_flags);
+    }
+    if (concentration) {
+        if (logged(pipeline::Classifier::Productivity)) {
+            logForecast("Concentration", concentrationForecaster, *concentration);
+        }
+        setForecastField(data.concentrationForecast, concentration->timeToThreshold, field_flags);
+        setForecastField(data.concentrationForecastEarliest, concentration->earliest, field_flags);
+        setForecastField(data.concentrationForecastLatest, concentration->latest, field_flags);
+    }
+    if (field_flags != 0 && pipelineConfig.Routes(pipeline::Classifier::Productivity, pipeline::kSinkSocket)) {
+        socketClient->SendData(data, field_flags);
+    }
 }
 
 void onProductivityValuesUpdate(clCNFBMetricProductivity, const clCNFBMetricsProductivityValues* values) {
-    std::cout << "Productivity values update:\n"
-              << "\tFatigue Score: " << values->fatigueScore << '\n'
-              << "\tGravity Score: " << values->gravityScore << '\n'
-              << "\tConcentration Score: " << values->concentrationScore << '\n'
-              << "\tRelaxation Score: " << values->relaxationScore << '\n'
-              << "\tAccumulated Fatigue: " << values->accumulatedFatigue << '\n'
-              << "\tFatigue Growth Rate: " << values->fatigueGrowthRate << std::endl;
+    startupTimeline.Mark(instrumentation::StartupEvent::FirstProductivityValue);
+    if (logged(pipeline::Classifier::Productivity)) {
+        logging::Info(kProductivityLog,
+                      "Productivity values update:\n"
+                      "\tFatigue Score: {}\n"
+                      "\tGravity Score: {}\n"
+                      "\tConcentration Score: {}\n"
+                      "\tRelaxation Score: {}\n"
+                      "\tAccumulated Fatigue: {}\n"
+                      "\tFatigue Growth Rate: {}",
+                      values->fatigueScore, values->gravityScore, values->concentrationScore, values->relaxationScore,
+                      values->accumulatedFatigue, values->fatigueGrowthRate);
+    }
+    updateScoreBaseline("Fatigue Score", fatigueBaseline, values->fatigueScore);
+    updateScoreBaseline("Concentration Score", concentrationBaseline, values->concentrationScore);
+    // the scores share the threshold scale of the flags; accumulatedFatigue has no
+    // documented range and fatigueGrowthRate is an integer step, not a slope to fit
+    updateForecasts(values->fatigueScore, values->concentrationScore);
+    storeMetric(pipeline::Classifier::Productivity, "fatigue_score", values->fatigueScore);
+    storeMetric(pipeline::Classifier::Productivity, "gravity_score", values->gravityScore);
+    storeMetric(pipeline::Classifier::Productivity, "concentration_score", values->concentrationScore);
+    storeMetric(pipeline::Classifier::Productivity, "relaxation_score", values->relaxationScore);
+    storeMetric(pipeline::Classifier::Productivity, "accumulated_fatigue", values->accumulatedFatigue);
+    storeMetric(pipeline::Classifier::Productivity, "fatigue_growth_rate", values->fatigueGrowthRate);
+    if (!pipelineConfig.Routes(pipeline::Classifier::Productivity, pipeline::kSinkSocket)) {
+        return;
+    }
 
     socket_communication::Data data{};
     data.fatigueScore.value = values->fatigueScore;
@@ -106,22 +698,96 @@ void onProductivityValuesUpdate(clCNFBMetricProductivity, const clCNFBMetricsPro
 }
 
 void onCardioIndexesUpdate([[maybe_unused]] clCCardio cardio, clCCardioData data) {
-    std::cout << "Cardio indexes update: (artifacted " << data.artifacted
-              << "), Kaplan's index " << data.kaplanIndex << ", HR " << data.heartRate
-              << ", stress index " << data.stressIndex << std::endl;
+    if (logged(pipeline::Classifier::Cardio)) {
+        logging::Info(kCardioLog, "Cardio indexes update: (artifacted {}), Kaplan's index {}, HR {}, stress index {}",
+                      data.artifacted, data.kaplanIndex, data.heartRate, data.stressIndex);
+    }
+    if (data.artifacted) {
+        return;
+    }
+    storeMetric(pipeline::Classifier::Cardio, "kaplan_index", data.kaplanIndex);
+    storeMetric(pipeline::Classifier::Cardio, "heart_rate", data.heartRate);
+    storeMetric(pipeline::Classifier::Cardio, "stress_index", data.stressIndex);
+}
+
+void onEmotionalStatesUpdate(clCEmotions, const clCEmotionalStates* states) {
+    if (logged(pipeline::Classifier::Emotions)) {
+        logging::Info(kEmotionsLog, "Emotions: focus {}, chill {}, stress {}, anger {}, self-control {}", states->focus,
+                      states->chill, states->stress, states->anger, states->selfControl);
+    }
+    storeMetric(pipeline::Classifier::Emotions, "emotion_focus", states->focus);
+    storeMetric(pipeline::Classifier::Emotions, "emotion_chill", states->chill);
+    storeMetric(pipeline::Classifier::Emotions, "emotion_stress", states->stress);
+    storeMetric(pipeline::Classifier::Emotions, "emotion_anger", states->anger);
+    storeMetric(pipeline::Classifier::Emotions, "emotion_self_control", states->selfControl);
+}
+
+void onEmotionsError(clCEmotions, const char* error) {
+    std::cerr << "Emotions error: " << error << std::endl;
+}
+
+void onPhysiologicalStatesUpdate(clCPhysiologicalStates, const clCPhysiologicalStatesValue* states) {
+    if (logged(pipeline::Classifier::PhysiologicalStates)) {
+        logging::Info(kStatesLog,
+                      "Physiological states: relaxation {}, fatigue {}, none {}, concentration {}, involvement {}, "
+                      "stress {} (NFB artifacts {}, cardio artifacts {})",
+                      states->relaxation, states->fatigue, states->none, states->concentration, states->involvement,
+                      states->stress, states->nfbArtifacts, states->cardioArtifacts);
+    }
+    if (states->nfbArtifacts || states->cardioArtifacts) {
+        return;
+    }
+    storeMetric(pipeline::Classifier::PhysiologicalStates, "state_relaxation", states->relaxation);
+    storeMetric(pipeline::Classifier::PhysiologicalStates, "state_fatigue", states->fatigue);
+    storeMetric(pipeline::Classifier::PhysiologicalStates, "state_concentration", states->concentration);
+    storeMetric(pipeline::Classifier::PhysiologicalStates, "state_involvement", states->involvement);
+    storeMetric(pipeline::Classifier::PhysiologicalStates, "state_stress", states->stress);
+}
+
+void onPhysiologicalStatesCalibrated(clCPhysiologicalStates, const clCPhysiologicalStatesBaselines* baselines) {
+    if (logged(pipeline::Classifier::PhysiologicalStates)) {
+        logging::Info(kStatesLog, "Physiological states calibrated: alpha {}, beta {}, concentration {}",
+                      baselines->alpha, baselines->beta, baselines->concentration);
+    }
+}
+
+void onHeadEvent(signal_processing::HeadEvent event, const signal_processing::HeadPose& pose) {
+    if (!logged(pipeline::Classifier::Mems)) {
+        return;
+    }
+    logging::Info(kHeadLog, "{}: pitch {}, roll {}",
+                  event == signal_processing::HeadEvent::Nod ? "Head nod" : "Posture change", pose.pitch, pose.roll);
 }
 
 void onMEMSUpdate([[maybe_unused]] clCMEMS mems, clCMEMSTimedData data) {
-    const int32_t count = clCMEMSTimedData_GetCount(data);
-    std::cout << "MEMS update: showing 1 of " << count << " values" << std::endl;
-    const clCPoint3d accelerometer = clCMEMSTimedData_GetAccelerometer(data, 0);
-    const clCPoint3d gyroscope = clCMEMSTimedData_GetGyroscope(data, 0);
-    const auto timepoint = clCMEMSTimedData_GetTimepoint(data, 0);
-    std::cout << "\taccelerometer: " << accelerometer.x << ", "
-              << accelerometer.y << ", " << accelerometer.z << std::endl;
-    std::cout << "\tgyroscope: " << gyroscope.x << ", "
-              << gyroscope.y << ", " << gyroscope.z << std::endl;
-    std::cout << "\ttime: " << std::to_string(timepoint) << std::endl;
+    headMotion.Push(signal_processing::CopyMEMSBlock(data));
+    const auto& pose = headMotion.Pose();
+    if (artifactDetector) {
+        artifactDetector->SetMotion(pose.timepoint, headMotion.IsMoving());
+    }
+    if (!logged(pipeline::Classifier::Mems) || pose.timepoint < headPosePrintedAt + kHeadPosePrintPeriodUs) {
+        return;
+    }
+    headPosePrintedAt = pose.timepoint;
+    logging::Info(kHeadLog, "Head pose: pitch {}, roll {}, yaw {}, motion {}{}", pose.pitch, pose.roll, pose.yaw,
+                  pose.motionEnergy, headMotion.IsMoving() ? " (moving)" : "");
+}
+
+// Local bands and the published peak follow the individual NFB data, fresh or cached
+void applyIndividualData(const clCIndividualNFBData& data) {
+    individualBands = signal_processing::IndividualPowerBands(data);
+    if (bandPowers) {
+        bandPowers->SetBands(*individualBands);
+        eegFeatures->SetBands(*individualBands);
+    }
+    if (!pipelineConfig.Routes(pipeline::Classifier::Nfb, pipeline::kSinkSocket)) {
+        return;
+    }
+
+    socket_communication::Data dataForSend{};
+    dataForSend.individualPeakFrequency.value = data.individualPeakFrequency;
+    uint32_t field_flags = dataForSend.individualPeakFrequency.code;
+    socketClient->SendData(dataForSend, field_flags);
 }
 
 void onCalibrated(clCNFBCalibrator, const clCIndividualNFBData* data, clCIndividualNFBCalibrationFailReason failReason) {
@@ -141,22 +807,34 @@ void onCalibrated(clCNFBCalibrator, const clCIndividualNFBData* data, clCIndivid
         clientStopRequested = true;
         return;
     }
+    startupTimeline.Mark(instrumentation::StartupEvent::Calibrated);
 //    std::cout << "Calibration suceeded. IAF:" << data->individualFrequency << std::endl;
-
-    socket_communication::Data dataForSend{};
-    dataForSend.individualPeakFrequency.value = data->individualPeakFrequency;
-    uint32_t field_flags = dataForSend.individualPeakFrequency.code;
-    socketClient->SendData(dataForSend, field_flags);
+    applyIndividualData(*data);
+    // both start from the individual NFB data
+    if (emotions) {
+        clCEmotions_StartCalibration(emotions);
+    }
+    if (physiologicalStates) {
+        clCPhysiologicalStates_StartCalibration(physiologicalStates);
+    }
+    // a fresh calibration replaces the cached one without waiting for the check
+    cachedCalibration.reset();
+    if (calibrationCached()) {
+        calibrationCache->Save({calibrationUser, selectedDeviceID, unixSeconds(), *data});
+    }
 }
 
 void onCalibratorReady(clCNFBCalibrator calibrator) {
-    std::cout << "Calibrator is ready to calibrate NFB\n"
-              << "Close your eyes for 30 seconds" << std::endl;
-    clCError error = clC_Error_OK;
-    clCNFBCalibrator_CalibrateIndividualNFBQuick(calibrator, &error);
+    startupTimeline.Mark(instrumentation::StartupEvent::CalibratorReady);
+    if (!calibrationRequested) {
+        std::cout << "Calibrator is ready, the cached calibration is used" << std::endl;
+        return;
+    }
+    calibrateIndividualNFB(calibrator);
 }
 
 void onLicenseVerified(clCLicenseManager, bool result, clCLicenseError) {
+    startupTimeline.Mark(instrumentation::StartupEvent::LicenseVerified);
     std::cout << "License verification result: " << std::boolalpha << result << std::endl;
     if (!result) {
         std::cerr << "License verification failed. Exiting..." << std::endl;
@@ -165,10 +843,12 @@ void onLicenseVerified(clCLicenseManager, bool result, clCLicenseError) {
 }
 
 void onSessionStarted(clCSession session) {
+    startupTimeline.Mark(instrumentation::StartupEvent::SessionStarted);
     std::cout << "Session started" << std::endl;
     const char* sessionUUID = clCString_CStr(clCSession_GetSessionUUID(session));
     std::cout << "Session UUID: " << sessionUUID << std::endl;
     clCSession_MarkActivity(session, clCUserActivity1);
+    erp.SetAverageHandler(onErpAverage);
 
     calibrator = clCNFBCalibrator_CreateOrGet(session);
     clCNFBCalibratorDelegateIndividualNFBCalibrated onCalibratedEvent = clCNFBCalibrator_GetOnIndividualNFBCalibratedEvent(calibrator);
@@ -176,62 +856,130 @@ void onSessionStarted(clCSession session) {
     clCNFBCalibratorDelegateReadyToCalibrate onCalibratorReadyEvent = clCNFBCalibrator_GetOnReadyToCalibrate(calibrator);
     clCNFBCalibratorDelegateReadyToCalibrate_Set(onCalibratorReadyEvent, onCalibratorReady);
 
-    // Create NFB - NeiryFeedBack
-    nfb = clCNFB_Create(session);
-    // get NFB events
-    clCNFBDelegate delegateInit = clCNFB_GetOnInitializedEvent(nfb);
-    clCNFBDelegateNFBUserState delegateState = clCNFB_GetOnUserStateChangedEvent(nfb);
-    clCNFBDelegateString delegateError = clCNFB_GetOnErrorEvent(nfb);
-    // Initialize NFB events
-    clCNFBDelegate_Set(delegateInit, onNFBInitializedEvent);
-    clCNFBDelegateNFBUserState_Set(delegateState, onUpdateUserState);
-    clCNFBDelegateString_Set(delegateError, onNFBErrorEvent);
-    // Initialize NFB
-    clCNFB_Initialize(nfb);
-
-    // Productivity metrics is an algorithm that uses custom rhythms
-    // and an IAPF and other indicators to calculate the productivity score
-    // Create Productivity metric - math constants are better not to change yet
-    clCError error = clC_Error_OK;
-    productivity = clCNFBMetricsProductivity_Create(session, "logs", 0.05, 0.05, 0.001, &error);
-    if (error != clC_Error_OK) {
-        std::cerr << "Failed to create Productivity classifier" << std::endl;
-        return;
+    // The SDK takes individual NFB data only from its own calibrator and has
+    // no way to import it. A cached calibration serves the local bands and the
+    // published peak until the calibrator is done; the eyes-closed step is
+    // skipped only when no classifier of the SDK runs.
+    if (calibrationCached()) {
+        cachedCalibration = calibrationCache->Find(calibrationUser, selectedDeviceID, unixSeconds(),
+                                                   calibrationPolicy.maxAge);
     }
-    // get Productivity events
-    clCNFBMetricsProductivityIndividualDelegate delegateMeasured = clCNFBMetricsProductivity_GetOnIndividualMeasuredEvent(productivity);
-    clCNFBMetricsProductivityArtifactsDelegate delegateArtifacts = clCNFBMetricsProductivity_GetOnArtifactsEvent(productivity);
-    clCNFBMetricsProductivityEventDelegate delegateUserUpdate = clCNFBMetricsProductivity_GetOnUpdateEvent_1min(productivity);
-    clCNFBMetricsProductivityValuesDelegate delegateValuesUpdate = clCNFBMetricsProductivity_GetOnProductivityValuesEvent(productivity);
-    // Initialize Productivity events
-    clCNFBMetricsProductivity_IndividualMeasuredEvent_Set(delegateMeasured, onProductivityIndividualInfo);
-    clCNFBMetricsProductivity_ArtifactsEvent_Set(delegateArtifacts, onProductivityArtifacts);
-    clCNFBMetricsProductivity_UpdateEvent_Set(delegateUserUpdate, onProductivtyScoreUpdate);
-    clCNFBMetricsProductivity_ValuesEvent_Set(delegateValuesUpdate, onProductivityValuesUpdate);
-    // Initialize Productivity
-    clCNFBMetricsProductivity_InitializeNFB(productivity, "", &error);
-
-    clCDevice_SwitchMode(device, clC_DM_Signal);
-    cardio = clCCardio_Create(session);
-    if (cardio == nullptr) {
-        std::cerr << "Failed to create cardio classifier" << std::endl;
-        return;
+    calibrationRequested = !cachedCalibration || pipelineConfig.NeedsCalibration();
+    if (cachedCalibration) {
+        calibration::PrintRecord(std::cout, *cachedCalibration, unixSeconds());
+        if (!calibrationRequested) {
+            startupTimeline.Mark(instrumentation::StartupEvent::Calibrated);
+        }
+        applyIndividualData(cachedCalibration->individual);
     }
-    clCCardioIndexesDelegate delegateCardio = clCCardio_GetOnIndexesUpdateEvent(cardio);
-    clCCardioDelegateIndexesUpdate_Set(delegateCardio, onCardioIndexesUpdate);
-    clCCardio_Initialize(cardio);
-    clCDevice_SwitchMode(device, clC_DM_StartPPG);
 
-    mems = clCMEMS_Create(session);
-    if (mems == nullptr) {
-        std::cerr << "Failed to create MEMS classifier" << std::endl;
-        return;
+    // Only the classifiers of the pipeline are created, and the device
+    // streams PPG and MEMS only when one of them needs it
+    using pipeline::Classifier;
+    if (pipelineConfig.Enabled(Classifier::Nfb)) {
+        // Create NFB - NeiryFeedBack
+        nfb = clCNFB_Create(session);
+        // get NFB events
+        clCNFBDelegate delegateInit = clCNFB_GetOnInitializedEvent(nfb);
+        clCNFBDelegateNFBUserState delegateState = clCNFB_GetOnUserStateChangedEvent(nfb);
+        clCNFBDelegateString delegateError = clCNFB_GetOnErrorEvent(nfb);
+        // Initialize NFB events
+        clCNFBDelegate_Set(delegateInit, onNFBInitializedEvent);
+        clCNFBDelegateNFBUserState_Set(delegateState, onUpdateUserState);
+        clCNFBDelegateString_Set(delegateError, onNFBErrorEvent);
+        // Initialize NFB
+        clCNFB_Initialize(nfb);
+    }
+
+    if (pipelineConfig.Enabled(Classifier::Productivity)) {
+        // Productivity metrics is an algorithm that uses custom rhythms
+        // and an IAPF and other indicators to calculate the productivity score
+        // Create Productivity metric - math constants are better not to change yet
+        clCError error = clC_Error_OK;
+        productivity = clCNFBMetricsProductivity_Create(session, "logs", 0.05, 0.05, 0.001, &error);
+        if (error != clC_Error_OK) {
+            std::cerr << "Failed to create Productivity classifier" << std::endl;
+            return;
+        }
+        // get Productivity events
+        clCNFBMetricsProductivityIndividualDelegate delegateMeasured = clCNFBMetricsProductivity_GetOnIndividualMeasuredEvent(productivity);
+        clCNFBMetricsProductivityArtifactsDelegate delegateArtifacts = clCNFBMetricsProductivity_GetOnArtifactsEvent(productivity);
+        clCNFBMetricsProductivityEventDelegate delegateUserUpdate = clCNFBMetricsProductivity_GetOnUpdateEvent_1min(productivity);
+        clCNFBMetricsProductivityValuesDelegate delegateValuesUpdate = clCNFBMetricsProductivity_GetOnProductivityValuesEvent(productivity);
+        // Initialize Productivity events
+        clCNFBMetricsProductivity_IndividualMeasuredEvent_Set(delegateMeasured, onProductivityIndividualInfo);
+        clCNFBMetricsProductivity_ArtifactsEvent_Set(delegateArtifacts, onProductivityArtifacts);
+        clCNFBMetricsProductivity_UpdateEvent_Set(delegateUserUpdate, onProductivtyScoreUpdate);
+        clCNFBMetricsProductivity_ValuesEvent_Set(delegateValuesUpdate, onProductivityValuesUpdate);
+        clCNFBMetricsProductivity_InitialBaselineCalibratedEvent_Set(
+                clCNFBMetricsProductivity_GetOnInitialBaselineCalibratedEvent(productivity), onProductivityBaselines);
+        // Initialize Productivity
+        clCNFBMetricsProductivity_InitializeNFB(productivity, "", &error);
+    }
+
+    if (pipelineConfig.Enabled(Classifier::Emotions)) {
+        emotions = clCEmotions_Create(session, pipelineConfig.emotionsSpeed, pipelineConfig.emotionsMaxSpeed);
+        if (emotions == nullptr) {
+            std::cerr << "Failed to create emotions classifier" << std::endl;
+            return;
+        }
+        clCEmotionsDelegateEmotionalStatesUpdate delegateStates = clCEmotions_GetOnEmotionalStatesUpdateEvent(emotions);
+        clCEmotionsDelegateEmotionalStatesUpdate_Set(delegateStates, onEmotionalStatesUpdate);
+        clCEmotionsDelegateString_Set(clCEmotions_GetOnErrorEvent(emotions), onEmotionsError);
+        clCEmotions_Initialize(emotions, "");
     }
-    clCMEMSTimedDataDelegate delegateMEMS = clCMEMS_GetOnMEMSTimedDataUpdateEvent(mems);
-    clCMEMSDelegateMEMSTimedDataUpdate_Set(delegateMEMS, onMEMSUpdate);
-    clCMEMS_Initialize(mems);
 
-    clCDevice_SwitchMode(device, clC_DM_StartMEMS);
+    clCDevice_SwitchMode(device, pipelineConfig.NeedsResistances() ? clC_DM_SignalAndResist : clC_DM_Signal);
+
+    if (pipelineConfig.Enabled(Classifier::Cardio)) {
+        cardio = clCCardio_Create(session);
+        if (cardio == nullptr) {
+            std::cerr << "Failed to create cardio classifier" << std::endl;
+            return;
+        }
+        clCCardioIndexesDelegate delegateCardio = clCCardio_GetOnIndexesUpdateEvent(cardio);
+        clCCardioDelegateIndexesUpdate_Set(delegateCardio, onCardioIndexesUpdate);
+        clCCardio_Initialize(cardio);
+    }
+
+    if (pipelineConfig.Enabled(Classifier::PhysiologicalStates)) {
+        physiologicalStates = clCPhysiologicalStates_Create(session);
+        if (physiologicalStates == nullptr) {
+            std::cerr << "Failed to create physiological states classifier" << std::endl;
+            return;
+        }
+        clCPhysiologicalStatesOnPhysiologicalStatesUpdateEvent_Set(
+                clCPhysiologicalStates_GetOnPhysiologicalStatesUpdateEvent(physiologicalStates),
+                onPhysiologicalStatesUpdate);
+        clCPhysiologicalStatesOnCalibratedEvent_Set(clCPhysiologicalStates_GetOnCalibratedEvent(physiologicalStates),
+                                                    onPhysiologicalStatesCalibrated);
+        if (pipelineConfig.physiologicalStatesPeriod) {
+            clCPhysiologicalStates_InitializeWithCalculationPeriod(physiologicalStates,
+                                                                   *pipelineConfig.physiologicalStatesPeriod);
+        } else {
+            clCPhysiologicalStates_Initialize(physiologicalStates);
+        }
+    }
+
+    if (pipelineConfig.NeedsPPG()) {
+        clCDevice_SwitchMode(device, clC_DM_StartPPG);
+    }
+
+    if (pipelineConfig.Enabled(Classifier::Mems)) {
+        mems = clCMEMS_Create(session);
+        if (mems == nullptr) {
+            std::cerr << "Failed to create MEMS classifier" << std::endl;
+            return;
+        }
+        clCMEMSTimedDataDelegate delegateMEMS = clCMEMS_GetOnMEMSTimedDataUpdateEvent(mems);
+        clCMEMSDelegateMEMSTimedDataUpdate_Set(delegateMEMS, onMEMSUpdate);
+        headMotion.SetEventHandler(onHeadEvent);
+        clCMEMS_Initialize(mems);
+    }
+
+    if (pipelineConfig.NeedsMEMS()) {
+        clCDevice_SwitchMode(device, clC_DM_StartMEMS);
+    }
 }
 
 void onSessionError([[maybe_unused]] clCSession session, clCSessionError error) {
@@ -239,7 +987,17 @@ void onSessionError([[maybe_unused]] clCSession session, clCSessionError error)
 }
 
 void onSessionStopped([[maybe_unused]] clCSession session) {
+    // the reports below follow the records of the session
+    logging::DefaultLogger().Flush();
     std::cout << "Session stopped" << std::endl;
+    reportStartup(true);
+    printBandPowerComparison();
+    reportMetrics();
+    if (artifactDetector) {
+        artifactDetector->Flush();
+        std::cout << "EEG artifacts: " << artifactIntervals << " intervals, "
+                  << static_cast<double>(artifactDurationUs) / 1e6 << " s in total" << std::endl;
+    }
 }
 
 void onConnectionStateChanged([[maybe_unused]] clCDevice device, clCDeviceConnectionState state) {
@@ -249,6 +1007,7 @@ void onConnectionStateChanged([[maybe_unused]] clCDevice device, clCDeviceConnec
         return;
     }
     std::cout << "Device connected" << std::endl;
+    startupTimeline.Mark(instrumentation::StartupEvent::DeviceConnected);
     deviceConnectionTime = s_time;
 
     // get channel names
@@ -270,13 +1029,18 @@ void onConnectionStateChanged([[maybe_unused]] clCDevice device, clCDeviceConnec
     clCLicenseManager_VerifyLicense(licenseManager, licenseKey.c_str(), device);
 }
 
-void onDeviceList(clCDeviceLocator locator, clCDeviceInfoList devices, clCDeviceLocatorFailReason error) {
-    // device connected
-    if (device != nullptr) {
-        return;
+void requestDevices() {
+    if (const int32_t searchTime = deviceScan.NextWindowSec(); searchTime > 0) {
+        clCDeviceLocator_RequestDevices(locator, searchTime);
     }
+}
 
+void onDeviceList(clCDeviceLocator locator, clCDeviceInfoList devices, clCDeviceLocatorFailReason error) {
     if (error != clC_DeviceLocatorFailReason_OK) {
+        // the device was already selected, only the diagnostic scan is affected
+        if (device != nullptr) {
+            return;
+        }
         switch (error) {
         case clC_DeviceLocatorFailReason_BluetoothDisabled:
             std::cerr << "Bluetooth adapter not found or disabled";
@@ -289,25 +1053,35 @@ void onDeviceList(clCDeviceLocator locator, clCDeviceInfoList devices, clCDevice
         return;
     }
 
-    if (clCDeviceInfoList_GetCount(devices) == 0) {
-        std::cerr << "Empty device list. Exiting..." << std::endl;
-        clientStopRequested = true;
+    // print information about newly found devices
+    const int32_t count = clCDeviceInfoList_GetCount(devices);
+    std::cout << "Devices: " << count << std::endl;
+    const auto selectedIndex = deviceScan.OnDeviceList(devices, std::cout);
+
+    // device connected, keep scanning for diagnostics
+    if (device != nullptr) {
+        requestDevices();
         return;
     }
 
-    // print information about all found devices
-    const int32_t count = clCDeviceInfoList_GetCount(devices);
-    std::cout << "Devices: " << count << std::endl;
-    for (int i = 0; i < count; i++) {
-        clCDeviceInfo deviceDescriptor = clCDeviceInfoList_GetDeviceInfo(devices, i);
-        const char* deviceDescription = clCString_CStr(clCDeviceInfo_GetDescription(deviceDescriptor));
-        std::cout << "\t " << deviceDescription << std::endl;
+    if (!selectedIndex.has_value()) {
+        if (!deviceScan.Finished()) {
+            requestDevices();
+            return;
+        }
+        std::cerr << (count == 0 ? "Empty device list" : "No device matches the filter") << ". Exiting..." << std::endl;
+        clientStopRequested = true;
+        return;
     }
+    startupTimeline.Mark(instrumentation::StartupEvent::DeviceListReceived);
 
     // select device and connect
-    clCDeviceInfo deviceDescriptor = clCDeviceInfoList_GetDeviceInfo(devices, 0);
-    const char* deviceID = clCString_CStr(clCDeviceInfo_GetID(deviceDescriptor));
-    device = clCDeviceLocator_CreateDevice(locator, deviceID);
+    clCDeviceInfo deviceDescriptor = clCDeviceInfoList_GetDeviceInfo(devices, *selectedIndex);
+    clCString deviceID = clCDeviceInfo_GetID(deviceDescriptor);
+    selectedDeviceID = clCString_CStr(deviceID);
+    startupTimeline.SetDeviceType(device_discovery::DeviceTypeName(clCDeviceInfo_GetType(deviceDescriptor)));
+    device = clCDeviceLocator_CreateDevice(locator, clCString_CStr(deviceID));
+    clCString_Free(deviceID);
     if (device == nullptr) {
         std::cerr << "Failed to create device. Exiting..." << std::endl;
         clientStopRequested = true;
@@ -321,6 +1095,8 @@ void onDeviceList(clCDeviceLocator locator, clCDeviceInfoList devices, clCDevice
     clCDeviceDelegateConnectionState_Set(onConnectionStateChangedEvent, onConnectionStateChanged);
     //  Сonnect to the device
     clCDevice_Connect(device);
+
+    requestDevices();
 }
 
 void onConnected(clCClient client) {
@@ -328,10 +1104,11 @@ void onConnected(clCClient client) {
     // launch the locator to search for the selected device.
     // when receiving a list of available devices, control is transferred to onDeviceList
     std::cout << "Connected" << std::endl;
-    locator = clCClient_ChooseDeviceType(client, clC_DT_NeiryBand);
+    startupTimeline.Mark(instrumentation::StartupEvent::ClientConnected);
+    locator = clCClient_ChooseDeviceType(client, deviceScan.LocatorType());
     clCDeviceLocatorDelegateDeviceInfoList onDevicesEvent = clCDeviceLocator_GetOnDevicesEvent(locator);
     clCDeviceLocatorDelegateDeviceInfoList_Set(onDevicesEvent, onDeviceList);
-    clCDeviceLocator_RequestDevices(locator, 15);
+    requestDevices();
 }
 
 void onError([[maybe_unused]] clCClient client, clCError error) {
@@ -340,8 +1117,21 @@ void onError([[maybe_unused]] clCClient client, clCError error) {
 
 void onDisconnected(clCClient client, clCDisconnectReason reason) {
     // destroy all objects
+    logging::DefaultLogger().Flush();
     std::cout << "Disconnected: " << static_cast<int>(reason) << std::endl;
+    reportStartup(true);
+    if (metricsStore) {
+        metricsStore->Flush();
+    }
 
+    if (physiologicalStates) {
+        clCPhysiologicalStates_Destroy(physiologicalStates);
+        physiologicalStates = nullptr;
+    }
+    if (emotions) {
+        clCEmotions_Destroy(emotions);
+        emotions = nullptr;
+    }
     if (mems) {
         clCMEMS_Destroy(mems);
         mems = nullptr;
@@ -394,14 +1184,17 @@ void ClientLoop() {
             clCSessionDelegate onSessionStartedEvent = clCSession_GetOnSessionStartedEvent(session);
             clCSessionDelegateSessionError onSessionErrorEvent = clCSession_GetOnErrorEvent(session);
             clCSessionDelegate onSessionStoppedEvent = clCSession_GetOnSessionStoppedEvent(session);
+            clCSessionDelegateSessionEEGData onSessionEEGDataEvent = clCSession_GetOnSessionEEGDataEvent(session);
 
             // Initialize session events
             clCSessionDelegate_Set(onSessionStartedEvent, onSessionStarted);
             clCSessionDelegateSessionError_Set(onSessionErrorEvent, onSessionError);
             clCSessionDelegate_Set(onSessionStoppedEvent, onSessionStopped);
+            clCSessionDelegateSessionEEGData_Set(onSessionEEGDataEvent, onSessionEEGData);
 
             // Start session
             const clCSessionState state = clCSession_GetSessionState(session);
+            startupTimeline.Mark(instrumentation::StartupEvent::SessionStartRequested);
             clCSession_Start(session);
             std::cout << "Session state: " << static_cast<int>(state) << std::endl;
         }
@@ -414,6 +1207,12 @@ void ClientLoop() {
             clCClient_Disconnect(client);
             clientDisconnecting = true;
         }
+        if (startupReportRequested.exchange(false)) {
+            reportStartup(false);
+        }
+        if (const int marker = markerRequested.exchange(-1); marker >= 0) {
+            markStimulus(marker);
+        }
         if (static bool printFirmware = true; printFirmware && device && clCDevice_FirmwareVersionReceived(device)) {
             clCError error = clCError::clC_Error_OK;
             const auto firmware = clCDevice_GetFirmwareVersion(device, &error);
@@ -427,9 +1226,47 @@ void ClientLoop() {
 }
 
 int main(int argc, char* argv[]) {
+    // before the license prompt, so that a mistyped flag fails right away
+    const auto deviceFilter = device_discovery::ParseDeviceFilter(argc, argv);
+    if (!deviceFilter) {
+        return 1;
+    }
     parseArgs(argc, argv, &licenseKey, nullptr, nullptr);
+    deviceScan = device_discovery::DeviceScan(*deviceFilter, kDeviceSearchTimeSec);
+    metricsStorePath = std::string(findArgValue(argc, argv, "--metrics").value_or(metricsStorePath));
+    if (const auto path = findArgValue(argc, argv, "--pipeline")) {
+        const auto loaded = pipeline::LoadPipeline(std::string(*path));
+        if (!loaded) {
+            return 1;
+        }
+        pipelineConfig = *loaded;
+    }
+    pipeline::PrintPipeline(std::cout, pipelineConfig);
+    metricsStore = std::make_unique<time_series::Store>(metricsStorePath);
+    if (const auto user = findArgValue(argc, argv, "--user")) {
+        calibrationUser = std::string(*user);
+        calibrationCache = std::make_unique<calibration::CalibrationCache>(kCalibrationCachePath);
+    }
+    if (const auto days = findArgNumber(argc, argv, "--calibration-max-age")) {
+        calibrationPolicy.maxAge = std::chrono::hours(std::llround(*days * 24.0));
+    }
+    if (const auto threshold = findArgNumber(argc, argv, "--fatigue-threshold")) {
+        fatigueForecaster = signal_processing::TrendForecaster({.threshold = *threshold, .rising = true});
+    }
+    if (const auto threshold = findArgNumber(argc, argv, "--concentration-threshold")) {
+        concentrationForecaster = signal_processing::TrendForecaster({.threshold = *threshold, .rising = false});
+    }
+    if (const auto level = findArgValue(argc, argv, "--log-level")) {
+        if (const auto parsed = logging::ParseLevel(*level)) {
+            logging::DefaultLogger().SetLevel(*parsed);
+        } else {
+            std::cerr << "Unknown log level " << *level << ", expected debug, info, warning or error" << std::endl;
+        }
+    }
 
-    std::cout << "To quit the example type 'q' and press enter" << std::endl;
+    std::cout << "To quit the example type 'q' and press enter\n"
+              << "To print the startup timeline type 't' and press enter\n"
+              << "To mark a stimulus of condition 1-5 type its number and press enter" << std::endl;
 
     // Getting the version of the library
     // and an example of working with a clCString
@@ -452,6 +1289,7 @@ int main(int argc, char* argv[]) {
     clCClientDelegateError_Set(onErrorEvent, onError);
     clCClientDelegateDisconnectReason_Set(onDisconnectedEvent, onDisconnected);
 
+    startupTimeline.Mark(instrumentation::StartupEvent::ClientConnecting);
     clCClient_Connect(client, "inproc://capsule");
     // Getting the client name of the library
     // and an example of working with a clCString
@@ -470,6 +1308,12 @@ int main(int argc, char* argv[]) {
             clientStopRequested = true;
             break;
         }
+        if (input == 't' || input == 'T') {
+            startupReportRequested = true;
+        }
+        if (input >= '1' && input <= '5') {
+            markerRequested = input - '1';
+        }
     }
     future.wait();
 
@@ -0,0 +1,177 @@
+#include <montage.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+namespace signal_processing
+{
+namespace
+{
+std::optional<int32_t> FindInput(const std::vector<std::string>& inputs, std::string_view name) {
+    const auto it = std::find(inputs.begin(), inputs.end(), name);
+    if (it == inputs.end()) {
+        return std::nullopt;
+    }
+    return static_cast<int32_t>(it - inputs.begin());
+}
+
+std::vector<std::string_view> Split(std::string_view text, char separator) {
+    std::vector<std::string_view> parts;
+    std::size_t depth = 0;
+    std::size_t begin = 0;
+    for (std::size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || (text[i] == separator && depth == 0)) {
+            parts.push_back(text.substr(begin, i - begin));
+            begin = i + 1;
+        } else if (text[i] == '(') {
+            ++depth;
+        } else if (text[i] == ')' && depth > 0) {
+            --depth;
+        }
+    }
+    return parts;
+}
+
+// Adds weight to the term of an input, merging repeated inputs
+void AddWeight(Derivation& derivation, int32_t input, float weight) {
+    for (auto& [index, value] : derivation.weights) {
+        if (index == input) {
+            value += weight;
+            return;
+        }
+    }
+    derivation.weights.emplace_back(input, weight);
+}
+
+Derivation AverageReferenced(const std::vector<std::string>& inputs, int32_t input) {
+    Derivation derivation{inputs[input] + "-avg", {}};
+    const float share = 1.0f / static_cast<float>(inputs.size());
+    AddWeight(derivation, input, 1.0f);
+    for (int32_t other = 0; other < static_cast<int32_t>(inputs.size()); ++other) {
+        AddWeight(derivation, other, -share);
+    }
+    return derivation;
+}
+} // namespace
+
+Montage::Montage(std::vector<std::string> inputs, std::vector<Derivation> derivations)
+        : inputs_{std::move(inputs)}
+        , derivations_{std::move(derivations)}
+{
+}
+
+Montage Montage::Monopolar(std::vector<std::string> inputs) {
+    std::vector<Derivation> derivations;
+    for (int32_t input = 0; input < static_cast<int32_t>(inputs.size()); ++input) {
+        derivations.push_back({inputs[input], {{input, 1.0f}}});
+    }
+    return Montage(std::move(inputs), std::move(derivations));
+}
+
+Montage Montage::CommonAverage(std::vector<std::string> inputs) {
+    std::vector<Derivation> derivations;
+    for (int32_t input = 0; input < static_cast<int32_t>(inputs.size()); ++input) {
+        derivations.push_back(AverageReferenced(inputs, input));
+    }
+    return Montage(std::move(inputs), std::move(derivations));
+}
+
+Montage Montage::Bipolar(std::vector<std::string> inputs) {
+    std::vector<Derivation> derivations;
+    const auto pairs = static_cast<int32_t>(inputs.size() / 2);
+    for (int32_t input = 0; input < pairs; ++input) {
+        derivations.push_back({inputs[input] + "-" + inputs[input + pairs], {{input, 1.0f}, {input + pairs, -1.0f}}});
+    }
+    return Montage(std::move(inputs), std::move(derivations));
+}
+
+std::optional<Montage> Montage::Parse(std::string_view spec, std::vector<std::string> inputs) {
+    std::vector<Derivation> derivations;
+    for (const auto item : Split(spec, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        if (item == "monopolar" || item == "average" || item == "bipolar") {
+            const Montage expanded = item == "monopolar" ? Monopolar(inputs)
+                                     : item == "average" ? CommonAverage(inputs)
+                                                         : Bipolar(inputs);
+            derivations.insert(derivations.end(), expanded.derivations_.begin(), expanded.derivations_.end());
+            continue;
+        }
+
+        const auto dash = item.find('-');
+        const auto activeName = item.substr(0, dash);
+        const auto active = FindInput(inputs, activeName);
+        if (!active) {
+            std::cerr << "Montage: unknown channel " << activeName << std::endl;
+            return std::nullopt;
+        }
+        if (dash == std::string_view::npos) {
+            derivations.push_back({std::string(item), {{*active, 1.0f}}});
+            continue;
+        }
+
+        auto reference = item.substr(dash + 1);
+        if (reference == "avg") {
+            derivations.push_back(AverageReferenced(inputs, *active));
+            continue;
+        }
+        if (reference.size() >= 2 && reference.front() == '(' && reference.back() == ')') {
+            reference = reference.substr(1, reference.size() - 2);
+        }
+        Derivation derivation{std::string(item), {{*active, 1.0f}}};
+        const auto referenceNames = Split(reference, '+');
+        const float share = 1.0f / static_cast<float>(referenceNames.size());
+        for (const auto name : referenceNames) {
+            const auto index = FindInput(inputs, name);
+            if (!index) {
+                std::cerr << "Montage: unknown channel " << name << std::endl;
+                return std::nullopt;
+            }
+            AddWeight(derivation, *index, -share);
+        }
+        derivations.push_back(std::move(derivation));
+    }
+    if (derivations.empty()) {
+        std::cerr << "Montage: no derivations" << std::endl;
+        return std::nullopt;
+    }
+    return Montage(std::move(inputs), std::move(derivations));
+}
+
+const std::vector<std::string>& Montage::Inputs() const {
+    return inputs_;
+}
+
+std::span<const Derivation> Montage::Derivations() const {
+    return derivations_;
+}
+
+int32_t Montage::ChannelsCount() const {
+    return static_cast<int32_t>(derivations_.size());
+}
+
+SignalBlock Montage::Apply(const SignalBlock& block) const {
+    const int32_t samples = block.SamplesCount();
+    SignalBlock derived = SignalBlock::Allocate(ChannelsCount(), samples);
+    const auto timepoints = block.Timepoints();
+    std::copy(timepoints.begin(), timepoints.end(), derived.Timepoints().begin());
+    for (int32_t channel = 0; channel < ChannelsCount(); ++channel) {
+        const auto out = derived.Channel(channel);
+        std::fill(out.begin(), out.end(), 0.0f);
+        float* output = out.data();
+        for (const auto& [input, weight] : derivations_[channel].weights) {
+            if (input >= block.ChannelsCount()) {
+                continue;
+            }
+            // aligned, contiguous arrays: the loop compiles to vector multiply-adds
+            const float* values = block.Channel(input).data();
+            for (int32_t i = 0; i < samples; ++i) {
+                output[i] += weight * values[i];
+            }
+        }
+    }
+    return derived;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,249 @@
+#include <pipeline_config.hpp>
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace pipeline
+{
+namespace
+{
+constexpr std::array<Sink, 3> kSinks = {kSinkLog, kSinkSocket, kSinkStore};
+
+std::string_view trim(std::string_view text) {
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    const auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+std::optional<Classifier> findClassifier(std::string_view name) {
+    for (std::size_t i = 0; i < kClassifiersCount; ++i) {
+        if (name == ClassifierName(static_cast<Classifier>(i))) {
+            return static_cast<Classifier>(i);
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<Sink> findSink(std::string_view name) {
+    for (const auto sink : kSinks) {
+        if (name == SinkName(sink)) {
+            return sink;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<double> parseNumber(std::string_view text) {
+    double value = 0.0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size() || !(value > 0.0)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Sinks of one classifier, nullopt after reporting the first bad name
+std::optional<uint32_t> parseSinks(Classifier classifier, std::string_view value, const std::string& where) {
+    uint32_t sinks = 0;
+    while (!value.empty()) {
+        const auto comma = value.find(',');
+        const auto name = trim(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        const auto sink = findSink(name);
+        if (!sink) {
+            std::cerr << where << ": unknown sink '" << name << "', expected log, socket or store" << std::endl;
+            return std::nullopt;
+        }
+        if ((SupportedSinks(classifier) & *sink) == 0) {
+            std::cerr << where << ": " << ClassifierName(classifier) << " events cannot go to " << name << std::endl;
+            return std::nullopt;
+        }
+        sinks |= *sink;
+    }
+    return sinks;
+}
+} // namespace
+
+const char* ClassifierName(Classifier classifier) {
+    switch (classifier) {
+    case Classifier::Nfb:
+        return "nfb";
+    case Classifier::Productivity:
+        return "productivity";
+    case Classifier::Cardio:
+        return "cardio";
+    case Classifier::Mems:
+        return "mems";
+    case Classifier::Emotions:
+        return "emotions";
+    case Classifier::PhysiologicalStates:
+        return "physiological_states";
+    case Classifier::SignalQuality:
+        return "signal_quality";
+    default:
+        return "unknown";
+    }
+}
+
+const char* SinkName(Sink sink) {
+    switch (sink) {
+    case kSinkLog:
+        return "log";
+    case kSinkSocket:
+        return "socket";
+    case kSinkStore:
+        return "store";
+    default:
+        return "unknown";
+    }
+}
+
+// Socket fields: the individual and the tracked alpha peak belong to NFB,
+// the scores and forecasts to productivity, the quality score to signal quality
+uint32_t SupportedSinks(Classifier classifier) {
+    switch (classifier) {
+    case Classifier::Cardio:
+    case Classifier::Emotions:
+    case Classifier::PhysiologicalStates:
+        return kSinkLog | kSinkStore;
+    case Classifier::Nfb:
+    case Classifier::Productivity:
+        return kSinkLog | kSinkSocket | kSinkStore;
+    case Classifier::Mems:
+        return kSinkLog;
+    case Classifier::SignalQuality:
+        return kSinkLog | kSinkSocket;
+    default:
+        return 0;
+    }
+}
+
+bool PipelineConfig::Enabled(Classifier classifier) const {
+    return classifiers[static_cast<std::size_t>(classifier)].enabled;
+}
+
+bool PipelineConfig::Routes(Classifier classifier, Sink sink) const {
+    const auto& config = classifiers[static_cast<std::size_t>(classifier)];
+    return config.enabled && (config.sinks & sink) != 0;
+}
+
+bool PipelineConfig::NeedsPPG() const {
+    return Enabled(Classifier::Cardio) || Enabled(Classifier::PhysiologicalStates);
+}
+
+bool PipelineConfig::NeedsMEMS() const {
+    return Enabled(Classifier::Mems);
+}
+
+bool PipelineConfig::NeedsResistances() const {
+    return resistances.value_or(Enabled(Classifier::SignalQuality));
+}
+
+bool PipelineConfig::NeedsCalibration() const {
+    for (std::size_t i = 0; i < kClassifiersCount; ++i) {
+        const auto classifier = static_cast<Classifier>(i);
+        if (classifier != Classifier::SignalQuality && Enabled(classifier)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PipelineConfig DefaultPipeline() {
+    PipelineConfig config;
+    config.classifiers[static_cast<std::size_t>(Classifier::Nfb)] = {true, kSinkLog | kSinkSocket};
+    config.classifiers[static_cast<std::size_t>(Classifier::Productivity)] = {true, kSinkLog | kSinkSocket | kSinkStore};
+    config.classifiers[static_cast<std::size_t>(Classifier::Cardio)] = {true, kSinkLog | kSinkStore};
+    config.classifiers[static_cast<std::size_t>(Classifier::Mems)] = {true, kSinkLog};
+    config.classifiers[static_cast<std::size_t>(Classifier::SignalQuality)] = {true, kSinkLog | kSinkSocket};
+    return config;
+}
+
+std::optional<PipelineConfig> LoadPipeline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open the pipeline " << path << std::endl;
+        return std::nullopt;
+    }
+    PipelineConfig config;
+    std::string line;
+    for (int32_t lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        const std::string where = path + ":" + std::to_string(lineNumber);
+        std::string_view text = line;
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+        const auto equals = text.find('=');
+        if (equals == std::string_view::npos) {
+            std::cerr << where << ": expected key = value" << std::endl;
+            return std::nullopt;
+        }
+        const auto key = trim(text.substr(0, equals));
+        const auto value = trim(text.substr(equals + 1));
+
+        if (const auto classifier = findClassifier(key)) {
+            auto& classifierConfig = config.classifiers[static_cast<std::size_t>(*classifier)];
+            if (value == "off") {
+                classifierConfig = {};
+                continue;
+            }
+            const auto sinks = parseSinks(*classifier, value, where);
+            if (!sinks) {
+                return std::nullopt;
+            }
+            classifierConfig = {true, *sinks};
+        } else if (key == "resistances") {
+            if (value != "on" && value != "off") {
+                std::cerr << where << ": resistances must be on or off, not '" << value << "'" << std::endl;
+                return std::nullopt;
+            }
+            config.resistances = value == "on";
+        } else if (key == "emotions.speed" || key == "emotions.max_speed" || key == "physiological_states.period") {
+            const auto number = parseNumber(value);
+            if (!number) {
+                std::cerr << where << ": " << key << " must be a positive number" << std::endl;
+                return std::nullopt;
+            }
+            if (key == "emotions.speed") {
+                config.emotionsSpeed = *number;
+            } else if (key == "emotions.max_speed") {
+                config.emotionsMaxSpeed = *number;
+            } else {
+                config.physiologicalStatesPeriod = static_cast<float>(*number);
+            }
+        } else {
+            std::cerr << where << ": unknown setting '" << key << "'" << std::endl;
+            return std::nullopt;
+        }
+    }
+    return config;
+}
+
+void PrintPipeline(std::ostream& out, const PipelineConfig& config) {
+    out << "Pipeline:";
+    for (std::size_t i = 0; i < kClassifiersCount; ++i) {
+        const auto& classifier = config.classifiers[i];
+        if (!classifier.enabled) {
+            continue;
+        }
+        out << ' ' << ClassifierName(static_cast<Classifier>(i)) << " (";
+        bool first = true;
+        for (const auto sink : kSinks) {
+            if ((classifier.sinks & sink) != 0) {
+                out << (first ? "" : ", ") << SinkName(sink);
+                first = false;
+            }
+        }
+        out << (first ? "no sinks)" : ")");
+    }
+    out << "; device modes: " << (config.NeedsResistances() ? "signal and resistances" : "signal")
+        << (config.NeedsPPG() ? ", PPG" : "") << (config.NeedsMEMS() ? ", MEMS" : "") << std::endl;
+}
+
+} // namespace pipeline
@@ -0,0 +1,189 @@
+#include <ppg_beats.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+constexpr double kLowCutHz = 0.5;
+constexpr double kHighCutHz = 8.0;
+// no beats closer than this, 200 bpm
+constexpr uint64_t kRefractoryUs = 300'000;
+// the filter settles and the envelope builds up before detection starts
+constexpr double kWarmupSec = 2.0;
+constexpr double kEnvelopeTimeConstantSec = 2.0;
+constexpr float kThresholdRatio = 0.5f;
+// intervals outside of 30-200 bpm come from missed or spurious beats
+constexpr double kMinRrMs = 300.0;
+constexpr double kMaxRrMs = 2000.0;
+
+constexpr double kHistogramBinMs = 50.0;
+constexpr std::size_t kHistogramBins = static_cast<std::size_t>(kMaxRrMs / kHistogramBinMs) + 1;
+} // namespace
+
+PpgBeatDetector::PpgBeatDetector(double sampleRate)
+        : sampleRate_{sampleRate}
+        , bandPass_{HighPassCoefficients(kLowCutHz, sampleRate, kButterworthQ),
+                    LowPassCoefficients(kHighCutHz, sampleRate, kButterworthQ)}
+        , filterState_(2 * bandPass_.size(), 0.0f)
+{
+}
+
+void PpgBeatDetector::SetBeatHandler(BeatHandler handler) {
+    handler_ = std::move(handler);
+}
+
+void PpgBeatDetector::Push(const SignalBlock& block) {
+    if (block.Empty()) {
+        return;
+    }
+    const auto values = block.Channel(0);
+    const auto timepoints = block.Timepoints();
+    if (!offset_.has_value()) {
+        // removes the DC step the high-pass would otherwise ring on
+        offset_ = values.front();
+    }
+    filtered_.resize(values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        filtered_[i] = values[i] - *offset_;
+    }
+    FilterReference(bandPass_, filtered_, filterState_);
+    for (std::size_t i = 0; i < filtered_.size(); ++i) {
+        ProcessSample(filtered_[i], timepoints[i]);
+    }
+}
+
+void PpgBeatDetector::ProcessSample(float value, uint64_t timepoint) {
+    const auto decay = static_cast<float>(std::exp(-1.0 / (kEnvelopeTimeConstantSec * sampleRate_)));
+    const bool warmedUp = static_cast<double>(samples_) >= kWarmupSec * sampleRate_;
+    ++samples_;
+
+    // the middle of the last three samples is a local maximum
+    const float before = previous_[0];
+    const float peak = previous_[1];
+    const uint64_t peakTimepoint = previousTimepoints_[1];
+    const bool isPeak = samples_ > 3 && peak > before && peak >= value;
+    previous_ = {peak, value};
+    previousTimepoints_ = {peakTimepoint, timepoint};
+    if (!warmedUp) {
+        // the envelope only follows the second half of the warm-up, after the filter transient
+        envelope_ = samples_ * 2 > kWarmupSec * sampleRate_ ? std::max(envelope_ * decay, value) : 0.0f;
+        return;
+    }
+    envelope_ = std::max(envelope_ * decay, value);
+    if (!isPeak || peak < kThresholdRatio * envelope_ || (lastPeak_ && peakTimepoint < *lastPeak_ + kRefractoryUs)) {
+        return;
+    }
+    lastPeak_ = peakTimepoint;
+
+    // parabola through the three samples refines the peak time
+    const float curvature = before - 2.0f * peak + value;
+    const double offset = curvature < 0.0f ? std::clamp(0.5 * (before - value) / curvature, -0.5, 0.5) : 0.0;
+    const auto period = static_cast<double>(timepoint - peakTimepoint);
+    PpgBeat beat;
+    beat.timepoint = static_cast<uint64_t>(static_cast<double>(peakTimepoint) + offset * period);
+    beat.amplitude = peak;
+    if (lastBeat_) {
+        const double rrMs = static_cast<double>(beat.timepoint - *lastBeat_) / 1000.0;
+        if (rrMs >= kMinRrMs && rrMs <= kMaxRrMs) {
+            beat.rrMs = rrMs;
+        }
+    }
+    lastBeat_ = beat.timepoint;
+    if (handler_) {
+        handler_(beat);
+    }
+}
+
+HrvEngine::HrvEngine(double windowSec)
+        : windowUs_{static_cast<uint64_t>(windowSec * 1e6)}
+        , histogram_(kHistogramBins, 0)
+{
+}
+
+void HrvEngine::Add(uint64_t timepoint, double rrMs) {
+    const bool follows = !intervals_.empty() && !broken_;
+    if (follows) {
+        const double difference = rrMs - intervals_.back().rrMs;
+        differenceSquaresSum_ += difference * difference;
+        ++differences_;
+        differencesAbove50_ += std::abs(difference) > 50.0 ? 1 : 0;
+    }
+    broken_ = false;
+    intervals_.push_back({timepoint, rrMs, follows});
+    sum_ += rrMs;
+    squaresSum_ += rrMs * rrMs;
+    ++histogram_[std::min(static_cast<std::size_t>(rrMs / kHistogramBinMs), kHistogramBins - 1)];
+
+    // monotonic queues of the window minimum and maximum
+    const uint64_t index = removed_ + intervals_.size() - 1;
+    while (!minimums_.empty() && intervals_[minimums_.back() - removed_].rrMs >= rrMs) {
+        minimums_.pop_back();
+    }
+    minimums_.push_back(index);
+    while (!maximums_.empty() && intervals_[maximums_.back() - removed_].rrMs <= rrMs) {
+        maximums_.pop_back();
+    }
+    maximums_.push_back(index);
+
+    while (intervals_.front().timepoint + windowUs_ < timepoint) {
+        Remove();
+    }
+}
+
+void HrvEngine::Break() {
+    broken_ = true;
+}
+
+void HrvEngine::Remove() {
+    const double rrMs = intervals_.front().rrMs;
+    if (intervals_.size() > 1 && intervals_[1].follows) {
+        const double difference = intervals_[1].rrMs - rrMs;
+        differenceSquaresSum_ -= difference * difference;
+        --differences_;
+        differencesAbove50_ -= std::abs(difference) > 50.0 ? 1 : 0;
+    }
+    sum_ -= rrMs;
+    squaresSum_ -= rrMs * rrMs;
+    --histogram_[std::min(static_cast<std::size_t>(rrMs / kHistogramBinMs), kHistogramBins - 1)];
+    if (minimums_.front() == removed_) {
+        minimums_.pop_front();
+    }
+    if (maximums_.front() == removed_) {
+        maximums_.pop_front();
+    }
+    intervals_.pop_front();
+    ++removed_;
+}
+
+HrvMetrics HrvEngine::Metrics() const {
+    HrvMetrics metrics;
+    const std::size_t count = intervals_.size();
+    metrics.intervals = count;
+    if (count < 2) {
+        return metrics;
+    }
+    const auto n = static_cast<double>(count);
+    metrics.meanRrMs = sum_ / n;
+    const double variance = (squaresSum_ - sum_ * metrics.meanRrMs) / (n - 1.0);
+    metrics.sdnnMs = std::sqrt(std::max(variance, 0.0));
+    if (differences_ > 0) {
+        const auto differences = static_cast<double>(differences_);
+        metrics.rmssdMs = std::sqrt(std::max(differenceSquaresSum_, 0.0) / differences);
+        metrics.pnn50 = 100.0 * static_cast<double>(differencesAbove50_) / differences;
+    }
+
+    const auto mode = std::max_element(histogram_.begin(), histogram_.end());
+    const double modeSec = (static_cast<double>(mode - histogram_.begin()) + 0.5) * kHistogramBinMs / 1000.0;
+    const double modeAmplitude = 100.0 * *mode / n;
+    const double rangeSec = (intervals_[maximums_.front() - removed_].rrMs
+                             - intervals_[minimums_.front() - removed_].rrMs) / 1000.0;
+    // a range narrower than one bin would blow the index up
+    metrics.stressIndex = modeAmplitude / (2.0 * modeSec * std::max(rangeSec, kHistogramBinMs / 1000.0));
+    return metrics;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,148 @@
+#include <signal_quality.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+float Clamp01(float value) {
+    return std::clamp(value, 0.0f, 1.0f);
+}
+} // namespace
+
+SignalQualityEngine::SignalQualityEngine(SignalQualityConfig config, int32_t channels,
+                                         const LineNoiseMeter& lineNoise)
+        : config_{std::move(config)}
+        , channels_{channels}
+        , windowSamples_{static_cast<std::size_t>(std::lround(config_.windowSec * config_.sampleRate))}
+        , publishPeriod_{static_cast<uint64_t>(std::llround(1e6 / config_.publishHz))}
+        , moments_(static_cast<std::size_t>(channels))
+        , lineNoise_{&lineNoise}
+        , resistances_(static_cast<std::size_t>(channels))
+        , qualities_(static_cast<std::size_t>(channels))
+{
+}
+
+const SignalQualityConfig& SignalQualityEngine::Config() const {
+    return config_;
+}
+
+void SignalQualityEngine::SetReportHandler(ReportHandler handler) {
+    handler_ = std::move(handler);
+}
+
+void SignalQualityEngine::SetResistance(int32_t channel, float resistance) {
+    if (channel >= 0 && channel < channels_) {
+        resistances_[channel] = resistance;
+    }
+}
+
+// Pebay's pairwise update of central moments
+SignalQualityEngine::Moments SignalQualityEngine::Merge(const Moments& a, const Moments& b) {
+    if (a.count == 0.0) {
+        return b;
+    }
+    const double n = a.count + b.count;
+    const double delta = b.mean - a.mean;
+    const double delta2 = delta * delta;
+    const double ab = a.count * b.count;
+    Moments merged;
+    merged.count = n;
+    merged.mean = a.mean + delta * b.count / n;
+    merged.m2 = a.m2 + b.m2 + delta2 * ab / n;
+    merged.m3 = a.m3 + b.m3 + delta2 * delta * ab * (a.count - b.count) / (n * n)
+                + 3.0 * delta * (a.count * b.m2 - b.count * a.m2) / n;
+    merged.m4 = a.m4 + b.m4
+                + delta2 * delta2 * ab * (a.count * a.count - ab + b.count * b.count) / (n * n * n)
+                + 6.0 * delta2 * (a.count * a.count * b.m2 + b.count * b.count * a.m2) / (n * n)
+                + 4.0 * delta * (a.count * b.m3 - b.count * a.m3) / n;
+    return merged;
+}
+
+void SignalQualityEngine::Push(const SignalBlock& block) {
+    const std::size_t samples = static_cast<std::size_t>(block.SamplesCount());
+    const SignalBlock& highPassed = lineNoise_->HighPassed();
+    if (samples == 0 || highPassed.SamplesCount() != block.SamplesCount()) {
+        return;
+    }
+    const int32_t channels = std::min(highPassed.ChannelsCount(), channels_);
+    for (int32_t channel = 0; channel < channels; ++channel) {
+        const auto filtered = highPassed.Channel(channel);
+
+        // two passes over the block: mean, then central powers
+        Moments moments;
+        moments.count = static_cast<double>(samples);
+        moments.mean = std::accumulate(filtered.begin(), filtered.end(), 0.0) / moments.count;
+        for (const float value : filtered) {
+            const double d = value - moments.mean;
+            const double d2 = d * d;
+            moments.m2 += d2;
+            moments.m3 += d2 * d;
+            moments.m4 += d2 * d2;
+        }
+        auto& window = moments_[channel];
+        window.push_back(moments);
+        std::size_t windowSamples = 0;
+        for (const auto& blockMoments : window) {
+            windowSamples += static_cast<std::size_t>(blockMoments.count);
+        }
+        while (window.size() > 1 && windowSamples - static_cast<std::size_t>(window.front().count) >= windowSamples_) {
+            windowSamples -= static_cast<std::size_t>(window.front().count);
+            window.pop_front();
+        }
+    }
+
+    const uint64_t timepoint = block.Timepoints()[samples - 1];
+    if (!nextPublish_) {
+        // the first report waits for a full window
+        nextPublish_ = timepoint + static_cast<uint64_t>(config_.windowSec * 1e6);
+    }
+    if (timepoint >= *nextPublish_) {
+        Publish(timepoint);
+        // keep the fixed rate, but do not try to catch up after a gap
+        *nextPublish_ = std::max(*nextPublish_ + publishPeriod_, timepoint + publishPeriod_ / 2);
+    }
+}
+
+void SignalQualityEngine::Publish(uint64_t timepoint) {
+    float total = 0.0f;
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        Moments window;
+        for (const auto& blockMoments : moments_[channel]) {
+            window = Merge(window, blockMoments);
+        }
+        auto& quality = qualities_[channel];
+        const double variance = window.count > 0.0 ? window.m2 / window.count : 0.0;
+        quality.stdDev = static_cast<float>(std::sqrt(variance));
+        quality.kurtosis = window.m2 > 0.0 ? static_cast<float>(window.count * window.m4 / (window.m2 * window.m2) - 3.0)
+                                           : 0.0f;
+        quality.lineNoiseRatio = static_cast<float>(lineNoise_->Ratio(channel).value_or(0.0));
+        quality.resistance = resistances_[channel];
+
+        // a flat channel is as useless as a noisy one
+        float score = quality.stdDev < config_.minStdDev ? quality.stdDev / config_.minStdDev
+                                                         : std::min(1.0f, config_.maxStdDev / quality.stdDev);
+        score = std::min(score, Clamp01(1.0f - (quality.kurtosis - config_.kurtosisLimit) / config_.kurtosisRange));
+        score = std::min(score, 1.0f - quality.lineNoiseRatio);
+        if (quality.resistance) {
+            // interpolated on a log scale, resistances span decades
+            const float logResistance = std::log(std::max(*quality.resistance, 1.0f));
+            const float good = std::log(config_.goodResistance);
+            const float bad = std::log(config_.badResistance);
+            score = std::min(score, Clamp01((bad - logResistance) / (bad - good)));
+        }
+        quality.score = Clamp01(score);
+        total += quality.score;
+    }
+
+    if (handler_) {
+        const SignalQualityReport report{timepoint, qualities_, channels_ > 0 ? total / static_cast<float>(channels_) : 0.0f};
+        handler_(report);
+    }
+}
+
+} // namespace signal_processing
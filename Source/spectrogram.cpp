@@ -0,0 +1,124 @@
+#include <spectrogram.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// floor of the dB scale, keeps log10 away from 0
+constexpr float kMinPower = 1e-30f;
+} // namespace
+
+Spectrogram::Spectrogram(SpectrogramConfig config, int32_t channels)
+        : config_{std::move(config)}
+        , channels_{std::max(channels, 0)}
+        , plan_{std::bit_ceil(std::max<std::size_t>(config_.fftSamples, 2))}
+        , window_{HannWindow(plan_.Size())}
+{
+    config_.fftSamples = plan_.Size();
+    config_.hopSamples = std::max<std::size_t>(config_.hopSamples, 1);
+    config_.columns = std::max<std::size_t>(config_.columns, 1);
+    const double binWidth = config_.sampleRate / static_cast<double>(config_.fftSamples);
+    bins_ = std::min(static_cast<std::size_t>(config_.maxFrequency / binWidth) + 1, plan_.BinsCount());
+    // one-sided power density of the windowed segment
+    const float windowPower = std::inner_product(window_.begin(), window_.end(), window_.begin(), 0.0f);
+    scale_ = static_cast<float>(2.0 / (config_.sampleRate * windowPower));
+
+    history_.assign(static_cast<std::size_t>(channels_) * config_.fftSamples, 0.0f);
+    segment_.resize(config_.fftSamples);
+    spectrum_.resize(plan_.BinsCount());
+    capacity_ = config_.columns + kSpareColumns;
+    columnStride_ = static_cast<std::size_t>(channels_) * bins_;
+    columns_.assign(capacity_ * columnStride_, 0.0f);
+    timepoints_.assign(capacity_, 0);
+}
+
+const SpectrogramConfig& Spectrogram::Config() const {
+    return config_;
+}
+
+int32_t Spectrogram::ChannelsCount() const {
+    return channels_;
+}
+
+std::size_t Spectrogram::BinsCount() const {
+    return bins_;
+}
+
+double Spectrogram::BinWidth() const {
+    return config_.sampleRate / static_cast<double>(config_.fftSamples);
+}
+
+uint64_t Spectrogram::ColumnsWritten() const {
+    return written_.load(std::memory_order_acquire);
+}
+
+std::optional<SpectrogramColumn> Spectrogram::Column(uint64_t index) const {
+    const uint64_t written = ColumnsWritten();
+    if (index >= written || index + config_.columns < written) {
+        return std::nullopt;
+    }
+    const std::size_t slot = index % capacity_;
+    return SpectrogramColumn{index, timepoints_[slot],
+                             std::span<const float>(columns_.data() + slot * columnStride_, columnStride_)};
+}
+
+bool Spectrogram::Intact(uint64_t index) const {
+    // the reads of the column happen before the counter is checked
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the slot is reused by column index + capacity_, announced before it is overwritten
+    return index + capacity_ >= writing_.load(std::memory_order_relaxed);
+}
+
+void Spectrogram::Push(const SignalBlock& block) {
+    const auto timepoints = block.Timepoints();
+    const int32_t channels = std::min(block.ChannelsCount(), channels_);
+    const std::size_t fftSamples = config_.fftSamples;
+    for (std::size_t sample = 0; sample < timepoints.size(); ++sample) {
+        for (int32_t channel = 0; channel < channels; ++channel) {
+            history_[static_cast<std::size_t>(channel) * fftSamples + writeIndex_] = block.Channel(channel)[sample];
+        }
+        writeIndex_ = (writeIndex_ + 1) % fftSamples;
+        filled_ = std::min(filled_ + 1, fftSamples);
+        if (++sinceUpdate_ >= config_.hopSamples && filled_ == fftSamples) {
+            Update(timepoints[sample]);
+            sinceUpdate_ = 0;
+        }
+    }
+}
+
+void Spectrogram::Update(uint64_t timepoint) {
+    const std::size_t fftSamples = config_.fftSamples;
+    const uint64_t index = written_.load(std::memory_order_relaxed);
+    const std::size_t slot = index % capacity_;
+    // announce the column about to be overwritten before touching it
+    writing_.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    float* column = columns_.data() + slot * columnStride_;
+    for (int32_t channel = 0; channel < channels_; ++channel) {
+        // oldest sample first, without the offset of raw EEG
+        const float* ring = history_.data() + static_cast<std::size_t>(channel) * fftSamples;
+        std::copy(ring + writeIndex_, ring + fftSamples, segment_.begin());
+        std::copy(ring, ring + writeIndex_, segment_.begin() + static_cast<std::ptrdiff_t>(fftSamples - writeIndex_));
+        const float mean = std::accumulate(segment_.begin(), segment_.end(), 0.0f) / static_cast<float>(fftSamples);
+        for (std::size_t i = 0; i < fftSamples; ++i) {
+            segment_[i] = (segment_[i] - mean) * window_[i];
+        }
+        plan_.Forward(segment_, spectrum_);
+
+        float* out = column + static_cast<std::size_t>(channel) * bins_;
+        for (std::size_t bin = 0; bin < bins_; ++bin) {
+            out[bin] = 10.0f * std::log10(std::max(std::norm(spectrum_[bin]) * scale_, kMinPower));
+        }
+    }
+    timepoints_[slot] = timepoint;
+    written_.store(index + 1, std::memory_order_release);
+}
+
+} // namespace signal_processing
@@ -0,0 +1,206 @@
+#include <startup_timeline.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+namespace instrumentation
+{
+namespace
+{
+std::optional<double> PercentileOf(std::vector<double> values, double percentile) {
+    if (values.empty()) {
+        return std::nullopt;
+    }
+    // nearest-rank percentile
+    std::sort(values.begin(), values.end());
+    const auto rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * static_cast<double>(values.size())));
+    return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+}
+
+std::vector<std::string> SplitCsvLine(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) {
+        fields.push_back(field);
+    }
+    if (!line.empty() && line.back() == ',') {
+        fields.emplace_back();
+    }
+    return fields;
+}
+} // namespace
+
+const char* StartupEventName(StartupEvent event) {
+    switch (event) {
+    case StartupEvent::ClientConnecting:
+        return "clientConnecting";
+    case StartupEvent::ClientConnected:
+        return "clientConnected";
+    case StartupEvent::DeviceListReceived:
+        return "deviceListReceived";
+    case StartupEvent::DeviceConnected:
+        return "deviceConnected";
+    case StartupEvent::LicenseVerified:
+        return "licenseVerified";
+    case StartupEvent::SessionStartRequested:
+        return "sessionStartRequested";
+    case StartupEvent::SessionStarted:
+        return "sessionStarted";
+    case StartupEvent::CalibratorReady:
+        return "calibratorReady";
+    case StartupEvent::Calibrated:
+        return "calibrated";
+    case StartupEvent::FirstProductivityValue:
+        return "firstProductivityValue";
+    default:
+        return "unknown";
+    }
+}
+
+void StartupTimeline::Mark(StartupEvent event) {
+    auto& slot = events_[static_cast<std::size_t>(event)];
+    if (!slot.has_value()) {
+        slot = Clock::now();
+    }
+}
+
+void StartupTimeline::SetDeviceType(const std::string& deviceType) {
+    deviceType_ = deviceType;
+}
+
+std::optional<StartupTimeline::Clock::time_point> StartupTimeline::Origin() const {
+    std::optional<Clock::time_point> origin;
+    for (const auto& event : events_) {
+        if (event.has_value() && (!origin.has_value() || *event < *origin)) {
+            origin = event;
+        }
+    }
+    return origin;
+}
+
+std::optional<double> StartupTimeline::EventOffsetMs(StartupEvent event) const {
+    const auto& slot = events_[static_cast<std::size_t>(event)];
+    const auto origin = Origin();
+    if (!slot.has_value() || !origin.has_value()) {
+        return std::nullopt;
+    }
+    return std::chrono::duration<double, std::milli>(*slot - *origin).count();
+}
+
+std::optional<double> StartupTimeline::PhaseDurationMs(const StartupPhase& phase) const {
+    const auto& from = events_[static_cast<std::size_t>(phase.from)];
+    const auto& to = events_[static_cast<std::size_t>(phase.to)];
+    if (!from.has_value() || !to.has_value()) {
+        return std::nullopt;
+    }
+    return std::chrono::duration<double, std::milli>(*to - *from).count();
+}
+
+void StartupTimeline::Report(std::ostream& out) const {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1);
+    json << "{\"deviceType\":\"" << deviceType_ << "\",\"events\":{";
+    bool first = true;
+    for (std::size_t i = 0; i < events_.size(); ++i) {
+        const auto event = static_cast<StartupEvent>(i);
+        if (const auto offset = EventOffsetMs(event); offset.has_value()) {
+            json << (first ? "" : ",") << '"' << StartupEventName(event) << "\":" << *offset;
+            first = false;
+        }
+    }
+    json << "},\"phases\":{";
+    first = true;
+    for (const auto& phase : kStartupPhases) {
+        if (const auto duration = PhaseDurationMs(phase); duration.has_value()) {
+            json << (first ? "" : ",") << '"' << phase.name << "\":" << *duration;
+            first = false;
+        }
+    }
+    json << "}}";
+    out << "Startup timeline: " << json.str() << std::endl;
+}
+
+bool StartupTimeline::AppendToHistory(const std::string& path) {
+    if (appended_ || !Origin().has_value()) {
+        return false;
+    }
+    const bool writeHeader = !std::filesystem::exists(path);
+    std::ofstream history(path, std::ios::app);
+    if (!history.is_open()) {
+        return false;
+    }
+    if (writeHeader) {
+        history << "time,device_type";
+        for (const auto& phase : kStartupPhases) {
+            history << ',' << phase.name;
+        }
+        history << '\n';
+    }
+    const auto now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    history << now.count() << ',' << deviceType_;
+    history << std::fixed << std::setprecision(1);
+    for (const auto& phase : kStartupPhases) {
+        history << ',';
+        if (const auto duration = PhaseDurationMs(phase); duration.has_value()) {
+            history << *duration;
+        }
+    }
+    history << '\n';
+    appended_ = true;
+    return true;
+}
+
+void ReportStartupHistory(const std::string& path, std::ostream& out) {
+    std::ifstream history(path);
+    if (!history.is_open()) {
+        return;
+    }
+    std::string line;
+    if (!std::getline(history, line)) {
+        return;
+    }
+    const auto header = SplitCsvLine(line);
+
+    // device type -> phase column -> durations
+    std::map<std::string, std::map<std::size_t, std::vector<double>>> samples;
+    std::map<std::string, std::size_t> runs;
+    while (std::getline(history, line)) {
+        const auto fields = SplitCsvLine(line);
+        if (fields.size() < 2) {
+            continue;
+        }
+        ++runs[fields[1]];
+        for (std::size_t column = 2; column < fields.size() && column < header.size(); ++column) {
+            if (fields[column].empty()) {
+                continue;
+            }
+            try {
+                samples[fields[1]][column].push_back(std::stod(fields[column]));
+            } catch (const std::exception&) {
+                // ignore malformed values
+            }
+        }
+    }
+
+    // formatted locally, so that the caller's stream keeps its own settings
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(1);
+    for (const auto& [deviceType, columns] : samples) {
+        report << "Startup history for " << deviceType << " (" << runs[deviceType] << " runs):\n";
+        for (const auto& [column, values] : columns) {
+            report << "\t" << header[column] << ": p50 " << *PercentileOf(values, 50.0)
+                   << " ms, p95 " << *PercentileOf(values, 95.0) << " ms (n = " << values.size() << ")\n";
+        }
+    }
+    out << report.str() << std::flush;
+}
+
+} // namespace instrumentation
@@ -0,0 +1,233 @@
+#include <stream_aligner.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// frames emitted in one block at most
+constexpr std::size_t kMaxFramesPerBlock = 1024;
+// samples a stream ring holds before it first grows, a power of two
+constexpr std::size_t kInitialCapacity = 1024;
+} // namespace
+
+StreamAligner::StreamAligner(double outputRate, std::chrono::microseconds maxLatency)
+        : outputRate_{outputRate}
+        , maxLatency_{static_cast<uint64_t>(maxLatency.count())}
+{
+    frameTimepoints_.reserve(kMaxFramesPerBlock);
+    sampleSlots_.resize(kMaxFramesPerBlock);
+    nextSlots_.resize(kMaxFramesPerBlock);
+    weights_.resize(kMaxFramesPerBlock);
+}
+
+std::size_t StreamAligner::AddStream(std::string name, int32_t channels) {
+    Stream stream;
+    stream.name = std::move(name);
+    stream.channels = channels;
+    stream.channelOffset = static_cast<std::size_t>(FrameChannelsCount());
+    stream.capacity = kInitialCapacity;
+    stream.timepoints.resize(stream.capacity);
+    stream.values.resize(stream.capacity * static_cast<std::size_t>(channels));
+    streams_.push_back(std::move(stream));
+    return streams_.size() - 1;
+}
+
+void StreamAligner::SetFramesHandler(FramesHandler handler) {
+    handler_ = std::move(handler);
+}
+
+int32_t StreamAligner::FrameChannelsCount() const {
+    int32_t channels = 0;
+    for (const auto& stream : streams_) {
+        channels += stream.channels;
+    }
+    return channels;
+}
+
+std::size_t StreamAligner::ChannelOffset(std::size_t stream) const {
+    return streams_[stream].channelOffset;
+}
+
+const std::string& StreamAligner::StreamName(std::size_t stream) const {
+    return streams_[stream].name;
+}
+
+double StreamAligner::OutputRate() const {
+    return outputRate_;
+}
+
+void StreamAligner::Push(std::size_t streamIndex, const SignalBlock& block) {
+    auto& stream = streams_[streamIndex];
+    const auto timepoints = block.Timepoints();
+    const auto channels = std::min(block.ChannelsCount(), stream.channels);
+    for (std::size_t sample = 0; sample < timepoints.size(); ++sample) {
+        // interpolation needs strictly increasing timepoints
+        if (stream.size != 0 && timepoints[sample] <= stream.Timepoint(stream.size - 1)) {
+            continue;
+        }
+        if (stream.size == stream.capacity) {
+            Grow(stream);
+        }
+        const std::size_t slot = stream.Slot(stream.size);
+        stream.timepoints[slot] = timepoints[sample];
+        for (int32_t channel = 0; channel < stream.channels; ++channel) {
+            stream.values[static_cast<std::size_t>(channel) * stream.capacity + slot] =
+                    channel < channels ? block.Channel(channel)[sample] : std::numeric_limits<float>::quiet_NaN();
+        }
+        ++stream.size;
+    }
+    if (stream.size == 0) {
+        return;
+    }
+    newestTimepoint_ = std::max(newestTimepoint_, stream.Timepoint(stream.size - 1));
+    if (!firstDataTimepoint_.has_value()) {
+        firstDataTimepoint_ = stream.Timepoint(0);
+    }
+    EmitReadyFrames();
+}
+
+uint64_t StreamAligner::FrameTimepoint(uint64_t frame) const {
+    // computed from the frame number so that the grid does not drift
+    return *gridOrigin_ + static_cast<uint64_t>(std::llround(static_cast<double>(frame) * 1e6 / outputRate_));
+}
+
+bool StreamAligner::Start() {
+    if (gridOrigin_.has_value()) {
+        return true;
+    }
+    const bool allStreamsHaveData = std::all_of(streams_.begin(), streams_.end(),
+                                                [](const Stream& stream) { return stream.size != 0; });
+    if (!allStreamsHaveData && newestTimepoint_ < *firstDataTimepoint_ + maxLatency_) {
+        return false;
+    }
+    // the grid starts when the last of the available streams has started
+    uint64_t origin = 0;
+    for (const auto& stream : streams_) {
+        if (stream.size != 0) {
+            origin = std::max(origin, stream.Timepoint(0));
+        }
+    }
+    gridOrigin_ = origin;
+    nextFrame_ = 0;
+    return true;
+}
+
+void StreamAligner::EmitReadyFrames() {
+    if (!Start()) {
+        return;
+    }
+    while (true) {
+        frameTimepoints_.clear();
+        while (frameTimepoints_.size() < kMaxFramesPerBlock) {
+            const uint64_t timepoint = FrameTimepoint(nextFrame_);
+            const bool ready = std::all_of(streams_.begin(), streams_.end(), [timepoint](const Stream& stream) {
+                return stream.size != 0 && stream.Timepoint(stream.size - 1) >= timepoint;
+            });
+            if (!ready && newestTimepoint_ < timepoint + maxLatency_) {
+                break;
+            }
+            frameTimepoints_.push_back(timepoint);
+            ++nextFrame_;
+        }
+        if (frameTimepoints_.empty()) {
+            return;
+        }
+
+        SignalBlock frames = SignalBlock::Allocate(FrameChannelsCount(), static_cast<int32_t>(frameTimepoints_.size()));
+        std::copy(frameTimepoints_.begin(), frameTimepoints_.end(), frames.Timepoints().begin());
+        uint32_t staleStreams = 0;
+        for (std::size_t stream = 0; stream < streams_.size(); ++stream) {
+            if (Interpolate(streams_[stream], frameTimepoints_, frames) != 0 && stream < kMaxStreams) {
+                staleStreams |= 1U << stream;
+            }
+            Trim(streams_[stream]);
+        }
+        if (handler_) {
+            handler_(frames, staleStreams);
+        }
+        if (frameTimepoints_.size() < kMaxFramesPerBlock) {
+            return;
+        }
+    }
+}
+
+uint32_t StreamAligner::Interpolate(Stream& stream, std::span<const uint64_t> frameTimepoints, SignalBlock& frames) {
+    const std::size_t framesCount = frameTimepoints.size();
+    if (stream.size == 0) {
+        for (int32_t channel = 0; channel < stream.channels; ++channel) {
+            const auto out = frames.Channel(static_cast<int32_t>(stream.channelOffset) + channel);
+            std::fill(out.begin(), out.end(), std::numeric_limits<float>::quiet_NaN());
+        }
+        return 1;
+    }
+
+    // position of every frame between two samples, shared by all channels
+    const std::size_t samples = stream.size;
+    std::size_t cursor = stream.cursor;
+    uint32_t stale = 0;
+    for (std::size_t frame = 0; frame < framesCount; ++frame) {
+        const uint64_t timepoint = frameTimepoints[frame];
+        while (cursor + 1 < samples && stream.Timepoint(cursor + 1) <= timepoint) {
+            ++cursor;
+        }
+        const uint64_t before = stream.Timepoint(cursor);
+        sampleSlots_[frame] = stream.Slot(cursor);
+        nextSlots_[frame] = stream.Slot(std::min(cursor + 1, samples - 1));
+        if (before >= timepoint || cursor + 1 == samples) {
+            // exact hit, or the frame is outside of the received data: hold the value
+            weights_[frame] = 0.0f;
+            stale |= before != timepoint ? 1U : 0U;
+        } else {
+            weights_[frame] = static_cast<float>(static_cast<double>(timepoint - before)
+                                                 / static_cast<double>(stream.Timepoint(cursor + 1) - before));
+        }
+    }
+    stream.cursor = cursor;
+
+    // channel by channel, so the output is written contiguously
+    const std::size_t* slots = sampleSlots_.data();
+    const std::size_t* nextSlots = nextSlots_.data();
+    const float* weights = weights_.data();
+    for (int32_t channel = 0; channel < stream.channels; ++channel) {
+        const float* values = stream.values.data() + static_cast<std::size_t>(channel) * stream.capacity;
+        float* out = frames.Channel(static_cast<int32_t>(stream.channelOffset) + channel).data();
+        for (std::size_t frame = 0; frame < framesCount; ++frame) {
+            const float value = values[slots[frame]];
+            out[frame] = value + weights[frame] * (values[nextSlots[frame]] - value);
+        }
+    }
+    return stale;
+}
+
+void StreamAligner::Trim(Stream& stream) {
+    // samples before the cursor are older than every frame still to come
+    stream.head = stream.Slot(stream.cursor);
+    stream.size -= stream.cursor;
+    stream.cursor = 0;
+}
+
+void StreamAligner::Grow(Stream& stream) {
+    // unrolled from the oldest sample, so that slots are indexes again
+    const std::size_t capacity = stream.capacity * 2;
+    std::vector<uint64_t> timepoints(capacity);
+    std::vector<float> values(capacity * static_cast<std::size_t>(stream.channels));
+    for (std::size_t index = 0; index < stream.size; ++index) {
+        const std::size_t slot = stream.Slot(index);
+        timepoints[index] = stream.timepoints[slot];
+        for (int32_t channel = 0; channel < stream.channels; ++channel) {
+            values[static_cast<std::size_t>(channel) * capacity + index] =
+                    stream.values[static_cast<std::size_t>(channel) * stream.capacity + slot];
+        }
+    }
+    stream.timepoints = std::move(timepoints);
+    stream.values = std::move(values);
+    stream.capacity = capacity;
+    stream.head = 0;
+}
+
+} // namespace signal_processing
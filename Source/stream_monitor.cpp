@@ -0,0 +1,171 @@
+#include <stream_monitor.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace signal_processing
+{
+namespace
+{
+// intervals collected before the nominal rate is fixed
+constexpr std::size_t kRateIntervals = 64;
+// an interval longer than this many periods is a gap
+constexpr double kGapPeriods = 1.5;
+} // namespace
+
+StreamMonitor::StreamMonitor(std::string name)
+        : name_{std::move(name)}
+{
+    rateIntervals_.reserve(kRateIntervals);
+}
+
+const std::string& StreamMonitor::Name() const {
+    return name_;
+}
+
+void StreamMonitor::SetGapHandler(GapHandler handler) {
+    gapHandler_ = std::move(handler);
+}
+
+void StreamMonitor::Observe(const SignalBlock& block, Clock::time_point arrival) {
+    const auto timepoints = block.Timepoints();
+    blocks_.fetch_add(1, std::memory_order_relaxed);
+    samples_.fetch_add(timepoints.size(), std::memory_order_relaxed);
+    UpdateJitter(timepoints.size(), arrival);
+    if (timepoints.empty()) {
+        return;
+    }
+    if (!period_.has_value()) {
+        InferRate(timepoints);
+    }
+    if (period_.has_value() && Continues(timepoints)) {
+        lastTimepoint_ = timepoints.back();
+        return;
+    }
+    scannedBlocks_.fetch_add(1, std::memory_order_relaxed);
+    Scan(timepoints);
+}
+
+StreamMonitorStats StreamMonitor::Stats() const {
+    StreamMonitorStats stats;
+    stats.blocks = blocks_.load(std::memory_order_relaxed);
+    stats.samples = samples_.load(std::memory_order_relaxed);
+    stats.scannedBlocks = scannedBlocks_.load(std::memory_order_relaxed);
+    stats.gaps = gaps_.load(std::memory_order_relaxed);
+    stats.missingSamples = missingSamples_.load(std::memory_order_relaxed);
+    stats.duplicates = duplicates_.load(std::memory_order_relaxed);
+    stats.outOfOrder = outOfOrder_.load(std::memory_order_relaxed);
+    stats.sampleRate = sampleRate_.load(std::memory_order_relaxed);
+    stats.jitterMeanMs = jitterMeanMs_.load(std::memory_order_relaxed);
+    stats.jitterStdDevMs = jitterStdDevMs_.load(std::memory_order_relaxed);
+    stats.jitterMaxMs = jitterMaxMs_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void StreamMonitor::InferRate(std::span<const uint64_t> timepoints) {
+    uint64_t previous = lastTimepoint_.value_or(timepoints.front());
+    for (const uint64_t timepoint : timepoints) {
+        if (timepoint > previous && rateIntervals_.size() < kRateIntervals) {
+            rateIntervals_.push_back(timepoint - previous);
+        }
+        previous = std::max(previous, timepoint);
+    }
+    if (rateIntervals_.size() < kRateIntervals) {
+        return;
+    }
+    // the median is not thrown off by the odd gap during the warm-up
+    const auto middle = rateIntervals_.begin() + static_cast<std::ptrdiff_t>(rateIntervals_.size() / 2);
+    std::nth_element(rateIntervals_.begin(), middle, rateIntervals_.end());
+    period_ = static_cast<double>(*middle);
+    sampleRate_.store(1e6 / *period_, std::memory_order_relaxed);
+    rateIntervals_ = {};
+}
+
+bool StreamMonitor::Continues(std::span<const uint64_t> timepoints) const {
+    const double period = *period_;
+    if (lastTimepoint_.has_value()) {
+        if (timepoints.front() <= *lastTimepoint_) {
+            return false;
+        }
+        const auto interval = static_cast<double>(timepoints.front() - *lastTimepoint_);
+        if (interval < 0.5 * period || interval > kGapPeriods * period) {
+            return false;
+        }
+    }
+    // one branch-free pass that vectorizes: a sample going back in time wraps
+    // around to a huge unsigned interval, a duplicate gives a zero one
+    uint64_t shortest = UINT64_MAX;
+    uint64_t longest = 0;
+    for (std::size_t i = 1; i < timepoints.size(); ++i) {
+        const uint64_t interval = timepoints[i] - timepoints[i - 1];
+        shortest = std::min(shortest, interval);
+        longest = std::max(longest, interval);
+    }
+    return timepoints.size() == 1
+           || (static_cast<double>(shortest) >= 0.5 * period && static_cast<double>(longest) <= kGapPeriods * period);
+}
+
+void StreamMonitor::Scan(std::span<const uint64_t> timepoints) {
+    std::size_t first = 0;
+    if (!lastTimepoint_.has_value()) {
+        lastTimepoint_ = timepoints.front();
+        first = 1;
+    }
+    uint64_t previous = *lastTimepoint_;
+    for (std::size_t i = first; i < timepoints.size(); ++i) {
+        const uint64_t timepoint = timepoints[i];
+        if (timepoint == previous) {
+            duplicates_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (timepoint < previous) {
+            outOfOrder_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (period_.has_value() && static_cast<double>(timepoint - previous) > kGapPeriods * *period_) {
+            const auto missing = static_cast<uint64_t>(
+                    std::max(std::llround(static_cast<double>(timepoint - previous) / *period_) - 1, 1LL));
+            gaps_.fetch_add(1, std::memory_order_relaxed);
+            missingSamples_.fetch_add(missing, std::memory_order_relaxed);
+            if (gapHandler_) {
+                gapHandler_(previous, timepoint, missing);
+            }
+        }
+        previous = timepoint;
+    }
+    lastTimepoint_ = previous;
+}
+
+void StreamMonitor::UpdateJitter(std::size_t samples, Clock::time_point arrival) {
+    if (period_.has_value() && lastArrival_.has_value()) {
+        const double expectedMs = static_cast<double>(lastBlockSamples_) * *period_ / 1e3;
+        const double actualMs = std::chrono::duration<double, std::milli>(arrival - *lastArrival_).count();
+        const double jitter = actualMs - expectedMs;
+        ++jitterCount_;
+        const double delta = jitter - jitterMean_;
+        jitterMean_ += delta / static_cast<double>(jitterCount_);
+        jitterM2_ += delta * (jitter - jitterMean_);
+        jitterMeanMs_.store(jitterMean_, std::memory_order_relaxed);
+        jitterStdDevMs_.store(std::sqrt(jitterM2_ / static_cast<double>(jitterCount_)), std::memory_order_relaxed);
+        if (std::abs(jitter) > jitterMaxMs_.load(std::memory_order_relaxed)) {
+            jitterMaxMs_.store(std::abs(jitter), std::memory_order_relaxed);
+        }
+    }
+    lastArrival_ = arrival;
+    lastBlockSamples_ = samples;
+}
+
+void PrintStats(std::ostream& out, const StreamMonitor& monitor) {
+    const auto stats = monitor.Stats();
+    out << monitor.Name() << ": " << stats.blocks << " blocks, " << stats.samples << " samples at "
+        << stats.sampleRate << " Hz, "
+        << stats.gaps << " gaps (" << stats.missingSamples << " samples lost), "
+        << stats.duplicates << " duplicates, "
+        << stats.outOfOrder << " out of order, "
+        << "arrival jitter " << stats.jitterMeanMs << " +- " << stats.jitterStdDevMs
+        << " ms (max " << stats.jitterMaxMs << " ms), "
+        << stats.scannedBlocks << " blocks scanned" << std::endl;
+}
+
+} // namespace signal_processing
@@ -0,0 +1,541 @@
+#include <time_series_store.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <utility>
+
+namespace time_series
+{
+namespace
+{
+constexpr std::array<char, 4> kRecordMagic = {'T', 'S', 'C', '1'};
+constexpr std::size_t kRollupColumns = 4;
+
+std::size_t LevelIndex(Resolution resolution) {
+    return static_cast<std::size_t>(resolution);
+}
+
+std::size_t ColumnsOf(Resolution resolution) {
+    return resolution == Resolution::Raw ? 1 : kRollupColumns;
+}
+
+// Start of the bucket holding the timestamp, also for timestamps before the epoch
+int64_t BucketStart(int64_t timestamp, int64_t width) {
+    const int64_t remainder = timestamp % width;
+    return timestamp - (remainder < 0 ? remainder + width : remainder);
+}
+
+// Adds a rollup to the result, merged with the last one when they share the bucket
+void AddRollup(std::vector<Aggregate>& result, const Aggregate& rollup) {
+    if (result.empty() || result.back().timestamp != rollup.timestamp) {
+        result.push_back(rollup);
+        return;
+    }
+    auto& merged = result.back();
+    const uint32_t count = merged.count + rollup.count;
+    if (count > 0) {
+        merged.mean = static_cast<float>((static_cast<double>(merged.mean) * merged.count
+                                          + static_cast<double>(rollup.mean) * rollup.count) / count);
+    }
+    merged.min = std::min(merged.min, rollup.min);
+    merged.max = std::max(merged.max, rollup.max);
+    merged.count = count;
+}
+
+class BitReader
+{
+public:
+    explicit BitReader(std::span<const uint8_t> bytes)
+            : bytes_{bytes}
+    {
+    }
+
+    uint64_t Read(int bits) {
+        uint64_t value = 0;
+        for (int i = 0; i < bits; ++i, ++position_) {
+            const uint8_t byte = bytes_[position_ / 8];
+            value = (value << 1) | ((byte >> (7 - position_ % 8)) & 1U);
+        }
+        return value;
+    }
+
+    bool ReadBit() {
+        return Read(1) != 0;
+    }
+
+private:
+    std::span<const uint8_t> bytes_;
+    uint64_t position_ = 0;
+};
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+} // namespace
+
+const char* ResolutionName(Resolution resolution) {
+    switch (resolution) {
+    case Resolution::Raw:
+        return "raw";
+    case Resolution::Second:
+        return "1 s";
+    case Resolution::Minute:
+        return "1 min";
+    case Resolution::Hour:
+        return "1 h";
+    default:
+        return "unknown";
+    }
+}
+
+int64_t ResolutionMs(Resolution resolution) {
+    switch (resolution) {
+    case Resolution::Second:
+        return 1'000;
+    case Resolution::Minute:
+        return 60'000;
+    case Resolution::Hour:
+        return 3'600'000;
+    default:
+        return 0;
+    }
+}
+
+Resolution ResolutionFor(int64_t fromMs, int64_t toMs, std::size_t maxPoints) {
+    const int64_t span = std::max<int64_t>(toMs - fromMs, 0);
+    for (const auto resolution : {Resolution::Second, Resolution::Minute}) {
+        if (static_cast<std::size_t>(span / ResolutionMs(resolution)) < maxPoints) {
+            return resolution;
+        }
+    }
+    return Resolution::Hour;
+}
+
+EncodedChunk::EncodedChunk(std::size_t columns)
+        : columns_{columns}
+        , lastValues_(columns, 0)
+        , leading_(columns, -1)
+        , trailing_(columns, 0)
+{
+}
+
+EncodedChunk::EncodedChunk(std::size_t columns, uint32_t count, int64_t first, int64_t last, uint64_t bitsCount,
+                           std::vector<uint8_t> bytes)
+        : columns_{columns}
+        , count_{count}
+        , first_{first}
+        , last_{last}
+        , bytes_{std::move(bytes)}
+        , bitsCount_{bitsCount}
+{
+}
+
+std::size_t EncodedChunk::ColumnsCount() const {
+    return columns_;
+}
+
+uint32_t EncodedChunk::Count() const {
+    return count_;
+}
+
+int64_t EncodedChunk::First() const {
+    return first_;
+}
+
+int64_t EncodedChunk::Last() const {
+    return last_;
+}
+
+uint64_t EncodedChunk::BitsCount() const {
+    return bitsCount_;
+}
+
+std::span<const uint8_t> EncodedChunk::Bytes() const {
+    return bytes_;
+}
+
+void EncodedChunk::WriteBits(uint64_t value, int bits) {
+    for (int i = bits - 1; i >= 0; --i, ++bitsCount_) {
+        if (bitsCount_ % 8 == 0) {
+            bytes_.push_back(0);
+        }
+        bytes_.back() |= static_cast<uint8_t>(((value >> i) & 1U) << (7 - bitsCount_ % 8));
+    }
+}
+
+void EncodedChunk::Append(int64_t timestamp, std::span<const float> values) {
+    if (count_ == 0) {
+        WriteBits(static_cast<uint64_t>(timestamp), 64);
+        for (std::size_t column = 0; column < columns_; ++column) {
+            lastValues_[column] = std::bit_cast<uint32_t>(values[column]);
+            WriteBits(lastValues_[column], 32);
+        }
+        first_ = timestamp;
+        last_ = timestamp;
+        ++count_;
+        return;
+    }
+
+    // a regular stream repeats its interval, which costs a single bit
+    const int64_t delta = timestamp - last_;
+    const int64_t deltaOfDelta = delta - lastDelta_;
+    if (deltaOfDelta == 0) {
+        WriteBits(0b0, 1);
+    } else if (deltaOfDelta >= -63 && deltaOfDelta <= 64) {
+        WriteBits(0b10, 2);
+        WriteBits(static_cast<uint64_t>(deltaOfDelta + 63), 7);
+    } else if (deltaOfDelta >= -255 && deltaOfDelta <= 256) {
+        WriteBits(0b110, 3);
+        WriteBits(static_cast<uint64_t>(deltaOfDelta + 255), 9);
+    } else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048) {
+        WriteBits(0b1110, 4);
+        WriteBits(static_cast<uint64_t>(deltaOfDelta + 2047), 12);
+    } else {
+        WriteBits(0b1111, 4);
+        WriteBits(static_cast<uint64_t>(deltaOfDelta), 64);
+    }
+    lastDelta_ = delta;
+    last_ = timestamp;
+
+    // slowly changing values share their sign, exponent and low zero bits
+    for (std::size_t column = 0; column < columns_; ++column) {
+        const uint32_t bits = std::bit_cast<uint32_t>(values[column]);
+        const uint32_t xored = bits ^ lastValues_[column];
+        lastValues_[column] = bits;
+        if (xored == 0) {
+            WriteBits(0b0, 1);
+            continue;
+        }
+        const int leading = std::min(std::countl_zero(xored), 31);
+        const int trailing = std::countr_zero(xored);
+        if (leading_[column] >= 0 && leading >= leading_[column] && trailing >= trailing_[column]) {
+            WriteBits(0b10, 2);
+            WriteBits(xored >> trailing_[column], 32 - leading_[column] - trailing_[column]);
+            continue;
+        }
+        const int meaningful = 32 - leading - trailing;
+        WriteBits(0b11, 2);
+        WriteBits(static_cast<uint64_t>(leading), 5);
+        WriteBits(static_cast<uint64_t>(meaningful - 1), 5);
+        WriteBits(xored >> trailing, meaningful);
+        leading_[column] = leading;
+        trailing_[column] = trailing;
+    }
+    ++count_;
+}
+
+void EncodedChunk::Decode(std::vector<int64_t>& timestamps, std::vector<float>& values) const {
+    if (count_ == 0) {
+        return;
+    }
+    BitReader reader(bytes_);
+    std::vector<uint32_t> lastValues(columns_);
+    std::vector<int> leading(columns_, 0);
+    std::vector<int> trailing(columns_, 0);
+
+    int64_t timestamp = static_cast<int64_t>(reader.Read(64));
+    int64_t delta = 0;
+    timestamps.push_back(timestamp);
+    for (std::size_t column = 0; column < columns_; ++column) {
+        lastValues[column] = static_cast<uint32_t>(reader.Read(32));
+        values.push_back(std::bit_cast<float>(lastValues[column]));
+    }
+
+    for (uint32_t point = 1; point < count_; ++point) {
+        int64_t deltaOfDelta = 0;
+        if (!reader.ReadBit()) {
+            deltaOfDelta = 0;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(7)) - 63;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(9)) - 255;
+        } else if (!reader.ReadBit()) {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(12)) - 2047;
+        } else {
+            deltaOfDelta = static_cast<int64_t>(reader.Read(64));
+        }
+        delta += deltaOfDelta;
+        timestamp += delta;
+        timestamps.push_back(timestamp);
+
+        for (std::size_t column = 0; column < columns_; ++column) {
+            if (reader.ReadBit()) {
+                if (reader.ReadBit()) {
+                    leading[column] = static_cast<int>(reader.Read(5));
+                    trailing[column] = 32 - leading[column] - (static_cast<int>(reader.Read(5)) + 1);
+                }
+                const int meaningful = 32 - leading[column] - trailing[column];
+                lastValues[column] ^= static_cast<uint32_t>(reader.Read(meaningful)) << trailing[column];
+            }
+            values.push_back(std::bit_cast<float>(lastValues[column]));
+        }
+    }
+}
+
+void PrintStats(std::ostream& out, const StoreStats& stats) {
+    out << "Time series store: " << stats.series << " series, " << stats.rejected << " points out of order" << '\n';
+    for (std::size_t level = 0; level < stats.points.size(); ++level) {
+        out << '\t' << ResolutionName(static_cast<Resolution>(level)) << ": " << stats.points[level] << " points in "
+            << stats.bytes[level] << " bytes";
+        if (stats.points[level] > 0) {
+            out << ", " << static_cast<double>(stats.bytes[level]) / static_cast<double>(stats.points[level])
+                << " bytes per point";
+        }
+        out << '\n';
+    }
+    out << std::flush;
+}
+
+Store::Store(std::string path)
+        : path_{std::move(path)}
+{
+    if (path_.empty()) {
+        return;
+    }
+    Load();
+    file_.open(path_, std::ios::binary | std::ios::app);
+    if (!file_.is_open()) {
+        std::cerr << "Time series store: cannot open " << path_ << ", keeping the points in memory" << std::endl;
+    }
+}
+
+Store::~Store() {
+    Flush();
+}
+
+void Store::Load() {
+    std::ifstream in(path_, std::ios::binary);
+    if (!in.is_open()) {
+        return;
+    }
+    std::streamoff validSize = 0;
+    bool damaged = false;
+    while (in.peek() != std::ifstream::traits_type::eof()) {
+        std::array<char, 4> magic{};
+        uint16_t nameLength = 0;
+        uint8_t resolution = 0;
+        uint8_t columns = 0;
+        uint32_t count = 0;
+        int64_t first = 0;
+        int64_t last = 0;
+        uint64_t bitsCount = 0;
+        std::string name;
+        const bool headerRead = readValue(in, magic) && magic == kRecordMagic && readValue(in, nameLength);
+        if (headerRead) {
+            name.resize(nameLength);
+        }
+        if (!headerRead || !in.read(name.data(), nameLength) || !readValue(in, resolution) || !readValue(in, columns)
+            || !readValue(in, count) || !readValue(in, first) || !readValue(in, last) || !readValue(in, bitsCount)
+            || resolution >= LevelIndex(Resolution::Count) || columns != ColumnsOf(static_cast<Resolution>(resolution))) {
+            damaged = true;
+            break;
+        }
+        std::vector<uint8_t> bytes((bitsCount + 7) / 8);
+        if (!in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+            damaged = true;
+            break;
+        }
+        validSize = in.tellg();
+
+        auto& series = series_[name];
+        series.levels[resolution].sealed.emplace_back(columns, count, first, last, bitsCount, std::move(bytes));
+        if (resolution == LevelIndex(Resolution::Raw)) {
+            series.last = std::max(series.last.value_or(last), last);
+        }
+    }
+    in.close();
+    if (damaged) {
+        // usually the tail of a run that did not finish writing, new chunks go after the valid ones
+        std::cerr << "Time series store: dropping a damaged record at byte " << validSize << " of " << path_
+                  << std::endl;
+        std::error_code error;
+        std::filesystem::resize_file(path_, static_cast<std::uintmax_t>(validSize), error);
+    }
+}
+
+bool Store::Append(const std::string& name, int64_t timestampMs, float value) {
+    auto& series = series_[name];
+    if (series.last.has_value() && timestampMs < *series.last) {
+        ++rejected_;
+        return false;
+    }
+    AppendToLevel(name, series, Resolution::Raw, timestampMs, std::span<const float>(&value, 1));
+    series.last = timestampMs;
+    if (!std::isfinite(value)) {
+        return true;
+    }
+    for (const auto resolution : {Resolution::Second, Resolution::Minute, Resolution::Hour}) {
+        auto& bucket = series.buckets[LevelIndex(resolution)];
+        const int64_t start = BucketStart(timestampMs, ResolutionMs(resolution));
+        if (bucket.has_value() && bucket->start != start) {
+            CloseBucket(name, series, resolution);
+        }
+        if (!bucket.has_value()) {
+            bucket = Bucket{start, value, value, 0.0, 0};
+        }
+        bucket->min = std::min(bucket->min, value);
+        bucket->max = std::max(bucket->max, value);
+        bucket->sum += value;
+        ++bucket->count;
+    }
+    return true;
+}
+
+void Store::AppendToLevel(const std::string& name, Series& series, Resolution resolution, int64_t timestamp,
+                          std::span<const float> values) {
+    auto& level = series.levels[LevelIndex(resolution)];
+    if (!level.open.has_value()) {
+        level.open.emplace(ColumnsOf(resolution));
+    }
+    level.open->Append(timestamp, values);
+    if (level.open->Count() >= kChunkPoints) {
+        Seal(name, level, resolution);
+    }
+}
+
+void Store::CloseBucket(const std::string& name, Series& series, Resolution resolution) {
+    auto& bucket = series.buckets[LevelIndex(resolution)];
+    if (!bucket.has_value()) {
+        return;
+    }
+    const std::array<float, kRollupColumns> values = {
+            bucket->min, bucket->max, static_cast<float>(bucket->sum / bucket->count),
+            static_cast<float>(bucket->count)};
+    AppendToLevel(name, series, resolution, bucket->start, values);
+    bucket.reset();
+}
+
+void Store::Seal(const std::string& name, Level& level, Resolution resolution) {
+    if (!level.open.has_value() || level.open->Count() == 0) {
+        return;
+    }
+    WriteChunk(name, resolution, *level.open);
+    level.sealed.push_back(std::move(*level.open));
+    level.open.reset();
+}
+
+void Store::WriteChunk(const std::string& name, Resolution resolution, const EncodedChunk& chunk) {
+    if (!file_.is_open()) {
+        return;
+    }
+    file_.write(kRecordMagic.data(), kRecordMagic.size());
+    writeValue(file_, static_cast<uint16_t>(name.size()));
+    file_.write(name.data(), static_cast<std::streamsize>(name.size()));
+    writeValue(file_, static_cast<uint8_t>(resolution));
+    writeValue(file_, static_cast<uint8_t>(chunk.ColumnsCount()));
+    writeValue(file_, chunk.Count());
+    writeValue(file_, chunk.First());
+    writeValue(file_, chunk.Last());
+    writeValue(file_, chunk.BitsCount());
+    const auto bytes = chunk.Bytes();
+    file_.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+std::vector<Aggregate> Store::Range(const std::string& name, int64_t fromMs, int64_t toMs,
+                                    Resolution resolution) const {
+    std::vector<Aggregate> result;
+    const auto found = series_.find(name);
+    if (found == series_.end() || resolution == Resolution::Count) {
+        return result;
+    }
+    const auto& series = found->second;
+    const auto& level = series.levels[LevelIndex(resolution)];
+    // a bucket starting before fromMs still covers it
+    const int64_t width = std::max<int64_t>(ResolutionMs(resolution), 1);
+    const auto inRange = [fromMs, toMs, width](int64_t timestamp) {
+        return timestamp + width > fromMs && timestamp <= toMs;
+    };
+
+    std::vector<int64_t> timestamps;
+    std::vector<float> values;
+    const auto scan = [&](const EncodedChunk& chunk) {
+        if (chunk.Last() + width <= fromMs || chunk.First() > toMs) {
+            return;
+        }
+        timestamps.clear();
+        values.clear();
+        chunk.Decode(timestamps, values);
+        const std::size_t columns = chunk.ColumnsCount();
+        for (std::size_t point = 0; point < timestamps.size(); ++point) {
+            if (!inRange(timestamps[point])) {
+                continue;
+            }
+            const float* value = values.data() + point * columns;
+            if (resolution == Resolution::Raw) {
+                result.push_back({timestamps[point], value[0], value[0], value[0], 1});
+            } else {
+                AddRollup(result, {timestamps[point], value[0], value[1], value[2], static_cast<uint32_t>(value[3])});
+            }
+        }
+    };
+    for (const auto& chunk : level.sealed) {
+        scan(chunk);
+    }
+    if (level.open.has_value()) {
+        scan(*level.open);
+    }
+    if (const auto& bucket = series.buckets[LevelIndex(resolution)]; bucket.has_value() && inRange(bucket->start)) {
+        AddRollup(result, {bucket->start, bucket->min, bucket->max, static_cast<float>(bucket->sum / bucket->count),
+                           bucket->count});
+    }
+    return result;
+}
+
+std::optional<int64_t> Store::LastTimestamp(const std::string& name) const {
+    const auto found = series_.find(name);
+    return found != series_.end() ? found->second.last : std::nullopt;
+}
+
+std::vector<std::string> Store::SeriesNames() const {
+    std::vector<std::string> names;
+    names.reserve(series_.size());
+    for (const auto& [name, series] : series_) {
+        names.push_back(name);
+    }
+    return names;
+}
+
+StoreStats Store::Stats() const {
+    StoreStats stats;
+    stats.series = series_.size();
+    stats.rejected = rejected_;
+    for (const auto& [name, series] : series_) {
+        for (std::size_t level = 0; level < series.levels.size(); ++level) {
+            const auto count = [&stats, level](const EncodedChunk& chunk) {
+                stats.points[level] += chunk.Count();
+                stats.bytes[level] += chunk.Bytes().size();
+            };
+            std::for_each(series.levels[level].sealed.begin(), series.levels[level].sealed.end(), count);
+            if (series.levels[level].open.has_value()) {
+                count(*series.levels[level].open);
+            }
+        }
+    }
+    return stats;
+}
+
+void Store::Flush() {
+    for (auto& [name, series] : series_) {
+        for (const auto resolution : {Resolution::Second, Resolution::Minute, Resolution::Hour}) {
+            CloseBucket(name, series, resolution);
+        }
+        for (std::size_t level = 0; level < series.levels.size(); ++level) {
+            Seal(name, series.levels[level], static_cast<Resolution>(level));
+        }
+    }
+    if (file_.is_open()) {
+        file_.flush();
+    }
+}
+
+} // namespace time_series
@@ -0,0 +1,95 @@
+#include <trend_forecaster.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace signal_processing
+{
+namespace
+{
+// time of the line from the threshold distance and the slope towards it
+std::optional<double> timeToReach(double distance, double slope) {
+    if (distance <= 0.0) {
+        return 0.0;
+    }
+    if (slope <= 0.0) {
+        return std::nullopt;
+    }
+    return distance / slope;
+}
+} // namespace
+
+TrendForecaster::TrendForecaster(TrendForecasterConfig config)
+        : config_{config}
+{
+}
+
+const TrendForecasterConfig& TrendForecaster::Config() const {
+    return config_;
+}
+
+void TrendForecaster::Update(uint64_t timepoint, double value) {
+    if (!origin_.has_value()) {
+        origin_ = timepoint;
+    }
+    const double time = std::max(static_cast<double>(timepoint - std::min(timepoint, *origin_)) / 1e6, lastTime_);
+
+    // older values fade with the time passed, not with the number of updates
+    const double decay = std::exp(-(time - lastTime_) / config_.timeConstantSec);
+    weight_ = weight_ * decay + 1.0;
+    weight2_ = weight2_ * decay * decay + 1.0;
+    time2_ = time2_ * decay * decay + time;
+    timeSquares2_ = timeSquares2_ * decay * decay + time * time;
+    timeM2_ *= decay;
+    valueM2_ *= decay;
+    coMoment_ *= decay;
+
+    // weighted Welford step, the new value has weight 1
+    const double timeDelta = time - meanTime_;
+    const double valueDelta = value - meanValue_;
+    meanTime_ += timeDelta / weight_;
+    meanValue_ += valueDelta / weight_;
+    timeM2_ += timeDelta * (time - meanTime_);
+    valueM2_ += valueDelta * (value - meanValue_);
+    coMoment_ += timeDelta * (value - meanValue_);
+
+    lastTime_ = time;
+    ++updates_;
+}
+
+std::optional<TrendForecast> TrendForecaster::Forecast() const {
+    if (updates_ < config_.minUpdates || timeM2_ <= 0.0) {
+        return std::nullopt;
+    }
+    // sum of w^2 (t - mean)^2, the slope variance of weighted least squares
+    // is noise variance * that / timeM2^2
+    const double spread2 = std::max(0.0, timeSquares2_ - 2.0 * meanTime_ * time2_ + meanTime_ * meanTime_ * weight2_);
+    // the expected weighted sum of squared residuals is noise variance * degreesOfFreedom
+    const double degreesOfFreedom = weight_ - weight2_ / weight_ - spread2 / timeM2_;
+    if (degreesOfFreedom <= 0.0) {
+        return std::nullopt;
+    }
+    TrendForecast forecast;
+    forecast.slope = coMoment_ / timeM2_;
+    forecast.level = meanValue_ + forecast.slope * (lastTime_ - meanTime_);
+    const double residuals = std::max(0.0, valueM2_ - coMoment_ * coMoment_ / timeM2_);
+    forecast.slopeStdDev = std::sqrt(residuals / degreesOfFreedom * spread2) / timeM2_;
+
+    const double distance = config_.rising ? config_.threshold - forecast.level : forecast.level - config_.threshold;
+    const double towards = config_.rising ? forecast.slope : -forecast.slope;
+    const double margin = config_.confidence * forecast.slopeStdDev;
+    forecast.timeToThreshold = timeToReach(distance, towards);
+    forecast.earliest = timeToReach(distance, towards + margin);
+    forecast.latest = timeToReach(distance, towards - margin);
+    return forecast;
+}
+
+uint64_t TrendForecaster::UpdatesCount() const {
+    return updates_;
+}
+
+void TrendForecaster::Reset() {
+    *this = TrendForecaster(config_);
+}
+
+} // namespace signal_processing
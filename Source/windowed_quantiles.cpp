@@ -0,0 +1,153 @@
+#include <windowed_quantiles.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+namespace signal_processing
+{
+
+WindowedQuantiles::WindowedQuantiles(int64_t window)
+        : window_{window}
+        , nodes_(2)
+{
+    // the tail compares greater than any value, the head reaches it in one step
+    nodes_[kTail].value = std::numeric_limits<float>::infinity();
+    nodes_[kTail].sequence = std::numeric_limits<uint64_t>::max();
+    nodes_[kHead].levels = kMaxLevels;
+    nodes_[kHead].next.fill(kTail);
+    nodes_[kHead].width.fill(1);
+}
+
+void WindowedQuantiles::Push(float value, int64_t timestamp) {
+    Expire(timestamp);
+    if (!std::isfinite(value)) {
+        return;
+    }
+    const uint64_t sequence = nextSequence_++;
+    entries_.push_back({timestamp, value, sequence});
+    Insert(value, sequence);
+}
+
+void WindowedQuantiles::Expire(int64_t now) {
+    while (!entries_.empty() && entries_.front().timestamp < now - window_) {
+        Erase(entries_.front().value, entries_.front().sequence);
+        entries_.pop_front();
+    }
+}
+
+std::size_t WindowedQuantiles::Size() const {
+    return entries_.size();
+}
+
+float WindowedQuantiles::Quantile(double percentile) const {
+    if (entries_.empty()) {
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+    const double position = std::clamp(percentile, 0.0, 100.0) / 100.0 * static_cast<double>(entries_.size() - 1);
+    const auto lower = static_cast<std::size_t>(position);
+    const float lowerValue = At(lower);
+    if (lower + 1 >= entries_.size()) {
+        return lowerValue;
+    }
+    const auto fraction = static_cast<float>(position - static_cast<double>(lower));
+    return lowerValue + fraction * (At(lower + 1) - lowerValue);
+}
+
+void WindowedQuantiles::Quantiles(std::span<const double> percentiles, std::span<float> out) const {
+    for (std::size_t i = 0; i < percentiles.size() && i < out.size(); ++i) {
+        out[i] = Quantile(percentiles[i]);
+    }
+}
+
+bool WindowedQuantiles::Before(uint32_t node, float value, uint64_t sequence) const {
+    const auto& other = nodes_[node];
+    return other.value < value || (other.value == value && other.sequence < sequence);
+}
+
+uint32_t WindowedQuantiles::RandomLevels() {
+    // xorshift64, every level is kept with probability 1/2
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    return std::min<uint32_t>(static_cast<uint32_t>(std::countr_one(random_)) + 1, kMaxLevels);
+}
+
+uint32_t WindowedQuantiles::NewNode() {
+    if (!freeNodes_.empty()) {
+        const uint32_t node = freeNodes_.back();
+        freeNodes_.pop_back();
+        return node;
+    }
+    nodes_.emplace_back();
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void WindowedQuantiles::Insert(float value, uint64_t sequence) {
+    std::array<uint32_t, kMaxLevels> chain{};
+    std::array<uint32_t, kMaxLevels> steps{};
+    uint32_t node = kHead;
+    for (std::size_t level = kMaxLevels; level-- > 0;) {
+        while (Before(nodes_[node].next[level], value, sequence)) {
+            steps[level] += nodes_[node].width[level];
+            node = nodes_[node].next[level];
+        }
+        chain[level] = node;
+    }
+
+    const uint32_t levels = RandomLevels();
+    const uint32_t inserted = NewNode();
+    auto& newNode = nodes_[inserted];
+    newNode.value = value;
+    newNode.sequence = sequence;
+    newNode.levels = levels;
+    uint32_t stepsBefore = 0;
+    for (uint32_t level = 0; level < levels; ++level) {
+        auto& previous = nodes_[chain[level]];
+        newNode.next[level] = previous.next[level];
+        previous.next[level] = inserted;
+        newNode.width[level] = previous.width[level] - stepsBefore;
+        previous.width[level] = stepsBefore + 1;
+        stepsBefore += steps[level];
+    }
+    for (uint32_t level = levels; level < kMaxLevels; ++level) {
+        ++nodes_[chain[level]].width[level];
+    }
+}
+
+void WindowedQuantiles::Erase(float value, uint64_t sequence) {
+    std::array<uint32_t, kMaxLevels> chain{};
+    uint32_t node = kHead;
+    for (std::size_t level = kMaxLevels; level-- > 0;) {
+        while (Before(nodes_[node].next[level], value, sequence)) {
+            node = nodes_[node].next[level];
+        }
+        chain[level] = node;
+    }
+    const uint32_t erased = nodes_[chain[0]].next[0];
+    const uint32_t levels = nodes_[erased].levels;
+    for (uint32_t level = 0; level < levels; ++level) {
+        auto& previous = nodes_[chain[level]];
+        previous.width[level] += nodes_[erased].width[level] - 1;
+        previous.next[level] = nodes_[erased].next[level];
+    }
+    for (uint32_t level = levels; level < kMaxLevels; ++level) {
+        --nodes_[chain[level]].width[level];
+    }
+    freeNodes_.push_back(erased);
+}
+
+float WindowedQuantiles::At(std::size_t rank) const {
+    std::size_t remaining = rank + 1;
+    uint32_t node = kHead;
+    for (std::size_t level = kMaxLevels; level-- > 0;) {
+        while (nodes_[node].width[level] <= remaining) {
+            remaining -= nodes_[node].width[level];
+            node = nodes_[node].next[level];
+        }
+    }
+    return nodes_[node].value;
+}
+
+} // namespace signal_processing
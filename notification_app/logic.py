@@ -1,20 +1,84 @@
-from ui import SOUND_FILE, feedback_field, concentration_text, root
-import sounddevice as sd
-import soundfile as sf
-
-
-async def play_sound():
-    sd.play(sf.read(SOUND_FILE))
-    feedback_field.set("Звук воспроизведён")
-
-
-# Пока не знаю, откуда брать концентрацию, посему оставлю цикл как есть
-async def start_loop():  #TODO
-    while True:
-
-        # Текст Label в Tkinter можно изменить только командой config
-        concentration_text.config(master=root, borderwidth=2, background="#FFFFFF", relief="solid", text=f"{concentration}", font="Verdana 8")
-
-        # Здесь должна быть обработка показателя концентрации
-        if concentration < 30: #TODO
-            play_sound()
+import socket
+import struct
+from tkinter import END
+
+from ui import SOUND_FILE, feedback_field, concentration_text, root
+import sounddevice as sd
+import soundfile as sf
+
+
+# Клиент подключается сюда вместо server/main.py, формат записи тот же, что у Data там
+HOST = "127.0.0.1"
+PORT = 5004
+STRUCT_FORMAT = 'Ifffffffffffff'
+STRUCT_SIZE = struct.calcsize(STRUCT_FORMAT)
+
+# Флаги полей и их места в записи
+CONCENTRATION_SCORE = (0x04, 3)
+FATIGUE_FORECAST_EARLIEST = (0x100, 9)
+CONCENTRATION_FORECAST_EARLIEST = (0x800, 12)
+# Все поля прогнозов, 0x80 - 0x1000
+FORECAST_FLAGS = 0x1F80
+
+# Предупреждаем, когда даже по самой ранней границе прогноза до порога осталось меньше этого
+ALERT_LEAD_SEC = 300
+
+
+def field(record, flag_and_index):
+    flag, index = flag_and_index
+    return record[index] if record[0] & flag else None
+
+
+def play_sound():
+    data, samplerate = sf.read(SOUND_FILE)
+    sd.play(data, samplerate)
+    feedback_field.insert(END, chars="\nЗвук воспроизведён")
+
+
+def show_concentration(concentration):
+    # Текст Label в Tkinter можно изменить только командой config
+    concentration_text.config(text=f"{concentration:.1f}")
+
+
+def alert(text):
+    feedback_field.insert(END, chars=f"\n{text}")
+    play_sound()
+
+
+def receive_record(conn):
+    data = b""
+    while len(data) < STRUCT_SIZE:
+        packet = conn.recv(STRUCT_SIZE - len(data))
+        if not packet:
+            return None
+        data += packet
+    return struct.unpack(STRUCT_FORMAT, data)
+
+
+# Прогнозы приходят каждые 10 секунд: сколько секунд осталось до того, как усталость
+# дойдёт до порога, а концентрация опустится до своего. Предупреждение звучит один раз,
+# пока прогноз не уйдёт обратно за ALERT_LEAD_SEC
+def start_loop():
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server_socket.bind((HOST, PORT))
+    server_socket.listen(1)
+    alerted = {"fatigue": False, "concentration": False}
+    while True:
+        conn, _ = server_socket.accept()
+        with conn:
+            while (record := receive_record(conn)) is not None:
+                concentration = field(record, CONCENTRATION_SCORE)
+                if concentration is not None:
+                    root.after(0, show_concentration, concentration)
+
+                if not record[0] & FORECAST_FLAGS:
+                    continue
+                # без ранней границы порог не будет достигнут даже при самом крутом наклоне
+                for name, forecast, text in (
+                        ("fatigue", FATIGUE_FORECAST_EARLIEST, "Усталость скоро достигнет порога"),
+                        ("concentration", CONCENTRATION_FORECAST_EARLIEST, "Концентрация скоро упадёт до порога")):
+                    earliest = field(record, forecast)
+                    soon = earliest is not None and earliest <= ALERT_LEAD_SEC
+                    if soon and not alerted[name]:
+                        root.after(0, alert, f"{text}: возможно, уже через {earliest:.0f} с")
+                    alerted[name] = soon
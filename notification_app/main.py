@@ -1,14 +1,15 @@
-from tkinter import END
-from ui import root, feedback_field
-from threading import Thread
-from logic import start_loop
-
-
-def main():
-    #loop_thread = Thread(target=start_loop)
-    root.mainloop()
-    #loop_thread.start()
-
-
-if __name__ == "__main__":
-    main()
+from tkinter import END
+from ui import root, feedback_field
+from threading import Thread
+from logic import start_loop
+
+
+def main():
+    # прогнозы принимаются в фоне, окно обновляется через root.after
+    loop_thread = Thread(target=start_loop, daemon=True)
+    loop_thread.start()
+    root.mainloop()
+
+
+if __name__ == "__main__":
+    main()
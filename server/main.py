@@ -4,15 +4,26 @@ import struct
 
 
 class Data:
-    struct_format: str = 'Ifffff'
+    struct_format: str = 'Ifffffffffffff'
 
-    def __init__(self, field_flags, fatigue_score, gravity_score, concentration_score, accumulated_fatigue, individual_peak_frequency):
+    def __init__(self, field_flags, fatigue_score, gravity_score, concentration_score, accumulated_fatigue, individual_peak_frequency,
+                 tracked_peak_frequency, signal_quality, fatigue_forecast, fatigue_forecast_earliest,
+                 fatigue_forecast_latest, concentration_forecast, concentration_forecast_earliest,
+                 concentration_forecast_latest):
         self.field_flags = field_flags
         self.fatigue_score = fatigue_score
         self.gravity_score = gravity_score
         self.concentration_score = concentration_score
         self.accumulated_fatigue = accumulated_fatigue
         self.individual_peak_frequency = individual_peak_frequency
+        self.tracked_peak_frequency = tracked_peak_frequency
+        self.signal_quality = signal_quality
+        self.fatigue_forecast = fatigue_forecast
+        self.fatigue_forecast_earliest = fatigue_forecast_earliest
+        self.fatigue_forecast_latest = fatigue_forecast_latest
+        self.concentration_forecast = concentration_forecast
+        self.concentration_forecast_earliest = concentration_forecast_earliest
+        self.concentration_forecast_latest = concentration_forecast_latest
 
     def get_fatigue_score(self):
         if self.field_flags & 0x01:
@@ -39,6 +50,46 @@ class Data:
             return self.individual_peak_frequency
         return None
 
+    def get_tracked_peak_frequency(self):
+        if self.field_flags & 0x20:
+            return self.tracked_peak_frequency
+        return None
+
+    def get_signal_quality(self):
+        if self.field_flags & 0x40:
+            return self.signal_quality
+        return None
+
+    def get_fatigue_forecast(self):
+        if self.field_flags & 0x80:
+            return self.fatigue_forecast
+        return None
+
+    def get_fatigue_forecast_earliest(self):
+        if self.field_flags & 0x100:
+            return self.fatigue_forecast_earliest
+        return None
+
+    def get_fatigue_forecast_latest(self):
+        if self.field_flags & 0x200:
+            return self.fatigue_forecast_latest
+        return None
+
+    def get_concentration_forecast(self):
+        if self.field_flags & 0x400:
+            return self.concentration_forecast
+        return None
+
+    def get_concentration_forecast_earliest(self):
+        if self.field_flags & 0x800:
+            return self.concentration_forecast_earliest
+        return None
+
+    def get_concentration_forecast_latest(self):
+        if self.field_flags & 0x1000:
+            return self.concentration_forecast_latest
+        return None
+
 
 def handler(conn):
     STRUCT_SIZE = struct.calcsize(Data.struct_format)
@@ -70,6 +121,30 @@ def handler(conn):
             if data.get_individual_peak_frequency() is not None:
                 print("individual_peak_frequency:", data.get_individual_peak_frequency())
 
+            if data.get_tracked_peak_frequency() is not None:
+                print("tracked_peak_frequency:", data.get_tracked_peak_frequency())
+
+            if data.get_signal_quality() is not None:
+                print("signal_quality:", data.get_signal_quality())
+
+            if data.get_fatigue_forecast() is not None:
+                print("fatigue_forecast:", data.get_fatigue_forecast())
+
+            if data.get_fatigue_forecast_earliest() is not None:
+                print("fatigue_forecast_earliest:", data.get_fatigue_forecast_earliest())
+
+            if data.get_fatigue_forecast_latest() is not None:
+                print("fatigue_forecast_latest:", data.get_fatigue_forecast_latest())
+
+            if data.get_concentration_forecast() is not None:
+                print("concentration_forecast:", data.get_concentration_forecast())
+
+            if data.get_concentration_forecast_earliest() is not None:
+                print("concentration_forecast_earliest:", data.get_concentration_forecast_earliest())
+
+            if data.get_concentration_forecast_latest() is not None:
+                print("concentration_forecast_latest:", data.get_concentration_forecast_latest())
+
     except ConnectionResetError:
         print("Соединение разорвано. Ожидание переподключения клиента...")
     finally: